@@ -0,0 +1,215 @@
+/*********************************************** Indoor Positioning System Batch ***************************************
+ * Headless reprocessing of recorded sessions (e.g. the whole "Recorded Experiments" archive)
+ *
+ * Usage: IndoorPositioningSystemBatch --anchors anchors.txt [options] <session folder>...
+ *  --anchors <file>          anchor positions, one per line: anchorID x y [origin]
+ *  --archive <folder>        process all session folders below the folder (folders with video_timestamps.txt)
+ *  --detector <cfg> <weights> Human Detector (YOLO); not needed if sessions contain detections.txt
+ *  --detector-config <path>  Human Detector given by detector.yml, or a model folder (Darknet / ONNX, precision)
+ *  --pixel-to-real <model>   predict Pixel-to-Real coordinates (XGBoost model)
+ *  --optical <calibration>   predict Optical coordinates (intrinsic calibration, .xml / .yml)
+ *  --export                  frame-by-frame export (uwb_to_bb_mapping), as in the GUI
+ *  --jobs <n>                sessions processed in parallel (default: number of cores / workers)
+ *  --workers <n>             detection workers per session (default: 1)
+ *  --batch-size <n>          frames per detector forward pass in export (default: measured)
+ *  --no-motion-gate          detect every frame, also while people stand still
+ *  --detection-interval <n>  detect every n-th frame and track people in between (default: 1, every frame)
+ *  --input-size <n>          detector input (longer side of the letterboxed frame): 320, 416, 512, 640 (default: model config)
+ *  --input-sizes <n,n,...>   sweep: all sessions for every input size, then detector latency and coordinate error
+ *                            (distance of people to their tags) per size; outputs of the last size are kept.
+ *                            Every frame is detected in a sweep (no motion gate, interval 1), so the error is the detector's
+ *
+ * Output of each session: <session>/export/coordinates.txt (+ export files)
+*************************************************************************************************************************/
+
+#include <QCoreApplication>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "batchprocessor.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv); // processors run their own threads with event loops
+
+    BatchSettings settings;
+    std::vector<std::string> sessions;
+    std::string anchorsFile;
+    int jobs = 0;
+    std::vector<int> inputSizes;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--anchors" && i + 1 < argc)
+            anchorsFile = argv[++i];
+        else if (arg == "--archive" && i + 1 < argc)
+        {
+            std::vector<std::string> archiveSessions = BatchProcessor::findSessions(argv[++i]);
+            sessions.insert(sessions.end(), archiveSessions.begin(), archiveSessions.end());
+        }
+        else if (arg == "--detector" && i + 2 < argc)
+        {
+            std::string configuration = argv[++i];
+            settings.detectorConfig = DetectorConfig::darknet(configuration, argv[++i]);
+        }
+        else if (arg == "--detector-config" && i + 1 < argc)
+        {
+            std::string path = argv[++i], error;
+            bool isLoaded = std::filesystem::is_directory(path) ? DetectorConfig::fromFolder(path, settings.detectorConfig, error)
+                                                                : DetectorConfig::load(path, settings.detectorConfig, error);
+            if (!isLoaded)
+            {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--pixel-to-real" && i + 1 < argc)
+        {
+            settings.pixelToRealModel = argv[++i];
+            settings.toPredictByPixelToReal = true;
+        }
+        else if (arg == "--optical" && i + 1 < argc)
+        {
+            settings.intrinsicCalibration = argv[++i];
+            settings.toPredictByOptical = true;
+        }
+        else if (arg == "--export")
+            settings.toExport = true;
+        else if (arg == "--jobs" && i + 1 < argc)
+            jobs = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--workers" && i + 1 < argc)
+            settings.workersPerSession = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--batch-size" && i + 1 < argc)
+            settings.detectionBatchSize = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--no-motion-gate")
+            settings.isMotionGateEnabled = false;
+        else if (arg == "--detection-interval" && i + 1 < argc)
+            settings.detectionInterval = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--input-size" && i + 1 < argc)
+            inputSizes = {std::stoi(argv[++i])};
+        else if (arg == "--input-sizes" && i + 1 < argc)
+        {
+            inputSizes.clear();
+            std::stringstream sizes(argv[++i]);
+            std::string size;
+            while (std::getline(sizes, size, ','))
+                inputSizes.push_back(std::stoi(size));
+        }
+        else if (!arg.empty() && arg[0] != '-')
+            sessions.push_back(arg);
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (anchorsFile.empty() || !BatchProcessor::loadAnchorPositions(anchorsFile, settings.anchorPositions))
+    {
+        std::cerr << "Anchor positions are required: --anchors <file> (anchorID x y [origin] per line)" << std::endl;
+        return 1;
+    }
+    if (sessions.empty())
+    {
+        std::cerr << "No session folders given" << std::endl;
+        return 1;
+    }
+    for (int size : inputSizes)
+    {
+        if (size < 32 || size % 32 != 0)
+        {
+            std::cerr << "Input size must be a multiple of 32: " << size << std::endl;
+            return 1;
+        }
+    }
+    if (inputSizes.empty())
+        inputSizes = {settings.detectorConfig.inputSize};
+    if (inputSizes.size() > 1)
+    {
+        // The coordinate error of a size must not come from tracked or reused boxes
+        settings.isMotionGateEnabled = false;
+        settings.detectionInterval = 1;
+    }
+    if (jobs == 0)
+        jobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / settings.workersPerSession);
+    jobs = std::min(jobs, static_cast<int>(sessions.size()));
+
+    std::cout << "Processing " << sessions.size() << " session(s), " << jobs << " in parallel" << std::endl;
+
+    // Per input size: detector latency (ms per frame) and coordinate error (m)
+    struct SizeResult { int size; double latency; int latencySessions; double error; int pairedPeople; };
+    std::vector<SizeResult> sizeResults;
+    std::atomic<int> failedSessions(0);
+    std::mutex outputMutex;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int inputSize : inputSizes)
+    {
+        settings.detectorConfig.inputSize = inputSize;
+        if (inputSizes.size() > 1)
+            std::cout << "Input size " << inputSize << std::endl;
+
+        BatchProcessor batchProcessor(settings);
+        std::atomic<size_t> nextSession(0);
+        SizeResult sizeResult = {inputSize, 0.0, 0, 0.0, 0};
+
+        std::vector<std::thread> threads;
+        for (int j = 0; j < jobs; j++)
+        {
+            threads.emplace_back([&]() {
+                for (size_t i = nextSession++; i < sessions.size(); i = nextSession++)
+                {
+                    SessionResult result = batchProcessor.processSession(sessions[i]);
+
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << std::fixed << std::setprecision(1) << "[" << (i + 1) << "/" << sessions.size() << "] " << result.folder << ": ";
+                    if (!result.success)
+                    {
+                        failedSessions++;
+                        std::cout << "FAILED (" << result.error << ")";
+                    }
+                    if (result.frames > 0)
+                        std::cout << " " << result.frames << " frames in " << result.seconds << " s (" << result.frames / std::max(result.seconds, 1e-6) << " fps)";
+                    if (result.exportedFrames > 0)
+                        std::cout << ", export " << result.exportedFrames << " frames in " << result.exportSeconds << " s ("
+                                  << result.exportedFrames / std::max(result.exportSeconds, 1e-6) << " fps)";
+                    if (result.detectionLatency > 0.0)
+                        std::cout << ", detector " << result.detectionLatency << " ms / frame, " << result.detectionThroughput << " fps";
+                    std::cout << std::endl;
+
+                    if (result.detectionLatency > 0.0)
+                    {
+                        sizeResult.latency += result.detectionLatency;
+                        sizeResult.latencySessions++;
+                    }
+                    sizeResult.error += result.coordinateError * result.pairedPeople;
+                    sizeResult.pairedPeople += result.pairedPeople;
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        sizeResults.push_back(sizeResult);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Done in " << seconds << " s, " << failedSessions << " failed" << std::endl;
+
+    // Latency 0: every frame was detected already (recorded or cached detections)
+    std::cout << std::setprecision(3) << "input size | detector ms / frame | paired people | coordinate error (m)" << std::endl;
+    for (const SizeResult& sizeResult : sizeResults)
+    {
+        std::cout << sizeResult.size << " | " << (sizeResult.latencySessions > 0 ? sizeResult.latency / sizeResult.latencySessions : 0.0)
+                  << " | " << sizeResult.pairedPeople << " | " << (sizeResult.pairedPeople > 0 ? sizeResult.error / sizeResult.pairedPeople : 0.0) << std::endl;
+    }
+
+    return failedSessions > 0 ? 2 : 0;
+}
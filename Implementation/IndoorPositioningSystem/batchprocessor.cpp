@@ -0,0 +1,222 @@
+#include "batchprocessor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "dataprocessor.h"
+#include "videoprocessor.h"
+#include "threadsafequeue.h"
+
+BatchProcessor::BatchProcessor(const BatchSettings& settings): settings(settings) {
+    // Intrinsic calibration is the same for all sessions (same camera)
+    if (!settings.intrinsicCalibration.empty()) {
+        cv::FileStorage fs(settings.intrinsicCalibration, cv::FileStorage::READ);
+        if (fs.isOpened()) {
+            fs["cameraMatrix"] >> cameraMatrix;
+            fs["optimalCameraMatrix"] >> optimalCameraMatrix;
+            fs["distortionCoeffs"] >> distCoeffs;
+        } else {
+            std::cerr << "Error opening file: " << settings.intrinsicCalibration << std::endl;
+        }
+    }
+}
+
+//-------------------------------- Input files --------------------------------
+// One anchor per line: anchorID x y [origin]
+bool BatchProcessor::loadAnchorPositions(const std::string& filename, std::vector<AnchorPosition>& anchorPositions) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream ss(line);
+        AnchorPosition anchorPosition = {0, 0.0, 0.0, false};
+        std::string origin;
+        if (!(ss >> anchorPosition.anchorID >> anchorPosition.x >> anchorPosition.y)) {
+            return false;
+        }
+        anchorPosition.isOrigin = (ss >> origin) && origin == "origin";
+        anchorPositions.push_back(anchorPosition);
+    }
+
+    return !anchorPositions.empty();
+}
+
+std::vector<std::string> BatchProcessor::findSessions(const std::string& archiveFolder) {
+    std::vector<std::string> sessions;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(archiveFolder, error)) {
+        if (entry.is_regular_file() && entry.path().filename() == "video_timestamps.txt") {
+            sessions.push_back(entry.path().parent_path().string());
+        }
+    }
+    std::sort(sessions.begin(), sessions.end());
+
+    return sessions;
+}
+
+//-------------------------------- Process one session --------------------------------
+SessionResult BatchProcessor::processSession(const std::string& folder) const {
+    SessionResult result;
+    result.folder = folder;
+
+    std::filesystem::path directory(folder);
+    std::string videoFileName = (directory / "video.avi").string();
+    if (!std::filesystem::exists(videoFileName)) {
+        videoFileName = (directory / "video.mp4").string();
+    }
+    std::string UWBDataFileName = (directory / "UWB_timestamps.txt").string();
+    std::string videoTimestampsFileName = (directory / "video_timestamps.txt").string();
+    if (!std::filesystem::exists(videoFileName) || !std::filesystem::exists(UWBDataFileName) || !std::filesystem::exists(videoTimestampsFileName)) {
+        result.error = "Missing required files (video.avi or video.mp4, UWB_timestamps.txt, video_timestamps.txt)";
+        return result;
+    }
+
+    // The same processors as in the GUI. Video Processor is destroyed first (it uses Data Processor)
+    ThreadSafeQueue frameQueue(100);
+    DataProcessor dataProcessor(frameQueue);
+    VideoProcessor videoProcessor(frameQueue, &dataProcessor, settings.workersPerSession);
+    videoProcessor.setFrameCacheBudget(0); // one forward pass, frames are never decoded again (sessions run in parallel)
+    videoProcessor.setDetectionBatchSize(settings.detectionBatchSize);
+    videoProcessor.setMotionGate(settings.isMotionGateEnabled);
+    videoProcessor.setDetectionInterval(settings.detectionInterval);
+
+    dataProcessor.loadData(folder, UWBDataFileName, videoTimestampsFileName);
+    dataProcessor.setAnchorPositions(settings.anchorPositions);
+
+    if (!settings.detectorConfig.model.empty()) {
+        videoProcessor.initHumanDetector(settings.detectorConfig);
+    }
+    if (!optimalCameraMatrix.empty()) {
+        videoProcessor.setOptimalCameraMatrix(optimalCameraMatrix);
+    }
+    if (!distCoeffs.empty()) {
+        videoProcessor.setDistCoeffs(distCoeffs);
+    }
+    if (!cameraMatrix.empty()) {
+        videoProcessor.setCameraMatrix(cameraMatrix);
+        dataProcessor.setCameraMatrix(cameraMatrix);
+    }
+
+    bool toPredict = settings.toPredictByPixelToReal || settings.toPredictByOptical;
+    if (settings.toPredictByPixelToReal && (dataProcessor.loadPixelToRealModelParams(QString::fromStdString(settings.pixelToRealModel)) != 0
+                                            || dataProcessor.setPredict(true, PredictionType::PredictionByPixelToReal) == -1)) {
+        result.error = "Failed to load Pixel-to-Real model: " + settings.pixelToRealModel;
+        return result;
+    }
+    if (settings.toPredictByOptical && dataProcessor.setPredict(true, PredictionType::PredictionByOptical) == -1) {
+        result.error = "Optical prediction requires intrinsic calibration (cameraMatrix)";
+        return result;
+    }
+
+    videoProcessor.init(videoFileName);
+    if (toPredict && videoProcessor.setPredict(true) == -1) {
+        result.error = "Human Detector is not initialized (no weights and no recorded detections)";
+        videoProcessor.stopProcessing();
+        return result;
+    }
+
+    int totalFrames = std::min(videoProcessor.getTotalFrames(), dataProcessor.getTotalFrames());
+    if (totalFrames <= 0) {
+        result.error = "Failed to open video: " + videoFileName;
+        videoProcessor.stopProcessing();
+        return result;
+    }
+
+    //---- Playback pass: synchronization + coordinates for every frame ----
+    std::filesystem::create_directories(directory / "export");
+    std::ofstream coordinatesFile((directory / "export" / "coordinates.txt").string());
+    coordinatesFile << "# frameID timestamp uwb <count> [tagID x y]... pixelToReal <count> [x y]... optical <count> [x y]... tags <count> [tagID of the person, -1: none]..." << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    QMetaObject::invokeMethod(&videoProcessor, "processVideo", Qt::QueuedConnection);
+
+    double coordinateError = 0.0;
+    UWBVideoData data;
+    int lastFrameID = 0;
+    while (frameQueue.dequeue(data)) {
+        if (data.videoData.id <= lastFrameID) {
+            break; // video restarted from the beginning
+        }
+        lastFrameID = data.videoData.id;
+
+        coordinatesFile << data.videoData.id << " " << data.videoData.timestamp << " uwb " << data.uwbData.size();
+        for (const UWBData& tag : data.uwbData) {
+            coordinatesFile << " " << tag.tagID << " " << tag.coordinates.x() << " " << tag.coordinates.y();
+        }
+        coordinatesFile << " pixelToReal " << data.pixelToRealCoordinates.size();
+        for (const QPointF& coordinates : data.pixelToRealCoordinates) {
+            coordinatesFile << " " << coordinates.x() << " " << coordinates.y();
+        }
+        coordinatesFile << " optical " << data.opticalCoordinates.size();
+        for (const QPointF& coordinates : data.opticalCoordinates) {
+            coordinatesFile << " " << coordinates.x() << " " << coordinates.y();
+        }
+        coordinatesFile << " tags " << data.personTagIDs.size();
+        for (int tagID : data.personTagIDs) {
+            coordinatesFile << " " << tagID;
+        }
+        coordinatesFile << "\n";
+
+        // Accuracy: located people against the UWB positions of their tags
+        const std::vector<QPointF>& personPositions = !data.opticalCoordinates.empty() ? data.opticalCoordinates : data.pixelToRealCoordinates;
+        for (size_t i = 0; i < data.personTagIDs.size() && i < personPositions.size(); ++i) {
+            auto tag = std::find_if(data.uwbData.begin(), data.uwbData.end(), [&](const UWBData& uwb) { return uwb.tagID == data.personTagIDs[i]; });
+            if (tag != data.uwbData.end()) {
+                QPointF difference = personPositions[i] - tag->coordinates;
+                coordinateError += std::hypot(difference.x(), difference.y());
+                result.pairedPeople++;
+            }
+        }
+
+        result.frames++;
+        if (lastFrameID >= totalFrames) {
+            break;
+        }
+    }
+    videoProcessor.pauseProcessing();
+    coordinatesFile.close();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.coordinateError = result.pairedPeople > 0 ? coordinateError / result.pairedPeople : 0.0;
+
+    //---- Export pass (the same as frame-by-frame export in the GUI) ----
+    result.success = true;
+    if (settings.toExport) {
+        std::vector<int> frameRangeToExport;
+        for (int i = 1; i < totalFrames; ++i) { // export reads the timestamp of frame (i - 1)
+            frameRangeToExport.push_back(i);
+        }
+
+        std::promise<bool> exportPromise;
+        std::future<bool> exportFinished = exportPromise.get_future();
+        QObject::connect(&videoProcessor, &VideoProcessor::exportFinished, [&exportPromise](bool success) {
+            exportPromise.set_value(success);
+        });
+
+        start = std::chrono::steady_clock::now();
+        videoProcessor.setFrameRangeToExport(frameRangeToExport, ExportType::FrameByFrameExport);
+        frameQueue.clear(); // releases the pipeline if it waits for space in the queue; it is flushed by the export
+        videoProcessor.resumeProcessing();
+        result.success = exportFinished.get();
+        result.exportSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.exportedFrames = result.success ? static_cast<int>(frameRangeToExport.size()) : 0;
+        if (!result.success) {
+            result.error = "Export failed";
+        }
+    }
+
+    result.detectionLatency = videoProcessor.getDetectionLatency();
+    result.detectionThroughput = videoProcessor.getDetectionThroughput();
+    videoProcessor.stopProcessing();
+    return result;
+}
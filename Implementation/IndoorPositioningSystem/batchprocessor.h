@@ -0,0 +1,70 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+/*********************************************** Batch Processor ********************************************************
+ * Headless processing of recorded sessions (no widgets, no Video Player). Used by IndoorPositioningSystemBatch.
+ * A session folder contains: video.avi (or video.mp4), UWB_timestamps.txt, video_timestamps.txt
+ *
+ * For each session, the same classes as in the GUI are used (DataProcessor, VideoProcessor, HumanDetector):
+ *  1. playback pass: every frame is synchronized with UWB data; UWB, Pixel-to-Real and Optical coordinates are written to
+ *     <session>/export/coordinates.txt
+ *  2. export pass (optional): frame-by-frame export (uwb_to_bb_mapping_<n>.txt), as "Export" in the GUI
+ *
+ * Sessions are independent, so several of them are processed in parallel (each with its own processors and threads).
+*************************************************************************************************************************/
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "structures.h"
+#include "detectorconfig.h"
+
+struct BatchSettings {
+    std::vector<AnchorPosition> anchorPositions;
+    DetectorConfig detectorConfig; // Human Detector (no model: not used)
+    std::string pixelToRealModel; // XGBoost model
+    std::string intrinsicCalibration; // cameraMatrix, optimalCameraMatrix, distortionCoeffs
+    bool toPredictByPixelToReal = false;
+    bool toPredictByOptical = false;
+    bool toExport = false;
+    int workersPerSession = 1; // detection workers of each session
+    int detectionBatchSize = 0; // frames per forward pass in export; 0: measured
+    bool isMotionGateEnabled = true; // playback pass: detections are reused while people stand still
+    int detectionInterval = 1; // playback pass: people are detected every n-th frame (tracked in between)
+
+    BatchSettings() {}
+};
+
+struct SessionResult {
+    std::string folder;
+    bool success = false;
+    std::string error;
+    int frames = 0; // playback pass
+    double seconds = 0.0;
+    int exportedFrames = 0; // export pass
+    double exportSeconds = 0.0;
+    double detectionLatency = 0.0; // ms per frame (0: all detections recorded or cached)
+    double detectionThroughput = 0.0; // frames per second of all detectors
+    int pairedPeople = 0; // people paired with a tag (playback pass)
+    double coordinateError = 0.0; // mean distance (m) of paired people to their tags
+
+    SessionResult() {}
+};
+
+class BatchProcessor
+{
+public:
+    explicit BatchProcessor(const BatchSettings& settings);
+
+    SessionResult processSession(const std::string& folder) const;
+
+    static bool loadAnchorPositions(const std::string& filename, std::vector<AnchorPosition>& anchorPositions);
+    static std::vector<std::string> findSessions(const std::string& archiveFolder); // all session folders below the archive folder
+
+private:
+    BatchSettings settings;
+    cv::Mat cameraMatrix, optimalCameraMatrix, distCoeffs;
+};
+
+#endif // BATCHPROCESSOR_H
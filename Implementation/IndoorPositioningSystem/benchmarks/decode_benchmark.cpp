@@ -0,0 +1,169 @@
+/************************************************ Decode Benchmark ******************************************************
+ * Raw decode throughput of recorded videos per Video Decoder backend (FFmpeg, OpenCV) x number of decoder threads:
+ *  - read: decode + conversion to BGR (as played by Video Processor), into a reused buffer
+ *  - grab: decode only (as when seeking forward or prefetching cached frames)
+ * Wall time and CPU time of the process per frame are reported, summed over all videos. Read runs also check the
+ * timestamps of the frames: irregular steps (not increasing, or off by more than half a frame from 1 / fps) are counted.
+ *
+ * Usage: decode_benchmark --videos <video | archive folder> [options]
+ *  --videos <path>           a video, or a folder searched for session videos (video.avi / video.mp4), e.g. "Recorded Experiments"
+ *  --frames <n>              frames decoded per video (default: all)
+ *  --backend <name>          ffmpeg, opencv or all (default: all)
+ *  --threads <n,n,...>       FFmpeg decoder threads, 0: auto (default: 1,2,4,0); OpenCV decodes with its defaults
+*************************************************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "../videodecoder.h"
+
+struct DecodeResult {
+    int frames = 0;
+    double realTime = 0.0, cpuTime = 0.0; // ms
+    int irregularTimestamps = 0;
+    std::string decoderName;
+};
+
+static std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        values.push_back(std::stoi(value));
+    }
+    return values;
+}
+
+// Session videos below the folder, or the video itself
+static std::vector<std::string> findVideos(const std::string& path) {
+    std::vector<std::string> videos;
+    if (!std::filesystem::is_directory(path)) {
+        videos.push_back(path);
+        return videos;
+    }
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && (name == "video.avi" || name == "video.mp4")) {
+            videos.push_back(entry.path().string());
+        }
+    }
+    std::sort(videos.begin(), videos.end());
+    return videos;
+}
+
+// One pass over the video from the first frame
+static DecodeResult decodeVideo(const std::string& filename, VideoDecoder::Backend backend, int threads, bool isConverted, int maxFrames) {
+    DecodeResult result;
+    std::unique_ptr<VideoDecoder> decoder = VideoDecoder::create(filename, backend, threads);
+    if (!decoder->isOpened()) {
+        std::cerr << "Error: Cannot open " << filename << std::endl;
+        return result;
+    }
+    result.decoderName = decoder->getName();
+    double frameInterval = decoder->getFPS() > 0.0 ? 1000.0 / decoder->getFPS() : 0.0;
+    double previousTimestamp = -1.0;
+
+    cv::Mat frame;
+    std::clock_t cpuStart = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    while ((maxFrames <= 0 || result.frames < maxFrames) && (isConverted ? decoder->read(frame) : decoder->grab())) {
+        ++result.frames;
+        if (isConverted) {
+            double timestamp = decoder->getTimestamp();
+            if (timestamp < 0.0 || (previousTimestamp >= 0.0 && (timestamp <= previousTimestamp
+                || (frameInterval > 0.0 && std::abs(timestamp - previousTimestamp - frameInterval) > frameInterval / 2)))) {
+                ++result.irregularTimestamps;
+            }
+            previousTimestamp = timestamp;
+        }
+    }
+    result.realTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.cpuTime = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    std::string videosPath, backendName = "all";
+    std::vector<int> threadCounts = {1, 2, 4, 0};
+    int frameCount = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--videos" && i + 1 < argc) videosPath = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc) frameCount = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--backend" && i + 1 < argc) backendName = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) threadCounts = parseList(argv[++i]);
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (videosPath.empty() || (backendName != "all" && backendName != "ffmpeg" && backendName != "opencv")) {
+        std::cerr << "Usage: decode_benchmark --videos <video | archive folder> [--frames n] [--backend ffmpeg | opencv | all] [--threads n,n]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> videos = findVideos(videosPath);
+    if (videos.empty()) {
+        std::cerr << "Error: No videos found in " << videosPath << std::endl;
+        return 1;
+    }
+
+    // FFmpeg per thread count; OpenCV once
+    std::vector<std::pair<VideoDecoder::Backend, int>> cases;
+    if (backendName != "opencv") {
+        if (VideoDecoder::isAvailable(VideoDecoder::Backend::FFmpeg)) {
+            for (int threads : threadCounts) {
+                cases.emplace_back(VideoDecoder::Backend::FFmpeg, threads);
+            }
+        } else {
+            std::cerr << "Built without FFmpeg, only OpenCV is measured" << std::endl;
+        }
+    }
+    if (backendName != "ffmpeg" || cases.empty()) {
+        cases.emplace_back(VideoDecoder::Backend::OpenCV, 0);
+    }
+
+    std::cout << videos.size() << " videos, " << std::thread::hardware_concurrency() << " CPUs, OpenCV " << CV_VERSION << std::endl;
+    std::cout << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(10) << "Frames" << std::setw(12) << "Time" << std::setw(12) << "CPU"
+              << std::setw(10) << "FPS" << std::setw(12) << "Irregular" << "  Decoder" << std::endl;
+
+    for (const auto& [backend, threads] : cases) {
+        for (bool isConverted : {true, false}) {
+            DecodeResult total;
+            for (const std::string& video : videos) {
+                DecodeResult result = decodeVideo(video, backend, threads, isConverted, frameCount);
+                total.frames += result.frames;
+                total.realTime += result.realTime;
+                total.cpuTime += result.cpuTime;
+                total.irregularTimestamps += result.irregularTimestamps;
+                if (total.decoderName.empty()) {
+                    total.decoderName = result.decoderName;
+                }
+            }
+            if (total.frames == 0) {
+                continue;
+            }
+
+            std::string name = std::string("BM_Decode/") + (backend == VideoDecoder::Backend::FFmpeg ? "ffmpeg" : "opencv")
+                               + (backend == VideoDecoder::Backend::FFmpeg ? "/threads:" + std::to_string(threads) : "") + (isConverted ? "/read" : "/grab");
+            std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(3) << std::setw(10) << total.frames
+                      << std::setw(9) << total.realTime / total.frames << " ms" << std::setw(9) << total.cpuTime / total.frames << " ms"
+                      << std::setprecision(1) << std::setw(10) << 1000.0 * total.frames / total.realTime
+                      << std::setw(12) << (isConverted ? std::to_string(total.irregularTimestamps) : "-") << "  " << total.decoderName << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*********************************************** Detector Backend Benchmark *******************************************
+ * Latency and recall of Human Detector backends (DetectorConfig) on frames of a recorded experiment video
+ *  - latency: ms per frame of HumanDetector::detectPeople (one frame per forward pass, after warm-up)
+ *  - recall: people found by the first backend (the reference, e.g. Darknet fp32) that a backend also finds
+ *    (a box with IoU >= MIN_IOU), so a faster backend (int8, fp16, a smaller ONNX model) is judged by what it misses
+ *
+ * Usage: detector_backend_benchmark <video.avi> <frames> <backend>...
+ *  - backend: a model folder or detector.yml (see DetectorConfig), the first one is the reference
+ *  - every (video frame count / frames)-th frame is detected, resized to 640x640 (as the detector input)
+*************************************************************************************************************************/
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "../detectorconfig.h"
+#include "../humandetector.h"
+
+static const double MIN_IOU = 0.5;
+static const int WARM_UP_FRAMES = 3;
+
+static bool readFile(const std::string& filename, std::vector<uchar>& buffer) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static std::vector<cv::Rect> keptBoxes(const std::pair<std::vector<cv::Rect>, std::vector<int>>& detections) {
+    std::vector<cv::Rect> boxes;
+    for (int index : detections.second) {
+        boxes.push_back(detections.first[index]);
+    }
+    return boxes;
+}
+
+static double iou(const cv::Rect& a, const cv::Rect& b) {
+    double intersection = (a & b).area();
+    double area = a.area() + b.area() - intersection;
+    return area > 0 ? intersection / area : 0.0;
+}
+
+// Reference boxes matched by a box of the backend (each backend box matches once)
+static int countFound(const std::vector<cv::Rect>& reference, const std::vector<cv::Rect>& boxes) {
+    std::vector<bool> isUsed(boxes.size(), false);
+    int found = 0;
+    for (const cv::Rect& referenceBox : reference) {
+        int best = -1;
+        double bestIoU = MIN_IOU;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            double overlap = iou(referenceBox, boxes[i]);
+            if (!isUsed[i] && overlap >= bestIoU) {
+                best = static_cast<int>(i);
+                bestIoU = overlap;
+            }
+        }
+        if (best >= 0) {
+            isUsed[best] = true;
+            ++found;
+        }
+    }
+    return found;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: detector_backend_benchmark <video.avi> <frames> <backend>..." << std::endl;
+        return 1;
+    }
+    const cv::Size detectionFrameSize(640, 640);
+    const int frameCount = std::max(1, std::stoi(argv[2]));
+
+    cv::VideoCapture video(argv[1]);
+    int totalFrames = static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT));
+    int step = std::max(1, totalFrames / frameCount);
+    std::vector<cv::Mat> frames;
+    cv::Mat frame, resized;
+    for (int position = 0; static_cast<int>(frames.size()) < frameCount && video.read(frame); ++position) {
+        if (position % step == 0) {
+            cv::resize(frame, resized, detectionFrameSize);
+            frames.push_back(resized.clone());
+        }
+    }
+    if (frames.empty()) {
+        std::cerr << "Error: No frames read from " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::cout << frames.size() << " frames, " << cv::getNumThreads() << " threads" << std::endl;
+    std::cout << std::left << std::setw(40) << "backend" << std::setw(14) << "ms / frame" << std::setw(10) << "people" << "recall" << std::endl;
+
+    std::vector<std::vector<cv::Rect>> reference;
+    for (int b = 3; b < argc; ++b) {
+        DetectorConfig config;
+        std::string error;
+        bool isLoaded = std::filesystem::is_directory(argv[b]) ? DetectorConfig::fromFolder(argv[b], config, error)
+                                                               : DetectorConfig::load(argv[b], config, error);
+        std::vector<uchar> configuration, model;
+        if (!isLoaded || (config.format == DetectorFormat::Darknet && !readFile(config.configuration, configuration)) || !readFile(config.model, model)) {
+            std::cerr << argv[b] << ": " << (error.empty() ? "model files not read" : error) << std::endl;
+            continue;
+        }
+
+        cv::Mat calibrationBlob;
+        if (config.precision == DetectorPrecision::INT8 && !config.calibrationFolder.empty()) {
+            calibrationBlob = HumanDetector::readCalibrationBlob(config.calibrationFolder, detectionFrameSize);
+        }
+        HumanDetector detector;
+        detector.initHumanDetection(config, configuration, model, calibrationBlob);
+        if (!detector.isInitialized()) {
+            continue;
+        }
+
+        for (int i = 0; i < WARM_UP_FRAMES; ++i) {
+            detector.detectPeople(frames[i % frames.size()], detectionFrameSize);
+        }
+
+        cv::TickMeter timer;
+        std::vector<std::vector<cv::Rect>> detections;
+        for (const cv::Mat& input : frames) {
+            timer.start();
+            auto result = detector.detectPeople(input, detectionFrameSize);
+            timer.stop();
+            detections.push_back(keptBoxes(result));
+        }
+
+        int people = 0, referencePeople = 0, found = 0;
+        if (reference.empty()) {
+            reference = detections;
+        }
+        for (size_t i = 0; i < frames.size(); ++i) {
+            people += static_cast<int>(detections[i].size());
+            referencePeople += static_cast<int>(reference[i].size());
+            found += countFound(reference[i], detections[i]);
+        }
+
+        std::string name = std::filesystem::path(argv[b]).filename().string() + " (" + config.describe() + ")";
+        std::cout << std::left << std::setw(40) << name << std::setw(14) << timer.getTimeMilli() / frames.size() << std::setw(10) << people
+                  << (referencePeople > 0 ? static_cast<double>(found) / referencePeople : 1.0) << std::endl;
+    }
+
+    return 0;
+}
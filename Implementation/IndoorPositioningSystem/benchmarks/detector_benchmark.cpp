@@ -0,0 +1,290 @@
+/*********************************************** Detector Benchmark *************************************************
+ * Micro-benchmark of HumanDetector::detectPeople on frames of recorded experiments, per phase:
+ *  - blob: blobFromImage (scale, channel swap, NCHW)
+ *  - forward: forward pass of the network
+ *  - postprocessing: decoding of the outputs + NMS
+ *  - total: the whole call (wall time); CPU time of the process is reported next to it
+ * for every backend x input size x number of OpenCV threads. Every case is repeated (--repetitions), each repetition
+ * detects all frames once (one frame per call); mean, median and standard deviation of the repetitions are reported.
+ *
+ * Output follows Google Benchmark: a console table and, with --json, the same JSON schema (context + benchmarks with
+ * run_type "iteration" / "aggregate", times in ms per frame), so runs of two commits can be compared by its tools
+ * (compare.py benchmarks before.json after.json).
+ *
+ * Usage: detector_benchmark --frames-from <video | archive folder> --backend <model folder | detector.yml>... [options]
+ *  --frames-from <path>      a video, or a folder searched for session videos (video.avi / video.mp4), e.g. "Recorded Experiments"
+ *  --frames <n>              frames taken evenly from the videos (default: 50)
+ *  --backend <path>          model folder or detector.yml (see DetectorConfig); repeated for several backends
+ *  --input-sizes <n,n,...>   letterboxed detector input sizes (default: 640)
+ *  --threads <n,n,...>       OpenCV threads (default: the OpenCV default)
+ *  --repetitions <n>         (default: 5)
+ *  --json <file>             JSON output
+*************************************************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "../detectorconfig.h"
+#include "../framepreprocessor.h"
+#include "../humandetector.h"
+
+static const int WARM_UP_FRAMES = 3;
+
+struct Run {
+    std::string name;
+    std::vector<double> realTimes, cpuTimes; // ms per frame, one per repetition
+};
+
+static bool readFile(const std::string& filename, std::vector<uchar>& buffer) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string value;
+    while (std::getline(stream, value, ',')) {
+        values.push_back(std::stoi(value));
+    }
+    return values;
+}
+
+// Session videos below the folder, or the video itself
+static std::vector<std::string> findVideos(const std::string& path) {
+    std::vector<std::string> videos;
+    if (!std::filesystem::is_directory(path)) {
+        videos.push_back(path);
+        return videos;
+    }
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && (name == "video.avi" || name == "video.mp4")) {
+            videos.push_back(entry.path().string());
+        }
+    }
+    std::sort(videos.begin(), videos.end());
+    return videos;
+}
+
+// Frames evenly spread over the videos (and over each video)
+static std::vector<cv::Mat> readFrames(const std::vector<std::string>& videos, int frameCount) {
+    std::vector<cv::Mat> frames;
+    for (size_t v = 0; v < videos.size(); ++v) {
+        int videoFrames = frameCount * static_cast<int>(v + 1) / static_cast<int>(videos.size()) - frameCount * static_cast<int>(v) / static_cast<int>(videos.size());
+        cv::VideoCapture video(videos[v]);
+        int totalFrames = static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT));
+        for (int i = 0; i < videoFrames && video.isOpened(); ++i) {
+            video.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(totalFrames) * i / std::max(1, videoFrames));
+            cv::Mat frame;
+            if (video.read(frame)) {
+                frames.push_back(frame);
+            }
+        }
+    }
+    return frames;
+}
+
+static double mean(const std::vector<double>& values) {
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static double stddev(const std::vector<double>& values) {
+    if (values.size() < 2) {
+        return 0.0;
+    }
+    double average = mean(values), sum = 0.0;
+    for (double value : values) {
+        sum += (value - average) * (value - average);
+    }
+    return std::sqrt(sum / (values.size() - 1));
+}
+
+static std::string escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void writeJSON(const std::string& filename, const std::vector<Run>& runs, int frames) {
+    std::ofstream file(filename);
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    file << "{\n  \"context\": {\n"
+         << "    \"date\": \"" << date << "\",\n"
+         << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+         << "    \"opencv_version\": \"" << CV_VERSION << "\",\n"
+         << "    \"frames\": " << frames << ",\n"
+         << "    \"library_build_type\": \"release\"\n"
+         << "  },\n  \"benchmarks\": [";
+
+    bool isFirst = true;
+    auto writeEntry = [&](const std::string& name, const std::string& runName, const std::string& runType, const std::string& aggregate,
+                          int repetitions, int repetitionIndex, double realTime, double cpuTime) {
+        file << (isFirst ? "\n" : ",\n") << "    {\"name\": \"" << escape(name) << "\", \"run_name\": \"" << escape(runName)
+             << "\", \"run_type\": \"" << runType << "\", \"repetitions\": " << repetitions;
+        if (runType == "aggregate") {
+            file << ", \"aggregate_name\": \"" << aggregate << "\"";
+        } else {
+            file << ", \"repetition_index\": " << repetitionIndex;
+        }
+        file << ", \"iterations\": " << frames << ", \"real_time\": " << realTime << ", \"cpu_time\": " << cpuTime << ", \"time_unit\": \"ms\"}";
+        isFirst = false;
+    };
+
+    for (const Run& run : runs) {
+        int repetitions = static_cast<int>(run.realTimes.size());
+        for (int r = 0; r < repetitions; ++r) {
+            writeEntry(run.name, run.name, "iteration", "", repetitions, r, run.realTimes[r], run.cpuTimes[r]);
+        }
+        writeEntry(run.name + "_mean", run.name, "aggregate", "mean", repetitions, 0, mean(run.realTimes), mean(run.cpuTimes));
+        writeEntry(run.name + "_median", run.name, "aggregate", "median", repetitions, 0, median(run.realTimes), median(run.cpuTimes));
+        writeEntry(run.name + "_stddev", run.name, "aggregate", "stddev", repetitions, 0, stddev(run.realTimes), stddev(run.cpuTimes));
+    }
+    file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string framesFrom, jsonFile;
+    std::vector<std::string> backends;
+    std::vector<int> inputSizes = {640}, threadCounts = {cv::getNumThreads()};
+    int frameCount = 50, repetitions = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--frames-from" && i + 1 < argc) framesFrom = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc) frameCount = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--backend" && i + 1 < argc) backends.push_back(argv[++i]);
+        else if (arg == "--input-sizes" && i + 1 < argc) inputSizes = parseList(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) threadCounts = parseList(argv[++i]);
+        else if (arg == "--repetitions" && i + 1 < argc) repetitions = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--json" && i + 1 < argc) jsonFile = argv[++i];
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (framesFrom.empty() || backends.empty()) {
+        std::cerr << "Usage: detector_benchmark --frames-from <video | archive folder> --backend <model folder | detector.yml>... "
+                     "[--frames n] [--input-sizes n,n] [--threads n,n] [--repetitions n] [--json file]" << std::endl;
+        return 1;
+    }
+
+    std::vector<cv::Mat> frames = readFrames(findVideos(framesFrom), frameCount);
+    if (frames.empty()) {
+        std::cerr << "Error: No frames read from " << framesFrom << std::endl;
+        return 1;
+    }
+    std::cout << frames.size() << " frames, " << std::thread::hardware_concurrency() << " CPUs, OpenCV " << CV_VERSION << std::endl;
+    std::cout << std::left << std::setw(64) << "Benchmark" << std::right << std::setw(12) << "Time" << std::setw(12) << "CPU" << std::setw(12) << "Iterations" << std::endl;
+
+    std::vector<Run> runs;
+    for (const std::string& backend : backends) {
+        DetectorConfig config;
+        std::string error;
+        bool isLoaded = std::filesystem::is_directory(backend) ? DetectorConfig::fromFolder(backend, config, error)
+                                                               : DetectorConfig::load(backend, config, error);
+        std::vector<uchar> configuration, model;
+        if (!isLoaded || (config.format == DetectorFormat::Darknet && !readFile(config.configuration, configuration)) || !readFile(config.model, model)) {
+            std::cerr << backend << ": " << (error.empty() ? "model files not read" : error) << std::endl;
+            continue;
+        }
+        std::string backendName = std::filesystem::path(backend).filename().string();
+        std::replace(backendName.begin(), backendName.end(), ' ', '_');
+
+        for (int inputSize : inputSizes) {
+            // Frames letterboxed as in the application (whole frame, no ROI)
+            FramePreprocessor preprocessor;
+            preprocessor.setDetectorInputSize(inputSize, config.isInputSquare);
+            preprocessor.setFrameSize(frames.front().size());
+            std::vector<cv::Mat> inputs(frames.size());
+            for (size_t i = 0; i < frames.size(); ++i) {
+                preprocessor.resizeForDetection(frames[i], inputs[i]);
+            }
+
+            cv::Mat calibrationBlob;
+            if (config.precision == DetectorPrecision::INT8 && !config.calibrationFolder.empty()) {
+                calibrationBlob = HumanDetector::readCalibrationBlob(config.calibrationFolder, cv::Size(inputSize, inputSize));
+            }
+            HumanDetector detector;
+            detector.initHumanDetection(config, configuration, model, calibrationBlob);
+            if (!detector.isInitialized()) {
+                continue;
+            }
+
+            for (int threads : threadCounts) {
+                cv::setNumThreads(threads);
+                for (int i = 0; i < WARM_UP_FRAMES; ++i) {
+                    detector.detectPeople(inputs[i % inputs.size()], inputs[i % inputs.size()].size());
+                }
+
+                std::string name = "BM_DetectPeople/" + backendName + "/input:" + std::to_string(inputSize) + "/threads:" + std::to_string(threads);
+                Run blob{name + "/blob"}, forward{name + "/forward"}, postprocessing{name + "/postprocessing"}, total{name + "/total"};
+
+                for (int r = 0; r < repetitions; ++r) {
+                    detector.resetTiming();
+                    std::clock_t cpuStart = std::clock();
+                    auto start = std::chrono::steady_clock::now();
+                    for (const cv::Mat& input : inputs) {
+                        detector.detectPeople(input, input.size());
+                    }
+                    double realTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / inputs.size();
+                    double cpuTime = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC / inputs.size();
+
+                    // CPU time is measured for the whole call only
+                    blob.realTimes.push_back(detector.getAverageBlobTime());
+                    blob.cpuTimes.push_back(detector.getAverageBlobTime());
+                    forward.realTimes.push_back(detector.getAverageForwardTime());
+                    forward.cpuTimes.push_back(detector.getAverageForwardTime());
+                    postprocessing.realTimes.push_back(detector.getAveragePostprocessingTime());
+                    postprocessing.cpuTimes.push_back(detector.getAveragePostprocessingTime());
+                    total.realTimes.push_back(realTime);
+                    total.cpuTimes.push_back(cpuTime);
+                }
+
+                for (const Run& run : {blob, forward, postprocessing, total}) {
+                    std::cout << std::left << std::setw(64) << run.name + "_mean" << std::right << std::fixed << std::setprecision(3)
+                              << std::setw(9) << mean(run.realTimes) << " ms" << std::setw(9) << mean(run.cpuTimes) << " ms" << std::setw(12) << inputs.size() << std::endl;
+                    runs.push_back(run);
+                }
+            }
+        }
+    }
+
+    if (!jsonFile.empty()) {
+        writeJSON(jsonFile, runs, static_cast<int>(frames.size()));
+        std::cout << "JSON: " << jsonFile << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*********************************************** Preprocessing Benchmark *********************************************
+ * Per-frame preprocessing time of the video player before and after FramePreprocessor
+ *  - before: initUndistortRectifyMap + remap + cvtColor(BGR2RGB) + resize to 640x640 + resize back (per frame)
+ *  - after: cached maps, one stripe-parallel pass producing display frame and detector input
+ *
+ * Usage: preprocessing_benchmark [video.avi] [calibration.xml] [frames]
+ *  - without video a synthetic 1280x720 frame is used
+ *  - without calibration a synthetic barrel distortion is used
+*************************************************************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "../framepreprocessor.h"
+
+static void preprocessBefore(const cv::Mat& source, const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Mat& optimalCameraMatrix,
+                             const cv::Size& detectionFrameSize, cv::Mat& displayFrame, cv::Mat& detectorInput) {
+    cv::Mat map1, map2, frame;
+    cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), optimalCameraMatrix, source.size(), CV_16SC2, map1, map2);
+    cv::remap(source, frame, map1, map2, cv::INTER_LINEAR);
+    cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
+    cv::resize(frame, detectorInput, detectionFrameSize);
+    cv::resize(detectorInput, displayFrame, source.size());
+}
+
+int main(int argc, char* argv[]) {
+    const cv::Size detectionFrameSize(640, 640);
+    int frames = argc > 3 ? std::stoi(argv[3]) : 300;
+
+    std::vector<cv::Mat> sourceFrames;
+    if (argc > 1) {
+        cv::VideoCapture video(argv[1]);
+        cv::Mat frame;
+        while (static_cast<int>(sourceFrames.size()) < 50 && video.read(frame)) {
+            sourceFrames.push_back(frame.clone());
+        }
+    }
+    if (sourceFrames.empty()) {
+        cv::Mat frame(720, 1280, CV_8UC3);
+        cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+        sourceFrames.push_back(frame);
+    }
+    cv::Size frameSize = sourceFrames[0].size();
+
+    cv::Mat cameraMatrix, distCoeffs, optimalCameraMatrix;
+    if (argc > 2) {
+        cv::FileStorage fs(argv[2], cv::FileStorage::READ);
+        fs["cameraMatrix"] >> cameraMatrix;
+        fs["optimalCameraMatrix"] >> optimalCameraMatrix;
+        fs["distortionCoeffs"] >> distCoeffs;
+    }
+    if (cameraMatrix.empty() || distCoeffs.empty()) {
+        cameraMatrix = (cv::Mat_<double>(3, 3) << frameSize.width, 0, frameSize.width / 2.0, 0, frameSize.width, frameSize.height / 2.0, 0, 0, 1);
+        distCoeffs = (cv::Mat_<double>(1, 5) << -0.3, 0.1, 0, 0, 0);
+    }
+    if (optimalCameraMatrix.empty()) {
+        optimalCameraMatrix = cv::getOptimalNewCameraMatrix(cameraMatrix, distCoeffs, frameSize, 1);
+    }
+
+    std::cout << "Frame " << frameSize << ", " << frames << " frames, " << cv::getNumThreads() << " threads" << std::endl;
+
+    cv::Mat displayFrame, detectorInput;
+    cv::TickMeter before, after;
+
+    for (int i = 0; i < frames; ++i) {
+        before.start();
+        preprocessBefore(sourceFrames[i % sourceFrames.size()], cameraMatrix, distCoeffs, optimalCameraMatrix, detectionFrameSize, displayFrame, detectorInput);
+        before.stop();
+    }
+
+    FramePreprocessor framePreprocessor;
+    framePreprocessor.setDetectionFrameSize(detectionFrameSize);
+    framePreprocessor.setCalibration(cameraMatrix, distCoeffs, optimalCameraMatrix);
+    framePreprocessor.prepare(frameSize);
+    for (int i = 0; i < frames; ++i) {
+        after.start();
+        framePreprocessor.process(sourceFrames[i % sourceFrames.size()], displayFrame, &detectorInput);
+        after.stop();
+    }
+
+    double beforeMs = before.getTimeMilli() / frames;
+    double afterMs = after.getTimeMilli() / frames;
+    std::cout << "before: " << beforeMs << " ms/frame" << std::endl;
+    std::cout << "after:  " << afterMs << " ms/frame" << std::endl;
+    std::cout << "speedup: " << beforeMs / afterMs << "x" << std::endl;
+
+    return 0;
+}
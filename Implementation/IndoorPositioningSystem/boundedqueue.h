@@ -0,0 +1,70 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**************************************** Bounded Queue *****************************************************************
+ * Blocking FIFO with a fixed capacity, used between the stages of the Playback Pipeline
+ *  - push blocks while the queue is full (back-pressure to the previous stage)
+ *  - pop blocks while the queue is empty; tryPop returns false instead (e.g. to fill a batch with what is already queued)
+ *  - close wakes all waiting threads; push / pop return false afterwards (pop returns remaining items first)
+*************************************************************************************************************************/
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity): capacity(capacity), isClosed(false) {}
+
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [this] { return buffer.size() < capacity || isClosed; });
+        if (isClosed) return false;
+        buffer.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [this] { return !buffer.empty() || isClosed; });
+        if (buffer.empty()) return false;
+        item = std::move(buffer.front());
+        buffer.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (buffer.empty()) return false;
+        item = std::move(buffer.front());
+        buffer.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mtx);
+        buffer.clear();
+        notFull.notify_all();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx);
+        isClosed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    std::deque<T> buffer;
+    std::mutex mtx;
+    std::condition_variable notFull, notEmpty;
+    size_t capacity;
+    bool isClosed;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -1,6 +1,11 @@
 #include "dataprocessor.h"
 
-DataProcessor::DataProcessor(ThreadSafeQueue& frameQueue): frameQueue(frameQueue) {
+static const long long STATIONARY_WINDOW = 1000; // ms of UWB records before the frame
+static const double STATIONARY_DISTANCE_RANGE = 0.15; // m; UWB ranging noise is a few centimeters
+static const double CAMERA_OFFSET_X = 1.25; // m, from the origin anchor to the camera (along x)
+static const double CAMERA_OFFSET_Y = 0.15; // m, from the camera to the line of the origin anchor (along y)
+
+DataProcessor::DataProcessor(ThreadSafeQueue& frameQueue): frameQueue(frameQueue), lastSynchronizedFrame(0), lastExportedFrame(0) {
     // Thread initiation
     dataProcessorThread.reset(new QThread);
     moveToThread(dataProcessorThread.get());
@@ -33,6 +38,7 @@ void DataProcessor::cleanup() {
 
 //-------------------------------- Prepare data for processing --------------------------------
 void DataProcessor::loadData(const std::string& folderName, const std::string& UWBDataFilename, const std::string& videoDataFilename) {
+    QMutexLocker locker(&dataMutex);
 
     projectFolderName = folderName;
 
@@ -41,10 +47,17 @@ void DataProcessor::loadData(const std::string& folderName, const std::string& U
 
     int id;
     long long timestamp;
+    std::string line;
     videoTimestampsVector.clear();
 
-    while (videoDataFile >> id >> timestamp)
+    while (std::getline(videoDataFile, line))
     {
+        // Recorder events (pause, resume, stop, marker) are stored as comment lines: # <event> <timestamp>
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream ss(line);
+        if (!(ss >> id >> timestamp)) break;
+
         // assuming data are recorded sequentially and no intermidiate data is missing
         videoTimestampsVector.push_back(timestamp);
     }
@@ -53,14 +66,17 @@ void DataProcessor::loadData(const std::string& folderName, const std::string& U
     uwbDataFile = std::ifstream(UWBDataFilename);
 
     UWBData record;
-    std::string line;
     Anchor anchor;
     uwbDataVector.clear();
     uwbDataPerTag.clear();
     coordinateHistory.clear();
+    playbackAssociation.reset();
+    exportAssociation.reset();
 
     while (std::getline(uwbDataFile, line, '\n'))
     {
+        if (!line.empty() && line[0] == '#') continue; // recorder events
+
         std::istringstream ss(line);
 
         ss >> record.id >> record.timestamp >> record.tagID; // guaranteed to be present
@@ -216,8 +232,9 @@ int DataProcessor::binarySearchVideoFrameID(const long long &uwbTimestamp) {
     return closestID;
 }
 
-// For a given frame, find the closest UWB measurements for each observed person and enque to the ThreadSafeQueue for visualization in GUI.
-void DataProcessor::onFindUWBMeasurementAndEnqueue(int frameIndex, QImage qImage, DetectionData detectedPeople) {
+// For a given frame, find the closest UWB measurements for each observed person. The result is enqueued to the ThreadSafeQueue by the Playback Pipeline.
+UWBVideoData DataProcessor::synchronizeFrame(int frameIndex, QImage&& qImage, const DetectionData& detectedPeople) {
+    QMutexLocker locker(&dataMutex);
 
     long long frameTimestamp = videoTimestampsVector[frameIndex - 1];
 
@@ -253,10 +270,53 @@ void DataProcessor::onFindUWBMeasurementAndEnqueue(int frameIndex, QImage qImage
     }
 
 
+    // Tags are paired with people by position (Optical method preferred). Frames after a seek start a new sequence
+    if (frameIndex != lastSynchronizedFrame + 1) {
+        playbackAssociation.reset();
+    }
+    lastSynchronizedFrame = frameIndex;
+    const std::vector<QPointF>& personPositions = !opticalCoordinatesVector.empty() ? opticalCoordinatesVector : pixelToRealCoordinatesVector;
+    std::vector<int> personTagIDs;
+    if (!personPositions.empty()) {
+        personTagIDs = associateTags(playbackAssociation, closestForEachTag, personPositions, detectedPeople.detectionResults);
+    }
+
     // it is better to make a copy of UWB Data and then move it to the queue rather than push a pointer to existing array, just in case UWBData array will be deleted.
     UWBVideoData uwbVideoData(std::move(videoData), std::move(closestForEachTag), std::move(pixelToRealCoordinatesVector), std::move(opticalCoordinatesVector));
+    uwbVideoData.personTagIDs = std::move(personTagIDs);
+    return uwbVideoData;
+}
+
+// World positions of detected people for pairing with tags: Optical method if the camera is calibrated, otherwise Pixel-to-Real.
+// Empty if neither is available
+std::vector<QPointF> DataProcessor::locatePeople(const DetectionData& detectedPeople) {
+    std::vector<QPointF> positions;
+    bool isOriginSet = std::any_of(anchorPositions.begin(), anchorPositions.end(), [](const AnchorPosition& pos) { return pos.isOrigin; });
+    if (!isOriginSet || (cameraMatrix.empty() && !booster)) {
+        return positions;
+    }
+
+    for (const DetectionResult& detection : detectedPeople.detectionResults) {
+        positions.push_back(!cameraMatrix.empty() ? predictWorldCoordinatesOptical(detection, detectedPeople.cameraFrameSize, detectedPeople.detectionFrameSize)
+                                                  : predictWorldCoordinatesPixelToReal(detection));
+    }
 
-    frameQueue.enqueue(std::move(uwbVideoData));
+    return positions;
+}
+
+// Tag ID paired with each person (-1: none)
+std::vector<int> DataProcessor::associateTags(TagAssociation& association, const std::vector<UWBData>& tags, const std::vector<QPointF>& personPositions, const std::vector<DetectionResult>& detections) {
+    std::vector<int> tagIDs, trackIDs;
+    std::vector<QPointF> tagPositions;
+    for (const UWBData& tag : tags) {
+        tagIDs.push_back(tag.tagID);
+        tagPositions.push_back(tag.coordinates);
+    }
+    for (const DetectionResult& detection : detections) {
+        trackIDs.push_back(detection.trackID);
+    }
+
+    return association.associate(tagIDs, tagPositions, personPositions, trackIDs);
 }
 
 /* ****************** onFindUWBMeasurementAndExport ************************
@@ -267,6 +327,7 @@ void DataProcessor::onFindUWBMeasurementAndEnqueue(int frameIndex, QImage qImage
  */
 
 void DataProcessor::onFindUWBMeasurementAndExport(int frameIndex, int rangeIndex, ExportType exportType, const DetectionData& detectedPeople, bool lastRecord) {
+    QMutexLocker locker(&dataMutex);
     std::string exportDir = projectFolderName + "/export/";
     std::string outputFilePathUWB = exportDir + "uwb_to_bb_mapping_" + std::to_string(fileIncrementer) + ".txt";
 
@@ -294,15 +355,33 @@ void DataProcessor::onFindUWBMeasurementAndExport(int frameIndex, int rangeIndex
 
     long long frameTimestamp = videoTimestampsVector[frameIndex - 1];
 
-    // Frame-by-frame export. Takes very long time!!!
+    // Frame-by-frame export. Frames are read by the Export Engine in one forward scan
+    // Every person is paired with the nearest tag (optimal assignment of all tags and people), not by order
     if (exportType == ExportType::FrameByFrameExport) {
-        auto data = uwbDataPerTag.begin();
+        std::vector<UWBData> closestForEachTag;
+        for (auto& data: uwbDataPerTag) {
+            UWBData closestUWB = binarySearchUWB(frameTimestamp, data.second);
+            calculateUWBCoordinates(closestUWB);
+            closestForEachTag.push_back(closestUWB);
+        }
+
+        if (frameIndex != lastExportedFrame + 1) {
+            exportAssociation.reset();
+        }
+        lastExportedFrame = frameIndex;
+
+        std::vector<QPointF> personPositions = locatePeople(detectedPeople);
+        std::vector<int> personTagIDs;
+        if (!personPositions.empty()) {
+            personTagIDs = associateTags(exportAssociation, closestForEachTag, personPositions, detectedPeople.detectionResults);
+        }
+
         for (int i = 0; i < detectedPeople.detectionResults.size(); ++i) {
-            if (data != uwbDataPerTag.end()) {
-                UWBData closestUWB = binarySearchUWB(frameTimestamp, data->second);
-                calculateUWBCoordinates(closestUWB);
-                outputFileUWB << frameIndex << " " << closestUWB.coordinates.x() << " " << closestUWB.coordinates.y() << " " << detectedPeople.detectionResults[i].bottomEdgeCenter.x() << " " << detectedPeople.detectionResults[i].bottomEdgeCenter.y() << std::endl;
-                ++data;
+            // Without calibration and Pixel-to-Real model people cannot be located: paired by order
+            auto closestUWB = personPositions.empty() ? (i < closestForEachTag.size() ? closestForEachTag.begin() + i : closestForEachTag.end())
+                                                      : std::find_if(closestForEachTag.begin(), closestForEachTag.end(), [&](const UWBData& tag) { return tag.tagID == personTagIDs[i]; });
+            if (closestUWB != closestForEachTag.end()) {
+                outputFileUWB << frameIndex << " " << closestUWB->coordinates.x() << " " << closestUWB->coordinates.y() << " " << detectedPeople.detectionResults[i].bottomEdgeCenter.x() << " " << detectedPeople.detectionResults[i].bottomEdgeCenter.y() << std::endl;
             } else {
                 // Intruder is found!! There is no tag to match with people
             }
@@ -384,6 +463,7 @@ void DataProcessor::onFindUWBMeasurementAndExport(int frameIndex, int rangeIndex
 // ---------------- Calculate Coordinates ------------------------------------------------------------------------
 
 void DataProcessor::setAnchorPositions(std::vector<AnchorPosition> positions) {
+    QMutexLocker locker(&dataMutex);
     anchorPositions = positions;
 }
 
@@ -518,6 +598,7 @@ int DataProcessor::setPredict(bool toPredict, PredictionType type) {
 
 // Load XGBooster Regressor
 int DataProcessor::loadPixelToRealModelParams(const QString& filename) {
+    QMutexLocker locker(&dataMutex);
     int result = XGBoosterCreate(NULL, 0, &booster);
     if (result == 0) {
         result = XGBoosterLoadModel(booster, filename.toStdString().c_str());
@@ -531,6 +612,7 @@ int DataProcessor::loadPixelToRealModelParams(const QString& filename) {
 
 // Load Intrinsic Camera Matrix
 void DataProcessor::setCameraMatrix(const cv::Mat& matrix) {
+    QMutexLocker locker(&dataMutex);
     cameraMatrix = matrix;
 }
 
@@ -562,6 +644,92 @@ QPointF DataProcessor::predictWorldCoordinatesPixelToReal(const DetectionResult&
 
 }
 
+// A tag stands still if its distance to every anchor varied by less than STATIONARY_DISTANCE_RANGE during STATIONARY_WINDOW
+// before the frame (the same measure as standing periods of Data Analysis, on distances instead of coordinates).
+// A tag without enough records is not known to stand still
+bool DataProcessor::areTagsStationary(int frameIndex) {
+    QMutexLocker locker(&dataMutex);
+    if (frameIndex < 1 || frameIndex > static_cast<int>(videoTimestampsVector.size())) {
+        return false;
+    }
+    long long frameTimestamp = videoTimestampsVector[frameIndex - 1];
+
+    for (const auto& data : uwbDataPerTag) {
+        const std::vector<UWBData*>& records = data.second;
+        auto first = std::lower_bound(records.begin(), records.end(), frameTimestamp - STATIONARY_WINDOW,
+                                      [](const UWBData* record, long long timestamp) { return record->timestamp < timestamp; });
+        auto last = std::upper_bound(first, records.end(), frameTimestamp,
+                                     [](long long timestamp, const UWBData* record) { return timestamp < record->timestamp; });
+        if (last - first < 2) {
+            return false;
+        }
+
+        std::unordered_map<int, std::pair<double, double>> distanceRanges; // anchorID -> min, max
+        for (auto record = first; record != last; ++record) {
+            for (const Anchor& anchor : (*record)->anchorList) {
+                auto range = distanceRanges.try_emplace(anchor.anchorID, anchor.distance, anchor.distance).first;
+                range->second.first = std::min(range->second.first, anchor.distance);
+                range->second.second = std::max(range->second.second, anchor.distance);
+            }
+        }
+        for (const auto& range : distanceRanges) {
+            if (range.second.second - range.second.first > STATIONARY_DISTANCE_RANGE) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Inverse of the Optical method (horizontally): floor point (x, y) is seen at the image column
+// cx + (x - origin.x - CAMERA_OFFSET_X) * fx / (y + CAMERA_OFFSET_Y).
+// Columns of the corners of the area bounded by the anchors give the ROI, widened by the width of a person at the nearest corner.
+// Camera height is not known, so the ROI covers the whole height of the frame.
+cv::Rect2d DataProcessor::estimateFloorROI(const cv::Size& frameSize) {
+    QMutexLocker locker(&dataMutex);
+
+    auto origin = std::find_if(anchorPositions.begin(), anchorPositions.end(), [](const AnchorPosition& pos) {
+        return pos.isOrigin;
+    });
+    if (origin == anchorPositions.end() || anchorPositions.size() < 2 || cameraMatrix.empty() || frameSize.empty()) {
+        return cv::Rect2d();
+    }
+
+    double minX = anchorPositions.front().x, maxX = minX, minY = anchorPositions.front().y, maxY = minY;
+    for (const AnchorPosition& anchor : anchorPositions) {
+        minX = std::min(minX, anchor.x);
+        maxX = std::max(maxX, anchor.x);
+        minY = std::min(minY, anchor.y);
+        maxY = std::max(maxY, anchor.y);
+    }
+
+    double nearestDistance = minY + CAMERA_OFFSET_Y;
+    if (nearestDistance <= 0.1) {
+        return cv::Rect2d(); // the area reaches the camera, all columns can be seen
+    }
+
+    double fx = cameraMatrix.at<double>(0, 0);
+    double cx = cameraMatrix.at<double>(0, 2);
+    double left = frameSize.width, right = 0;
+    for (double x : {minX, maxX}) {
+        for (double y : {minY, maxY}) {
+            double column = cx + (x - origin->x - CAMERA_OFFSET_X) * fx / (y + CAMERA_OFFSET_Y);
+            left = std::min(left, column);
+            right = std::max(right, column);
+        }
+    }
+
+    double margin = 0.5 * fx / nearestDistance; // half of a person's width (with arms) at the nearest distance
+    left = std::max(0.0, left - margin);
+    right = std::min(static_cast<double>(frameSize.width), right + margin);
+    if (right <= left) {
+        return cv::Rect2d();
+    }
+
+    return cv::Rect2d(left / frameSize.width, 0.0, (right - left) / frameSize.width, 1.0);
+}
+
 QPointF DataProcessor::predictWorldCoordinatesOptical(const DetectionResult& detection, const cv::Size& cameraFrameSize, const cv::Size& detectionFrameSize) {
 
     QPointF coordinates;
@@ -569,9 +737,10 @@ QPointF DataProcessor::predictWorldCoordinatesOptical(const DetectionResult& det
     int imageX = detection.bottomEdgeCenter.x();
     int imageY = detection.bottomEdgeCenter.y();
 
-    // Camera parameters are computed for 640x360 size of an image, but detection was performed on the image of size 640x640 (requirement of YOLOv4).
+    // Camera parameters are computed for the camera frame (e.g. 640x360), but detections are given in the detection frame (640x640):
+    // the detector input is letterboxed (not stretched), its boxes are mapped back to the detection frame, which scales the axes differently.
     // Need a scale factor for 640x640.
-    double scaleX = detectionFrameSize.width / cameraFrameSize.width;
+    double scaleX = (double)detectionFrameSize.width / (double)cameraFrameSize.width;
     double scaleY = (double)detectionFrameSize.height / (double)cameraFrameSize.height;
 
     // Export intrinsic parameters
@@ -603,7 +772,7 @@ QPointF DataProcessor::predictWorldCoordinatesOptical(const DetectionResult& det
     });
     AnchorPosition origin = *found;
 
-    coordinates = QPointF(worldX + origin.x + 1.25, distance - 0.15); // + origin.x - distance between the left wall to the left anchor, + 1.25 - distance between the camera and the left anchor
+    coordinates = QPointF(worldX + origin.x + CAMERA_OFFSET_X, distance - CAMERA_OFFSET_Y); // + origin.x - distance between the left wall to the left anchor, + CAMERA_OFFSET_X - distance between the camera and the left anchor
 
     return coordinates;
 }
@@ -790,6 +959,7 @@ void DataProcessor::calculatePolynomialRegression(const std::vector<double>& ref
 
 // Update "on-the-fly" data to be visualized in GUI
 void DataProcessor::updateOriginalWithAdjustedValues() {
+    QMutexLocker locker(&dataMutex);
     for (int i = 0; i < distancesToAnalyzeAdjusted.size(); ++i) {
         *(distancesToAnalyzeOriginal[i]) = distancesToAnalyzeAdjusted[i];
     }
@@ -28,6 +28,7 @@
 
 #include "threadsafequeue.h"
 #include "structures.h"
+#include "tagassociation.h"
 
 class DataProcessor: public QObject
 {
@@ -46,10 +47,12 @@ public:
     void setCameraMatrix(const cv::Mat& matrix);
     QPointF predictWorldCoordinatesPixelToReal(const DetectionResult& detection);
     QPointF predictWorldCoordinatesOptical(const DetectionResult& detection, const cv::Size& cameraFrameSize, const cv::Size& detectionFrameSize);
+    cv::Rect2d estimateFloorROI(const cv::Size& frameSize); // image region of the anchor-bounded floor area (normalized, undistorted frame); empty if unknown
+    bool areTagsStationary(int frameIndex); // every tag stood still just before the frame (distances to the anchors)
+    UWBVideoData synchronizeFrame(int frameIndex, QImage&& qImage, const DetectionData& detectedPeople); // called by the sync stage of the Playback Pipeline
 
 public slots:
 
-    void onFindUWBMeasurementAndEnqueue(int frameIndex, QImage qImage, DetectionData detectedPeople);
     void onFindUWBMeasurementAndExport(int frameIndex, int rangeIndex, ExportType type, const DetectionData& detectedPeople, bool lastRecord);
     void setAnchorPositions(std::vector<AnchorPosition> anchorPositions);
     void calculateUWBCoordinates(UWBData& data);
@@ -91,6 +94,7 @@ private:
     std::vector<UWBVideoData> uwbVideoDataVector;
     std::vector<int> uniqueTagIDs;
     QMap<int, QPointF> coordinateHistory;
+    QMutex dataMutex; // synchronization runs in the Playback Pipeline thread, concurrently with the slots of this thread
 
     // Data Analysis
     std::span<UWBData> uwbDataRangeToAnalyze;
@@ -114,10 +118,16 @@ private:
     std::ofstream outputFileUWB, outputFileOptical, outputFilePixelToReal;
     int fileIncrementer;
 
+    // Tag <-> person pairing; warm-started from the previous frame of the same sequence
+    TagAssociation playbackAssociation, exportAssociation;
+    int lastSynchronizedFrame, lastExportedFrame;
+
     // private functions
     UWBData linearSearchUWB(const long long& frameTimestamp);
     UWBData binarySearchUWB(const long long& frameTimestamp);
     UWBData binarySearchUWB(const long long& frameTimestamp, const std::vector<UWBData*>& uwbDataVector);
+    std::vector<QPointF> locatePeople(const DetectionData& detectedPeople);
+    std::vector<int> associateTags(TagAssociation& association, const std::vector<UWBData>& tags, const std::vector<QPointF>& personPositions, const std::vector<DetectionResult>& detections);
 };
 
 #endif // DATAPROCESSOR_H
@@ -0,0 +1,188 @@
+#include "detectioncache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static const char CACHE_MAGIC[8] = {'I', 'P', 'S', 'D', 'E', 'T', 'C', '1'};
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+static const size_t HASHED_FILE_PART = 1 << 20; // 1 MiB from the beginning and from the end
+static const int FLUSH_INTERVAL = 64; // records
+static const int32_t MAX_BOXES_PER_FRAME = 1024; // a larger count is a corrupted record
+
+DetectionCache::DetectionCache(): unflushedRecords(0) {}
+
+DetectionCache::~DetectionCache() {
+    close();
+}
+
+//-------------------------------- Key --------------------------------
+uint64_t DetectionCache::hash(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t value = seed;
+    for (size_t i = 0; i < size; ++i) {
+        value ^= bytes[i];
+        value *= FNV_PRIME;
+    }
+
+    return value;
+}
+
+uint64_t DetectionCache::hashFile(const std::string& filename, uint64_t seed) {
+    std::ifstream input(filename, std::ios::binary);
+    if (!input.is_open()) {
+        return seed;
+    }
+
+    input.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(input.tellg());
+    uint64_t value = hash(&fileSize, sizeof(fileSize), seed);
+
+    std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(fileSize, HASHED_FILE_PART)));
+    input.seekg(0);
+    input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    value = hash(buffer.data(), static_cast<size_t>(input.gcount()), value);
+
+    if (fileSize > HASHED_FILE_PART) {
+        input.clear();
+        input.seekg(static_cast<std::streamoff>(fileSize - buffer.size()));
+        input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        value = hash(buffer.data(), static_cast<size_t>(input.gcount()), value);
+    }
+
+    return value;
+}
+
+uint64_t DetectionCache::hashMat(const cv::Mat& matrix, uint64_t seed) {
+    if (matrix.empty()) {
+        return hash("", 0, seed);
+    }
+    cv::Mat values;
+    matrix.convertTo(values, CV_64F); // the same key whether the matrix was read as float or double
+    values = values.reshape(1, 1);
+
+    return hash(values.data, values.total() * values.elemSize(), seed);
+}
+
+std::string DetectionCache::getFilename(const std::string& directory, uint64_t key) {
+    std::ostringstream name;
+    name << "detection_cache_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+//-------------------------------- Load / store --------------------------------
+bool DetectionCache::open(const std::string& filename, uint64_t key, const cv::Size& detectionFrameSize) {
+    close();
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // Load existing records
+    bool isValid = false;
+    std::streamoff validSize = 0;
+    {
+        std::ifstream input(filename, std::ios::binary);
+        char magic[sizeof(CACHE_MAGIC)];
+        uint64_t fileKey;
+        int32_t width, height;
+        if (input.read(magic, sizeof(magic)) && input.read(reinterpret_cast<char*>(&fileKey), sizeof(fileKey))
+            && input.read(reinterpret_cast<char*>(&width), sizeof(width)) && input.read(reinterpret_cast<char*>(&height), sizeof(height))) {
+            isValid = std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) == 0 && fileKey == key && width == detectionFrameSize.width && height == detectionFrameSize.height;
+        }
+
+        while (isValid) {
+            validSize = input.tellg();
+            int32_t frameID, count;
+            if (!input.read(reinterpret_cast<char*>(&frameID), sizeof(frameID)) || !input.read(reinterpret_cast<char*>(&count), sizeof(count))
+                || count < 0 || count > MAX_BOXES_PER_FRAME) {
+                break; // the rest of the file is truncated
+            }
+
+            std::vector<int32_t> values(static_cast<size_t>(count) * 4);
+            if (!input.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(int32_t)))) {
+                break; // incomplete record
+            }
+
+            std::vector<cv::Rect> boxes;
+            for (int32_t i = 0; i < count; ++i) {
+                boxes.emplace_back(values[4 * i], values[4 * i + 1], values[4 * i + 2], values[4 * i + 3]);
+            }
+            detectionsPerFrame[frameID] = std::move(boxes);
+        }
+    }
+
+    // Continue the file (after the last complete record), or start a new one
+    if (isValid) {
+        std::error_code error;
+        std::filesystem::resize_file(filename, static_cast<uintmax_t>(validSize), error);
+        file.open(filename, std::ios::binary | std::ios::app);
+    } else {
+        detectionsPerFrame.clear();
+        file.open(filename, std::ios::binary | std::ios::trunc);
+        if (file.is_open()) {
+            int32_t width = detectionFrameSize.width, height = detectionFrameSize.height;
+            file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+            file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+            file.write(reinterpret_cast<const char*>(&width), sizeof(width));
+            file.write(reinterpret_cast<const char*>(&height), sizeof(height));
+        }
+    }
+
+    if (!file.is_open()) {
+        std::cerr << "Failed to open detection cache: " << filename << std::endl; // cache still works in memory
+        return false;
+    }
+
+    return true;
+}
+
+void DetectionCache::close() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (file.is_open()) {
+        file.close();
+    }
+    detectionsPerFrame.clear();
+    unflushedRecords = 0;
+}
+
+bool DetectionCache::isOpen() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return file.is_open();
+}
+
+bool DetectionCache::find(int frameID, std::vector<cv::Rect>& boxes) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto detections = detectionsPerFrame.find(frameID);
+    if (detections == detectionsPerFrame.end()) {
+        return false;
+    }
+    boxes = detections->second;
+
+    return true;
+}
+
+// Frames without people are stored as well (count 0), so they are not detected again
+void DetectionCache::store(int frameID, const std::vector<cv::Rect>& boxes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!detectionsPerFrame.emplace(frameID, boxes).second || !file.is_open() || boxes.size() > static_cast<size_t>(MAX_BOXES_PER_FRAME)) {
+        return; // too many boxes are kept in memory only: the record would be rejected when loaded
+    }
+
+    std::vector<int32_t> record = {frameID, static_cast<int32_t>(boxes.size())};
+    for (const cv::Rect& box : boxes) {
+        record.insert(record.end(), {box.x, box.y, box.width, box.height});
+    }
+    file.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size() * sizeof(int32_t)));
+
+    if (++unflushedRecords >= FLUSH_INTERVAL) {
+        file.flush();
+        unflushedRecords = 0;
+    }
+}
+
+size_t DetectionCache::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return detectionsPerFrame.size();
+}
@@ -0,0 +1,59 @@
+#ifndef DETECTIONCACHE_H
+#define DETECTIONCACHE_H
+
+/*********************************************** Detection Cache ********************************************************
+ * People detected by the Human Detector, persisted per frame in a binary sidecar next to the video:
+ *  detection_cache_<key>.bin
+ *
+ * The key (FNV-1a, 64 bit) identifies everything the boxes depend on: the video, the detector cfg / weights, the detection
+ * frame size, the thresholds, the detection ROI and the undistortion (calibration) of the detector input. Another key means another file,
+ * so caches of different models / calibrations are kept side by side.
+ * Large files (video, weights) are hashed by their size and the first and last 1 MiB, so opening a session stays fast.
+ *
+ * Format (little-endian, append-only, so detections are stored as soon as they are computed):
+ *  header:  "IPSDETC1" key:uint64 detectionWidth:int32 detectionHeight:int32
+ *  records: frameID:int32 count:int32 (x:int32 y:int32 width:int32 height:int32) * count
+ * An incomplete last record (e.g. the application was killed) is ignored, as is the rest of the file from a record with
+ * an impossible count (more than MAX_BOXES_PER_FRAME boxes: corrupted).
+ *
+ * Boxes are in the detection frame (as returned by HumanDetector, after NMS). Thread-safe: workers find / store concurrently.
+************************************************************************************************************************/
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+class DetectionCache
+{
+public:
+    DetectionCache();
+    ~DetectionCache();
+
+    bool open(const std::string& filename, uint64_t key, const cv::Size& detectionFrameSize);
+    void close();
+    bool isOpen() const;
+
+    bool find(int frameID, std::vector<cv::Rect>& boxes) const;
+    void store(int frameID, const std::vector<cv::Rect>& boxes);
+    size_t size() const;
+
+    // Building blocks of the key
+    static uint64_t hash(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS);
+    static uint64_t hashFile(const std::string& filename, uint64_t seed = FNV_OFFSET_BASIS);
+    static uint64_t hashMat(const cv::Mat& matrix, uint64_t seed = FNV_OFFSET_BASIS);
+    static std::string getFilename(const std::string& directory, uint64_t key);
+
+    static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+private:
+    mutable std::mutex mtx;
+    std::unordered_map<int, std::vector<cv::Rect>> detectionsPerFrame;
+    std::ofstream file;
+    int unflushedRecords;
+};
+
+#endif // DETECTIONCACHE_H
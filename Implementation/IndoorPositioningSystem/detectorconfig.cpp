@@ -0,0 +1,133 @@
+#include "detectorconfig.h"
+
+#include <filesystem>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+DetectorConfig DetectorConfig::darknet(const std::string& configuration, const std::string& weights) {
+    DetectorConfig config;
+    config.format = DetectorFormat::Darknet;
+    config.configuration = configuration;
+    config.model = weights;
+    return config;
+}
+
+// Paths in the file are relative to its folder
+bool DetectorConfig::load(const std::string& filename, DetectorConfig& config, std::string& error) {
+    cv::FileStorage fs(filename, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        error = "Error opening file: " + filename;
+        return false;
+    }
+
+    std::filesystem::path folder = std::filesystem::path(filename).parent_path();
+    auto path = [&folder](const std::string& name) { return name.empty() ? name : (folder / name).string(); };
+
+    std::string format, precision;
+    fs["format"] >> format;
+    fs["precision"] >> precision;
+    if (format == "onnx") {
+        config.format = DetectorFormat::ONNX;
+    } else if (format == "darknet" || format.empty()) {
+        config.format = DetectorFormat::Darknet;
+    } else {
+        error = "Unknown detector format: " + format;
+        return false;
+    }
+    if (precision == "fp16") {
+        config.precision = DetectorPrecision::FP16;
+    } else if (precision == "int8") {
+        config.precision = DetectorPrecision::INT8;
+    } else if (precision == "fp32" || precision.empty()) {
+        config.precision = DetectorPrecision::FP32;
+    } else {
+        error = "Unknown detector precision: " + precision;
+        return false;
+    }
+
+    std::string model, configuration, calibration;
+    fs["model"] >> model;
+    fs["configuration"] >> configuration;
+    fs["calibration"] >> calibration;
+    config.model = path(model);
+    config.configuration = path(configuration);
+    config.calibrationFolder = path(calibration);
+    if (!fs["inputSize"].empty()) {
+        fs["inputSize"] >> config.inputSize;
+    }
+    // ONNX exports have a fixed input shape unless exported with dynamic axes
+    config.isInputSquare = config.format == DetectorFormat::ONNX;
+    if (!fs["squareInput"].empty()) {
+        int isSquare = 0;
+        fs["squareInput"] >> isSquare;
+        config.isInputSquare = isSquare != 0;
+    }
+    if (!fs["confidenceThreshold"].empty()) {
+        fs["confidenceThreshold"] >> config.confidenceThreshold;
+    }
+    if (!fs["nmsThreshold"].empty()) {
+        fs["nmsThreshold"] >> config.nmsThreshold;
+    }
+
+    if (config.model.empty() || (config.format == DetectorFormat::Darknet && config.configuration.empty())) {
+        error = "Model files are not given in " + filename;
+        return false;
+    }
+    if (config.inputSize < 32 || config.inputSize % 32 != 0) {
+        error = "Input size must be a multiple of 32: " + std::to_string(config.inputSize);
+        return false;
+    }
+
+    return true;
+}
+
+// detector.yml, otherwise the model files found in the folder
+bool DetectorConfig::fromFolder(const std::string& folder, DetectorConfig& config, std::string& error) {
+    std::filesystem::path configFile = std::filesystem::path(folder) / "detector.yml";
+    if (std::filesystem::exists(configFile)) {
+        return load(configFile.string(), config, error);
+    }
+
+    std::vector<std::string> cfgFiles, weightsFiles, onnxFiles;
+    for (const auto& entry : std::filesystem::directory_iterator(folder)) {
+        if (!entry.is_regular_file()) continue;
+        std::string extension = entry.path().extension().string();
+        if (extension == ".cfg") cfgFiles.push_back(entry.path().string());
+        else if (extension == ".weights") weightsFiles.push_back(entry.path().string());
+        else if (extension == ".onnx") onnxFiles.push_back(entry.path().string());
+    }
+
+    if (cfgFiles.empty() && weightsFiles.empty() && onnxFiles.size() == 1) {
+        config = DetectorConfig();
+        config.format = DetectorFormat::ONNX;
+        config.model = onnxFiles.front();
+        config.isInputSquare = true;
+        return true;
+    }
+
+    if (cfgFiles.size() > 1 || weightsFiles.size() > 1 || onnxFiles.size() > 1) {
+        error = "More than one model found (add detector.yml to choose one).";
+        return false;
+    }
+    if (cfgFiles.empty() || weightsFiles.empty()) {
+        std::string missing = cfgFiles.empty() ? "configuration file (*.cfg)" : "";
+        if (weightsFiles.empty()) {
+            missing += std::string(missing.empty() ? "" : ", ") + "weights file (*.weights)";
+        }
+        error = "Missing required files: " + missing;
+        return false;
+    }
+
+    config = darknet(cfgFiles.front(), weightsFiles.front());
+    return true;
+}
+
+std::string DetectorConfig::describe() const {
+    std::string description = format == DetectorFormat::ONNX ? "onnx" : "darknet";
+    switch (precision) {
+    case DetectorPrecision::FP32: description += " fp32"; break;
+    case DetectorPrecision::FP16: description += " fp16"; break;
+    case DetectorPrecision::INT8: description += " int8"; break;
+    }
+    return description + " " + std::to_string(inputSize) + (isInputSquare ? " square" : "");
+}
@@ -0,0 +1,57 @@
+#ifndef DETECTORCONFIG_H
+#define DETECTORCONFIG_H
+
+/*********************************************** Detector Config ********************************************************
+ * Which model the Human Detector loads and how it runs it (backend):
+ *  - format: Darknet (YOLOv3/v4 cfg + weights) or ONNX (newer YOLO exports, e.g. YOLOv5 / YOLOv8, 640x640, RGB 0..1)
+ *  - precision on CPU: fp32; fp16 (OpenCV 4.9+); int8 - a model quantized already (ONNX), or quantized when loaded
+ *    using frames from the calibration folder
+ *  - input size: the longer side of the letterboxed frame (320 / 416 / 512 / 640: faster / more accurate); models exported
+ *    with a fixed input shape need a square input (padded)
+ *  - thresholds
+ *
+ * The model folder (loaded in the GUI, --detector-config in batch) can contain detector.yml:
+ *   format: "onnx"              # darknet | onnx
+ *   model: "yolov8n.onnx"       # .weights / .onnx, relative to the folder
+ *   configuration: ""           # .cfg (darknet)
+ *   precision: "fp32"           # fp32 | fp16 | int8
+ *   calibration: "calibration"  # int8: folder with frames (jpg / png) to quantize a float model
+ *   inputSize: 640              # multiple of 32
+ *   squareInput: 1              # 1: fixed input shape (inputSize x inputSize); default: 1 for onnx, 0 for darknet
+ *   confidenceThreshold: 0.5
+ *   nmsThreshold: 0.4
+ * Without detector.yml the folder must contain one *.cfg and one *.weights (Darknet), or one *.onnx (square input, as
+ * YOLO exports have a fixed input shape by default).
+*************************************************************************************************************************/
+
+#include <string>
+
+enum class DetectorFormat {
+    Darknet,
+    ONNX
+};
+
+enum class DetectorPrecision {
+    FP32,
+    FP16,
+    INT8
+};
+
+struct DetectorConfig {
+    DetectorFormat format = DetectorFormat::Darknet;
+    std::string model; // .weights / .onnx
+    std::string configuration; // .cfg (Darknet only)
+    DetectorPrecision precision = DetectorPrecision::FP32;
+    std::string calibrationFolder; // INT8 of a float model
+    int inputSize = 640;
+    bool isInputSquare = false; // ONNX: true unless detector.yml says otherwise
+    float confidenceThreshold = 0.5f;
+    float nmsThreshold = 0.4f;
+
+    static DetectorConfig darknet(const std::string& configuration, const std::string& weights);
+    static bool load(const std::string& filename, DetectorConfig& config, std::string& error); // detector.yml
+    static bool fromFolder(const std::string& folder, DetectorConfig& config, std::string& error);
+    std::string describe() const; // e.g. "onnx int8 640"
+};
+
+#endif // DETECTORCONFIG_H
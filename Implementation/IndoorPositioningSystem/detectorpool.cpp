@@ -0,0 +1,188 @@
+#include "detectorpool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static const int MAX_DETECTORS = 4; // every network takes memory
+static const int THROUGHPUT_WINDOW = 500; // frames
+
+static bool readFile(const std::string& filename, std::vector<uchar>& buffer) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+DetectorPool::DetectorPool(int size): jobs(static_cast<size_t>(2 * defaultSize(size))), _isInitialized(false), periodFrames(0), throughput(0.0) {
+    for (int i = 0; i < defaultSize(size); ++i) {
+        slots.push_back(std::make_unique<Slot>());
+    }
+    for (std::unique_ptr<Slot>& slot : slots) {
+        threads.emplace_back(&DetectorPool::run, this, std::ref(*slot));
+    }
+}
+
+// Half of the cores: OpenCV parallelizes a forward pass as well
+int DetectorPool::defaultSize(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    return std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, MAX_DETECTORS);
+}
+
+DetectorPool::~DetectorPool() {
+    jobs.close();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+int DetectorPool::getSize() const {
+    return static_cast<int>(slots.size());
+}
+
+bool DetectorPool::isInitialized() const {
+    return _isInitialized;
+}
+
+void DetectorPool::init(const std::string& modelConfiguration, const std::string& modelWeights) {
+    init(DetectorConfig::darknet(modelConfiguration, modelWeights));
+}
+
+// Every detector is loaded when it does not run; frames queued meanwhile are detected by the new model
+void DetectorPool::init(const DetectorConfig& config) {
+    std::vector<uchar> configurationBuffer, modelBuffer;
+    bool hasConfiguration = config.format != DetectorFormat::Darknet || readFile(config.configuration, configurationBuffer);
+    if (!hasConfiguration || !readFile(config.model, modelBuffer)) {
+        std::cerr << "Error: Failed to read network files: " << config.configuration << ", " << config.model << std::endl;
+        _isInitialized = false;
+        return;
+    }
+
+    cv::Mat calibrationBlob;
+    if (config.precision == DetectorPrecision::INT8 && !config.calibrationFolder.empty()) {
+        calibrationBlob = HumanDetector::readCalibrationBlob(config.calibrationFolder, cv::Size(config.inputSize, config.inputSize));
+    }
+
+    bool isLoaded = true;
+    for (std::unique_ptr<Slot>& slot : slots) {
+        std::lock_guard<std::mutex> lock(slot->mtx);
+        slot->detector.initHumanDetection(config, configurationBuffer, modelBuffer, calibrationBlob);
+        isLoaded = isLoaded && slot->detector.isInitialized();
+    }
+    _isInitialized = isLoaded;
+    std::cout << "Detector pool: " << config.describe() << (isLoaded ? " loaded" : " failed to load") << std::endl;
+}
+
+//-------------------------------- Jobs --------------------------------
+std::future<DetectorPool::Detections> DetectorPool::submit(const cv::Mat& frame) {
+    auto promise = std::make_shared<std::promise<Detections>>();
+    std::future<Detections> result = promise->get_future();
+
+    Job job = [this, promise, frame](HumanDetector& detector) {
+        try {
+            promise->set_value(detector.detectPeople(frame, frame.size()));
+            countFrames(1);
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    };
+    if (!jobs.push(std::move(job))) {
+        promise->set_value(Detections()); // the pool is being destroyed
+    }
+
+    return result;
+}
+
+std::future<std::vector<DetectorPool::Detections>> DetectorPool::submit(const std::vector<cv::Mat>& frames) {
+    auto promise = std::make_shared<std::promise<std::vector<Detections>>>();
+    std::future<std::vector<Detections>> result = promise->get_future();
+
+    Job job = [this, promise, frames](HumanDetector& detector) {
+        try {
+            promise->set_value(detector.detectPeople(frames, frames.front().size()));
+            countFrames(static_cast<int>(frames.size()));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    };
+    if (frames.empty() || !jobs.push(std::move(job))) {
+        promise->set_value(std::vector<Detections>(frames.size()));
+    }
+
+    return result;
+}
+
+// Thread of one detector
+void DetectorPool::run(Slot& slot) {
+    Job job;
+    while (jobs.pop(job)) {
+        std::lock_guard<std::mutex> lock(slot.mtx);
+        job(slot.detector);
+        job = nullptr; // frames of the job are released
+    }
+}
+
+//-------------------------------- Settings of the model --------------------------------
+// The other detectors keep running (the measurement is a little pessimistic while they do)
+int DetectorPool::tuneBatchSize(const cv::Size& detectionFrameSize) {
+    std::lock_guard<std::mutex> lock(slots.front()->mtx);
+    return slots.front()->detector.tuneBatchSize(detectionFrameSize);
+}
+
+// The same for all detectors; locked as the model can be loaded again meanwhile
+float DetectorPool::getConfidenceThreshold() const {
+    std::lock_guard<std::mutex> lock(slots.front()->mtx);
+    return slots.front()->detector.getConfidenceThreshold();
+}
+
+float DetectorPool::getNMSThreshold() const {
+    std::lock_guard<std::mutex> lock(slots.front()->mtx);
+    return slots.front()->detector.getNMSThreshold();
+}
+
+double DetectorPool::getAverageInferenceTime() const {
+    double time = 0.0;
+    int detectors = 0;
+    for (const std::unique_ptr<Slot>& slot : slots) {
+        std::lock_guard<std::mutex> lock(slot->mtx);
+        double detectorTime = slot->detector.getAverageInferenceTime();
+        if (detectorTime > 0.0) {
+            time += detectorTime;
+            ++detectors;
+        }
+    }
+    return detectors > 0 ? time / detectors : 0.0;
+}
+
+//-------------------------------- Throughput --------------------------------
+void DetectorPool::countFrames(int frames) {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    auto now = std::chrono::steady_clock::now();
+    if (periodFrames == 0 || now - lastFrameTime > std::chrono::seconds(1)) {
+        periodStart = now; // idle time (paused, seeking) is not counted
+        periodFrames = 0;
+    }
+    lastFrameTime = now;
+    periodFrames += frames;
+
+    if (periodFrames >= THROUGHPUT_WINDOW) {
+        double seconds = std::chrono::duration<double>(now - periodStart).count();
+        throughput = seconds > 0.0 ? periodFrames / seconds : 0.0;
+        periodFrames = 0;
+    }
+}
+
+// Until a window is complete, the frames counted so far
+double DetectorPool::getThroughput() const {
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    if (throughput == 0.0 && periodFrames > 0) {
+        double seconds = std::chrono::duration<double>(lastFrameTime - periodStart).count();
+        return seconds > 0.0 ? periodFrames / seconds : 0.0;
+    }
+    return throughput;
+}
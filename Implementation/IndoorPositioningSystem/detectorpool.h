@@ -0,0 +1,80 @@
+#ifndef DETECTORPOOL_H
+#define DETECTORPOOL_H
+
+/*********************************************** Detector Pool **********************************************************
+ * Several Human Detectors (independent cv::dnn::Net instances of the same model), each run by its own thread,
+ * so independent frames are detected concurrently. One forward pass of a small network at 640x640 does not keep
+ * all cores busy, so several passes at once give more frames per second.
+ *  - the model files (and int8 calibration frames) are read once; every network is built from the same buffers
+ *  - submit queues frames (one, or a batch for one forward pass) and returns a future with the detections;
+ *    the queue is bounded, so submit blocks while all detectors are busy and the queue is full
+ *  - a detector is locked while it runs, so the model can be loaded again while frames are being detected
+ *
+ * The number of detectors is chosen by the number of cores (every network takes memory, at most MAX_DETECTORS).
+ * OpenCV splits the work of a forward pass into its own thread pool, which is shared by all detectors.
+ * Throughput (frames per second of all detectors) is measured over windows of THROUGHPUT_WINDOW frames (getThroughput).
+*************************************************************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "boundedqueue.h"
+#include "humandetector.h"
+
+class DetectorPool
+{
+public:
+    using Detections = std::pair<std::vector<cv::Rect>, std::vector<int>>; // as returned by HumanDetector
+
+    explicit DetectorPool(int size = 0); // 0: chosen by the number of cores
+    ~DetectorPool();
+
+    static int defaultSize(int requested); // size of the pool for the requested size (0: by the number of cores)
+
+    void init(const std::string& modelConfiguration, const std::string& modelWeights);
+    void init(const DetectorConfig& config);
+    bool isInitialized() const;
+    int getSize() const;
+
+    // Detector input size is the size of the frames (the frames of a batch must have the same size)
+    std::future<Detections> submit(const cv::Mat& frame);
+    std::future<std::vector<Detections>> submit(const std::vector<cv::Mat>& frames);
+
+    int tuneBatchSize(const cv::Size& detectionFrameSize); // measured on one detector
+    float getConfidenceThreshold() const;
+    float getNMSThreshold() const;
+    double getThroughput() const; // frames per second over the last window
+    double getAverageInferenceTime() const; // ms per frame of a forward pass, over all detectors
+
+private:
+    using Job = std::function<void(HumanDetector& detector)>;
+
+    struct Slot {
+        HumanDetector detector;
+        std::mutex mtx; // held while the detector runs
+    };
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<std::thread> threads;
+    BoundedQueue<Job> jobs;
+    std::atomic<bool> _isInitialized;
+
+    // Throughput
+    mutable std::mutex statisticsMutex;
+    std::chrono::steady_clock::time_point periodStart, lastFrameTime;
+    int periodFrames;
+    double throughput;
+
+    void run(Slot& slot);
+    void countFrames(int frames);
+};
+
+#endif // DETECTORPOOL_H
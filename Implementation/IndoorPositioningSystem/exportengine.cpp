@@ -0,0 +1,149 @@
+#include "exportengine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#include "boundedqueue.h"
+
+ExportEngine::ExportEngine(int workerCount): workerCount(std::max(1, workerCount)), batchSize(1) {}
+
+int ExportEngine::getWorkerCount() const {
+    return workerCount;
+}
+
+void ExportEngine::setBatchSize(int batchSize) {
+    this->batchSize = std::max(1, batchSize);
+}
+
+bool ExportEngine::run(const std::vector<int>& positions, const ReadFunction& read, const DetectFunction& detect,
+                       const ResultFunction& deliver, const StopFunction& shouldStop) {
+    struct Task {
+        int rangeIndex;
+        int position;
+        cv::Mat frame;
+    };
+
+    const int totalRecords = static_cast<int>(positions.size());
+    BoundedQueue<Task> tasks(static_cast<size_t>(2 * workerCount * batchSize));
+    std::mutex mtx;
+    std::condition_variable resultCondition;
+    std::map<int, std::vector<DetectionResult>> results; // by range index, until delivered
+
+    //-------------------------------- Detection workers --------------------------------
+    std::vector<std::thread> workers;
+    for (int workerIndex = 0; workerIndex < workerCount; ++workerIndex) {
+        workers.emplace_back([&, workerIndex] {
+            Task task;
+            std::vector<int> rangeIndices, batchPositions;
+            std::vector<cv::Mat> frames;
+            std::vector<std::vector<DetectionResult>> detectionResults;
+            while (tasks.pop(task)) {
+                // The batch is filled with frames already queued; the worker does not wait for more
+                rangeIndices.clear();
+                batchPositions.clear();
+                frames.clear();
+                do {
+                    rangeIndices.push_back(task.rangeIndex);
+                    batchPositions.push_back(task.position);
+                    frames.push_back(std::move(task.frame));
+                } while (static_cast<int>(frames.size()) < batchSize && tasks.tryPop(task));
+
+                detectionResults.assign(frames.size(), std::vector<DetectionResult>());
+                bool isDetected = false;
+                try {
+                    detect(batchPositions, frames, detectionResults, workerIndex);
+                    isDetected = true;
+                } catch (const std::exception& e) { // cv::Exception, or rethrown by the Detector Pool (e.g. std::bad_alloc)
+                    std::cerr << "Failed to detect people in frames " << batchPositions.front() << "-" << batchPositions.back() << ": " << e.what() << std::endl;
+                } catch (...) {
+                    std::cerr << "Failed to detect people in frames " << batchPositions.front() << "-" << batchPositions.back() << ": unknown error" << std::endl;
+                }
+                if (!isDetected) {
+                    // Every frame of the batch still gets an empty result, otherwise the delivery in order would wait for it
+                    detectionResults.assign(frames.size(), std::vector<DetectionResult>());
+                }
+                frames.clear();
+
+                std::lock_guard<std::mutex> lock(mtx);
+                for (size_t i = 0; i < rangeIndices.size(); ++i) {
+                    results.emplace(rangeIndices[i], std::move(detectionResults[i]));
+                }
+                resultCondition.notify_one();
+            }
+        });
+    }
+
+    // Results are delivered in the range order; waits for the next one only at the end of the scan
+    int nextToDeliver = 0;
+    auto deliverReady = [&](bool toWait) {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (nextToDeliver < totalRecords && !shouldStop()) {
+            auto next = results.find(nextToDeliver);
+            if (next == results.end()) {
+                if (!toWait) {
+                    return;
+                }
+                resultCondition.wait_for(lock, std::chrono::milliseconds(50)); // shouldStop is checked periodically
+                continue;
+            }
+
+            std::vector<DetectionResult> detectionResults = std::move(next->second);
+            results.erase(next);
+            int rangeIndex = nextToDeliver++;
+
+            lock.unlock();
+            deliver(rangeIndex, positions[rangeIndex], detectionResults, rangeIndex == totalRecords - 1);
+            lock.lock();
+        }
+    };
+
+    //-------------------------------- Sequential scan --------------------------------
+    std::vector<int> scanOrder(positions.size());
+    std::iota(scanOrder.begin(), scanOrder.end(), 0);
+    std::stable_sort(scanOrder.begin(), scanOrder.end(), [&positions](int a, int b) { return positions[a] < positions[b]; });
+
+    bool success = true;
+    int decodedPosition = -1;
+    cv::Mat frame;
+    for (int rangeIndex : scanOrder) {
+        if (shouldStop()) {
+            success = false;
+            break;
+        }
+
+        int position = positions[rangeIndex];
+        if (position != decodedPosition) {
+            frame = cv::Mat(); // the previous frame is still used by a worker
+            if (!read(position, frame) || frame.empty()) {
+                std::cerr << "Failed to read frame " << position << " while export" << std::endl;
+                success = false;
+                break;
+            }
+            decodedPosition = position;
+        }
+
+        tasks.push(Task{rangeIndex, position, frame});
+        deliverReady(false);
+    }
+
+    if (!success) {
+        tasks.clear();
+    }
+    tasks.close();
+    if (success) {
+        deliverReady(true);
+        success = nextToDeliver == totalRecords; // a command after the last frame does not fail a finished export
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    return success;
+}
@@ -0,0 +1,47 @@
+#ifndef EXPORTENGINE_H
+#define EXPORTENGINE_H
+
+/*********************************************** Export Engine **********************************************************
+ * Reads the frames to export in one forward scan of the video instead of seeking to every frame:
+ *  - requested positions are sorted; the video is decoded forward once
+ *  - frames are read by the read function (VideoProcessor: unrequested frames are skipped by grab, gaps over a keyframe
+ *    by a jump to the keyframe using the Video Index), one at a time, so the video can be used between two reads
+ *  - requested frames fan out to detection workers (detected by the Detector Pool); a worker takes up to batchSize
+ *    queued frames at once, so the detector runs one forward pass for the whole batch
+ *  - results are delivered in the requested order (range index), from the calling thread
+ *  - shouldStop is checked between frames (and while waiting for results), so an export is interrupted within a frame
+ *
+ * Positions are 0-based (as CAP_PROP_POS_FRAMES). A position requested several times is decoded once.
+*************************************************************************************************************************/
+
+#include <functional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "structures.h"
+
+class ExportEngine
+{
+public:
+    using ReadFunction = std::function<bool(int position, cv::Mat& frame)>; // positions come in increasing order
+    // Detects people in a batch of frames; detectionResults has one (empty) vector per frame
+    using DetectFunction = std::function<void(const std::vector<int>& positions, const std::vector<cv::Mat>& frames, std::vector<std::vector<DetectionResult>>& detectionResults, int workerIndex)>;
+    using ResultFunction = std::function<void(int rangeIndex, int position, std::vector<DetectionResult>& detectionResults, bool lastRecord)>;
+
+    explicit ExportEngine(int workerCount);
+
+    using StopFunction = std::function<bool()>;
+
+    // Returns false if interrupted (shouldStop) or a frame could not be read
+    bool run(const std::vector<int>& positions, const ReadFunction& read, const DetectFunction& detect,
+             const ResultFunction& deliver, const StopFunction& shouldStop);
+
+    int getWorkerCount() const;
+    void setBatchSize(int batchSize); // frames per detection call (1: frame by frame)
+
+private:
+    int workerCount;
+    int batchSize;
+};
+
+#endif // EXPORTENGINE_H
@@ -0,0 +1,304 @@
+#include "ffmpegvideodecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+static const int FORWARD_DECODE_FRAMES = 32; // a jump forward up to about a GOP is decoded instead of seeking
+
+FFmpegVideoDecoder::FFmpegVideoDecoder(int threadCount):
+    threadCount(std::max(0, threadCount))
+    , formatContext(nullptr)
+    , codecContext(nullptr)
+    , decodedFrame(nullptr)
+    , packet(nullptr)
+    , swsContext(nullptr)
+    , swsWidth(0)
+    , swsHeight(0)
+    , swsFormat(-1)
+    , streamIndex(-1)
+    , timeBase(0.0)
+    , startTime(0)
+    , fps(0.0)
+    , frameCount(0)
+    , nextPosition(0)
+    , isPositionKnown(true)
+    , isFramePending(false)
+    , isDraining(false)
+    , timestamp(-1.0)
+{
+}
+
+FFmpegVideoDecoder::~FFmpegVideoDecoder() {
+    release();
+}
+
+bool FFmpegVideoDecoder::open(const std::string& filename) {
+    release();
+    if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    if (avformat_find_stream_info(formatContext, nullptr) < 0
+        || (streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0)) < 0)
+    {
+        release();
+        return false;
+    }
+
+    AVStream* stream = formatContext->streams[streamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    codecContext = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!codecContext || avcodec_parameters_to_context(codecContext, stream->codecpar) < 0) {
+        release();
+        return false;
+    }
+    // Frame threads decode consecutive frames in parallel, slice threads the slices of one frame
+    codecContext->thread_count = threadCount;
+    codecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(codecContext, codec, nullptr) < 0) {
+        std::cerr << "FFmpeg: failed to open the decoder " << codec->name << std::endl;
+        release();
+        return false;
+    }
+    decodedFrame = av_frame_alloc();
+    packet = av_packet_alloc();
+
+    timeBase = av_q2d(stream->time_base);
+    startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    AVRational frameRate = av_guess_frame_rate(formatContext, stream, nullptr);
+    fps = frameRate.num > 0 && frameRate.den > 0 ? av_q2d(frameRate) : 0.0;
+    if (stream->nb_frames > 0) {
+        frameCount = static_cast<int>(stream->nb_frames);
+    } else if (stream->duration != AV_NOPTS_VALUE) {
+        frameCount = static_cast<int>(std::llround(stream->duration * timeBase * fps));
+    } else if (formatContext->duration != AV_NOPTS_VALUE) {
+        frameCount = static_cast<int>(std::llround(formatContext->duration * fps / AV_TIME_BASE));
+    }
+    return true;
+}
+
+void FFmpegVideoDecoder::release() {
+    sws_freeContext(swsContext);
+    swsContext = nullptr;
+    swsFormat = -1;
+    av_frame_free(&decodedFrame);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecContext);
+    avformat_close_input(&formatContext);
+
+    streamIndex = -1;
+    fps = 0.0;
+    frameCount = 0;
+    nextPosition = 0;
+    isPositionKnown = true;
+    isFramePending = false;
+    isDraining = false;
+    timestamp = -1.0;
+}
+
+bool FFmpegVideoDecoder::isOpened() const {
+    return codecContext != nullptr;
+}
+
+bool FFmpegVideoDecoder::read(cv::Mat& frame) {
+    if (!ensureFrame()) {
+        return false;
+    }
+    bool isConverted = convertFrame(frame);
+    consumeFrame();
+    return isConverted;
+}
+
+bool FFmpegVideoDecoder::grab() {
+    if (!ensureFrame()) {
+        return false;
+    }
+    consumeFrame();
+    return true;
+}
+
+bool FFmpegVideoDecoder::seek(int position) {
+    if (!isOpened() || position < 0) {
+        return false;
+    }
+    if (isPositionKnown && position == nextPosition) {
+        return true;
+    }
+    if (!isPositionKnown || position < nextPosition || position - nextPosition > FORWARD_DECODE_FRAMES) {
+        if (!seekKeyframe(position)) {
+            return false;
+        }
+    }
+
+    // Frames before the position are decoded, not converted
+    while (ensureFrame() && nextPosition < position) {
+        consumeFrame();
+    }
+    return isFramePending;
+}
+
+int FFmpegVideoDecoder::getPosition() const {
+    return nextPosition;
+}
+
+int FFmpegVideoDecoder::getFrameCount() const {
+    return frameCount;
+}
+
+double FFmpegVideoDecoder::getFPS() const {
+    return fps;
+}
+
+cv::Size FFmpegVideoDecoder::getFrameSize() const {
+    return codecContext ? cv::Size(codecContext->width, codecContext->height) : cv::Size();
+}
+
+double FFmpegVideoDecoder::getTimestamp() const {
+    return timestamp;
+}
+
+std::string FFmpegVideoDecoder::getName() const {
+    if (!codecContext) {
+        return "FFmpeg (closed)";
+    }
+    std::string threading = codecContext->active_thread_type == FF_THREAD_FRAME ? "frame"
+                            : codecContext->active_thread_type == FF_THREAD_SLICE ? "slice" : "no";
+    return "FFmpeg (" + std::string(codecContext->codec->name) + ", " + std::to_string(codecContext->thread_count) + " threads, " + threading + " threading)";
+}
+
+//-------------------------------- Decoding --------------------------------
+
+// Packets of the video stream are sent until the decoder returns a frame; at the end of the file the decoder is drained
+bool FFmpegVideoDecoder::decodeFrame() {
+    while (true) {
+        int result = avcodec_receive_frame(codecContext, decodedFrame);
+        if (result == 0) {
+            return true;
+        }
+        if (result != AVERROR(EAGAIN) || isDraining) {
+            return false; // end of the video or a decoder error
+        }
+
+        if (av_read_frame(formatContext, packet) < 0) {
+            isDraining = true;
+            avcodec_send_packet(codecContext, nullptr);
+            continue;
+        }
+        if (packet->stream_index == streamIndex) {
+            avcodec_send_packet(codecContext, packet); // a broken packet is skipped
+        }
+        av_packet_unref(packet);
+    }
+}
+
+bool FFmpegVideoDecoder::ensureFrame() {
+    if (isFramePending) {
+        return true;
+    }
+    if (!isOpened() || !decodeFrame()) {
+        return false;
+    }
+    isFramePending = true;
+    if (!isPositionKnown) {
+        int position = toPosition(decodedFrame->best_effort_timestamp);
+        if (position >= 0) {
+            nextPosition = position; // otherwise the requested position is assumed
+        }
+        isPositionKnown = true;
+    }
+    return true;
+}
+
+void FFmpegVideoDecoder::consumeFrame() {
+    int64_t pts = decodedFrame->best_effort_timestamp;
+    timestamp = pts != AV_NOPTS_VALUE ? (pts - startTime) * timeBase * 1000.0 : -1.0;
+    isFramePending = false;
+    ++nextPosition;
+}
+
+// The conversion context is created for the format of the decoded frames (once per video)
+bool FFmpegVideoDecoder::convertFrame(cv::Mat& frame) {
+    int width = decodedFrame->width;
+    int height = decodedFrame->height;
+    if (!swsContext || width != swsWidth || height != swsHeight || decodedFrame->format != swsFormat) {
+        sws_freeContext(swsContext);
+        swsContext = sws_alloc_context();
+        if (!swsContext) {
+            return false;
+        }
+        av_opt_set_int(swsContext, "srcw", width, 0);
+        av_opt_set_int(swsContext, "srch", height, 0);
+        av_opt_set_int(swsContext, "src_format", decodedFrame->format, 0);
+        av_opt_set_int(swsContext, "dstw", width, 0);
+        av_opt_set_int(swsContext, "dsth", height, 0);
+        av_opt_set_int(swsContext, "dst_format", AV_PIX_FMT_BGR24, 0);
+        av_opt_set_int(swsContext, "sws_flags", SWS_BILINEAR, 0);
+        av_opt_set_int(swsContext, "threads", threadCount, 0); // libswscale 6 (FFmpeg 5) and newer; 0: auto
+        if (sws_init_context(swsContext, nullptr, nullptr) < 0) {
+            std::cerr << "FFmpeg: unsupported pixel format " << decodedFrame->format << std::endl;
+            sws_freeContext(swsContext);
+            swsContext = nullptr;
+            return false;
+        }
+        swsWidth = width;
+        swsHeight = height;
+        swsFormat = decodedFrame->format;
+    }
+
+    frame.create(height, width, CV_8UC3); // by the allocator of the frame (Frame Pool)
+
+#if LIBSWSCALE_VERSION_MAJOR >= 6
+    // Only sws_scale_frame converts in threads; the output frame wraps the buffer of the Mat (not freed by FFmpeg)
+    AVFrame* output = av_frame_alloc();
+    if (!output) {
+        return false;
+    }
+    output->format = AV_PIX_FMT_BGR24;
+    output->width = width;
+    output->height = height;
+    output->data[0] = frame.data;
+    output->linesize[0] = static_cast<int>(frame.step[0]);
+    output->buf[0] = av_buffer_create(frame.data, frame.step[0] * height, [](void*, uint8_t*) {}, nullptr, 0);
+    bool isConverted = output->buf[0] && sws_scale_frame(swsContext, output, decodedFrame) >= 0;
+    av_frame_free(&output);
+    return isConverted;
+#else
+    uint8_t* data[4] = {frame.data, nullptr, nullptr, nullptr};
+    int linesize[4] = {static_cast<int>(frame.step[0]), 0, 0, 0};
+    return sws_scale(swsContext, decodedFrame->data, decodedFrame->linesize, 0, height, data, linesize) == height;
+#endif
+}
+
+//-------------------------------- Seeking --------------------------------
+
+// To the keyframe at or before the position; the position of the first decoded frame is taken from its timestamp
+bool FFmpegVideoDecoder::seekKeyframe(int position) {
+    if (fps <= 0.0 || timeBase <= 0.0) {
+        return false;
+    }
+    int64_t target = startTime + static_cast<int64_t>(std::llround(position / fps / timeBase));
+    if (av_seek_frame(formatContext, streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "FFmpeg: failed to seek to frame " << position << std::endl;
+        return false;
+    }
+    avcodec_flush_buffers(codecContext);
+    isFramePending = false;
+    isDraining = false;
+    isPositionKnown = false;
+    nextPosition = position;
+    return true;
+}
+
+int FFmpegVideoDecoder::toPosition(int64_t pts) const {
+    if (pts == AV_NOPTS_VALUE || fps <= 0.0) {
+        return -1;
+    }
+    return static_cast<int>(std::llround((pts - startTime) * timeBase * fps));
+}
@@ -0,0 +1,75 @@
+#ifndef FFMPEGVIDEODECODER_H
+#define FFMPEGVIDEODECODER_H
+
+/*********************************************** FFmpeg Video Decoder ***************************************************
+ * Video Decoder on libavformat / libavcodec / libswscale (built with HAVE_FFMPEG).
+ *  - the decoder runs frame and slice threads (H.264 1080p decodes several frames at once), threadCount 0: auto
+ *  - the decoded frame (YUV) is converted to BGR by swscale directly into the output Mat, so a pooled buffer is filled
+ *    without an intermediate copy; frames that are only grabbed are not converted
+ *  - positions come from the presentation timestamps (best effort): after a seek the position of the first decoded
+ *    frame is computed from its timestamp, following frames are counted (as the frame IDs of video_timestamps.txt)
+ *  - seek: to the keyframe before the position (av_seek_frame), then decoding forward; short jumps forward only decode
+ *
+ * The decoded frame is kept until it is read or grabbed, so a seek that decodes to its position does not lose it.
+*************************************************************************************************************************/
+
+#include <cstdint>
+
+#include "videodecoder.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+class FFmpegVideoDecoder : public VideoDecoder
+{
+public:
+    explicit FFmpegVideoDecoder(int threadCount = 0);
+    ~FFmpegVideoDecoder() override;
+
+    bool open(const std::string& filename) override;
+    void release() override;
+    bool isOpened() const override;
+
+    bool read(cv::Mat& frame) override;
+    bool grab() override;
+    bool seek(int position) override;
+    int getPosition() const override;
+
+    int getFrameCount() const override;
+    double getFPS() const override;
+    cv::Size getFrameSize() const override;
+    double getTimestamp() const override;
+    std::string getName() const override;
+
+private:
+    int threadCount;
+    AVFormatContext* formatContext;
+    AVCodecContext* codecContext;
+    AVFrame* decodedFrame;
+    AVPacket* packet;
+    SwsContext* swsContext;
+    int swsWidth, swsHeight, swsFormat; // input of swsContext
+    int streamIndex;
+    double timeBase; // seconds per timestamp unit
+    int64_t startTime; // timestamp of the first frame
+    double fps;
+    int frameCount;
+
+    int nextPosition; // of the pending frame if isFramePending, otherwise of the next decoded frame
+    bool isPositionKnown; // false after a seek until a frame is decoded
+    bool isFramePending; // decodedFrame was not read yet
+    bool isDraining; // end of file: the decoder returns the frames it holds
+    double timestamp; // ms
+
+    bool decodeFrame(); // into decodedFrame
+    bool ensureFrame(); // a frame is pending and its position known
+    bool convertFrame(cv::Mat& frame);
+    void consumeFrame();
+    bool seekKeyframe(int position);
+    int toPosition(int64_t pts) const;
+};
+
+#endif // FFMPEGVIDEODECODER_H
@@ -0,0 +1,214 @@
+#include "framecache.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "videodecoder.h"
+
+static const int PREFETCH_DECODER_THREADS = 2; // prefetching runs next to playback decoding and the workers
+
+FrameCache::FrameCache(size_t budget):
+    budget(budget)
+    , memoryUsage(0)
+    , prefetchPosition(-1)
+    , generation(0)
+    , shouldStop(false)
+{
+    prefetchThread = std::thread(&FrameCache::prefetchLoop, this);
+}
+
+FrameCache::~FrameCache() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        shouldStop = true;
+        generation++;
+    }
+    prefetchCondition.notify_all();
+    prefetchThread.join();
+}
+
+void FrameCache::open(const std::string& filename, const std::vector<int>& keyframePositions) {
+    std::lock_guard<std::mutex> lock(mtx);
+    gops.clear();
+    lru.clear();
+    memoryUsage = 0;
+    keyframes = keyframePositions;
+    videoFilename = filename;
+    prefetchPosition = -1;
+    generation++;
+}
+
+void FrameCache::close() {
+    open(std::string(), std::vector<int>());
+}
+
+void FrameCache::setBudget(size_t newBudget) {
+    std::lock_guard<std::mutex> lock(mtx);
+    budget = newBudget;
+    evict(-1);
+}
+
+//-------------------------------- Lookup --------------------------------
+bool FrameCache::find(int position, cv::Mat& frame) {
+    std::lock_guard<std::mutex> lock(mtx);
+    int gopStart = getGOPStart(position);
+    auto gop = gops.find(gopStart);
+    if (gop == gops.end()) {
+        return false;
+    }
+
+    auto cachedFrame = gop->second.frames.find(position);
+    if (cachedFrame == gop->second.frames.end()) {
+        return false;
+    }
+    touch(gop->second);
+    frame = cachedFrame->second;
+
+    return true;
+}
+
+void FrameCache::insert(int position, const cv::Mat& frame) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (budget == 0 || frame.empty()) {
+        return;
+    }
+
+    int gopStart = getGOPStart(position);
+    auto inserted = gops.try_emplace(gopStart);
+    GOP& gop = inserted.first->second;
+    if (inserted.second) {
+        lru.push_front(gopStart);
+        gop.lruPosition = lru.begin();
+    }
+
+    if (gop.frames.emplace(position, frame).second) {
+        size_t bytes = frame.total() * frame.elemSize();
+        gop.bytes += bytes;
+        memoryUsage += bytes;
+    }
+    touch(gop);
+    evict(gopStart);
+}
+
+size_t FrameCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return memoryUsage;
+}
+
+bool FrameCache::contains(int position) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto gop = gops.find(getGOPStart(position));
+
+    return gop != gops.end() && gop->second.frames.count(position) > 0;
+}
+
+// The nearest keyframe <= position
+int FrameCache::getGOPStart(int position) const {
+    if (keyframes.empty()) {
+        return position / DEFAULT_GOP_SIZE * DEFAULT_GOP_SIZE;
+    }
+    auto keyframe = std::upper_bound(keyframes.begin(), keyframes.end(), position);
+
+    return keyframe == keyframes.begin() ? 0 : *(keyframe - 1);
+}
+
+void FrameCache::touch(GOP& gop) {
+    if (gop.lruPosition != lru.begin()) {
+        lru.splice(lru.begin(), lru, gop.lruPosition);
+    }
+}
+
+// Least recently used GOPs are evicted as a whole. The GOP being filled is evicted only if it exceeds the budget alone
+// (then its first frames, e.g. the oldest ones when playing)
+void FrameCache::evict(int protectedGOPStart) {
+    while (memoryUsage > budget && !lru.empty()) {
+        int gopStart = lru.back();
+        GOP& gop = gops[gopStart];
+
+        if (gopStart == protectedGOPStart && lru.size() > 1) {
+            lru.splice(lru.begin(), lru, gop.lruPosition);
+            continue;
+        }
+
+        if (gopStart == protectedGOPStart && gop.frames.size() > 1) {
+            auto oldest = gop.frames.begin();
+            size_t bytes = oldest->second.total() * oldest->second.elemSize();
+            gop.bytes -= bytes;
+            memoryUsage -= bytes;
+            gop.frames.erase(oldest);
+            continue;
+        }
+
+        memoryUsage -= gop.bytes;
+        lru.pop_back();
+        gops.erase(gopStart);
+    }
+}
+
+//-------------------------------- Prefetch --------------------------------
+void FrameCache::prefetch(int position) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (budget == 0 || videoFilename.empty() || position < 0) {
+            return;
+        }
+        prefetchPosition = position;
+        generation++;
+    }
+    prefetchCondition.notify_one();
+}
+
+// Frames [start of the previous GOP, position) are decoded from a keyframe in one forward pass.
+// Frames already cached are only grabbed (not retrieved). A new request or a new video stops the pass
+void FrameCache::prefetchLoop() {
+    std::unique_ptr<VideoDecoder> decoder;
+    std::string openedFilename;
+    int capturePosition = -1; // position of the next read
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        prefetchCondition.wait(lock, [this] { return shouldStop || prefetchPosition >= 0; });
+        if (shouldStop) {
+            break;
+        }
+
+        int position = prefetchPosition;
+        int requestGeneration = generation;
+        int start = getGOPStart(position);
+        start = start > 0 ? getGOPStart(start - 1) : start;
+        std::string filename = videoFilename;
+        prefetchPosition = -1;
+        lock.unlock();
+
+        if (filename != openedFilename || !decoder || !decoder->isOpened()) {
+            decoder.reset();
+            openedFilename = filename;
+            capturePosition = -1;
+            decoder = VideoDecoder::create(filename, VideoDecoder::Backend::Auto, PREFETCH_DECODER_THREADS);
+            if (!decoder->isOpened()) {
+                std::cerr << "Frame cache: failed to open video for prefetching: " << filename << std::endl;
+            }
+        }
+
+        if (decoder->isOpened()) {
+            if (capturePosition != start) {
+                // If the decoder cannot seek there, nothing is prefetched (frames would be cached under wrong positions)
+                capturePosition = decoder->seek(start) && decoder->getPosition() == start ? start : -1;
+            }
+
+            for (; capturePosition >= 0 && capturePosition < position && generation == requestGeneration; ++capturePosition) {
+                cv::Mat frame;
+                bool isCached = contains(capturePosition);
+                if (isCached ? !decoder->grab() : (!decoder->read(frame) || frame.empty())) {
+                    capturePosition = -1; // end of the video or a broken frame: seek again next time
+                    break;
+                }
+                if (!isCached) {
+                    insert(capturePosition, frame);
+                }
+            }
+        }
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+/*********************************************** Frame Cache ************************************************************
+ * Decoded frames (BGR) of the played video, kept in memory up to a budget, so that scrubbing and stepping backward
+ * do not decode the same frames again.
+ *
+ *  - frames are grouped by GOP (keyframe to keyframe, from the Video Index; fixed groups if the video has no index).
+ *    Decoding any frame of a GOP costs decoding the GOP up to it, so whole GOPs are evicted, least recently used first
+ *  - frames are shared (cv::Mat reference counting), inserting and finding never copies pixels
+ *  - prefetch: after a seek, a background thread with its own decoder decodes the frames before the position
+ *    (its GOP and the previous one). The Video Processor decodes forward itself, so stepping backward becomes a hit
+ *
+ * Positions are 0-based (as CAP_PROP_POS_FRAMES). Cached frames must not be modified (they are shared).
+*************************************************************************************************************************/
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+class FrameCache
+{
+public:
+    explicit FrameCache(size_t budget = DEFAULT_BUDGET); // bytes
+    ~FrameCache();
+
+    // New video: the cache is cleared. keyframePositions are sorted (0-based); empty if unknown
+    void open(const std::string& videoFilename, const std::vector<int>& keyframePositions);
+    void close();
+    void setBudget(size_t budget); // 0 disables the cache
+
+    bool find(int position, cv::Mat& frame);
+    void insert(int position, const cv::Mat& frame);
+    void prefetch(int position); // returns immediately; a previous prefetch is cancelled
+    size_t getMemoryUsage() const;
+
+    static const size_t DEFAULT_BUDGET = 512 * 1024 * 1024;
+    static const int DEFAULT_GOP_SIZE = 30; // grouping of videos without keyframe positions
+
+private:
+    struct GOP {
+        std::map<int, cv::Mat> frames; // position -> frame
+        size_t bytes = 0;
+        std::list<int>::iterator lruPosition;
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<int, GOP> gops; // first position of the GOP -> GOP
+    std::list<int> lru; // first positions of GOPs, most recently used first
+    std::vector<int> keyframes;
+    size_t budget, memoryUsage;
+
+    // Prefetch
+    std::thread prefetchThread;
+    std::condition_variable prefetchCondition;
+    std::string videoFilename;
+    int prefetchPosition; // -1: nothing to prefetch
+    std::atomic<int> generation; // incremented by every request (cancels the running prefetch)
+    bool shouldStop;
+
+    int getGOPStart(int position) const;
+    void touch(GOP& gop);
+    void evict(int protectedGOPStart);
+    bool contains(int position) const;
+    void prefetchLoop();
+};
+
+#endif // FRAMECACHE_H
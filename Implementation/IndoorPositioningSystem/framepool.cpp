@@ -0,0 +1,149 @@
+#include "framepool.h"
+
+static const size_t DEFAULT_MAX_IDLE_BYTES = 256 * 1024 * 1024;
+
+FramePool::FramePool(): idleBytes(0), maxIdleBytes(DEFAULT_MAX_IDLE_BYTES) {}
+
+FramePool::~FramePool() {
+    for (auto& buffers : idleBuffers) {
+        for (unsigned char* buffer : buffers.second) {
+            cv::fastFree(buffer);
+        }
+    }
+}
+
+// Destroyed at exit, after all frames (the UI is destroyed when main returns)
+FramePool& FramePool::getInstance() {
+    static FramePool pool;
+    return pool;
+}
+
+void FramePool::reserve(size_t size, int count) {
+    std::vector<unsigned char*> buffers;
+    for (int i = 0; i < count; ++i) {
+        buffers.push_back(acquire(size));
+    }
+    for (unsigned char* buffer : buffers) {
+        release(buffer, size);
+    }
+}
+
+void FramePool::setMaxIdleBytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    maxIdleBytes = bytes;
+}
+
+//-------------------------------- Buffers --------------------------------
+unsigned char* FramePool::acquire(size_t size) const {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto buffers = idleBuffers.find(size);
+        if (buffers != idleBuffers.end() && !buffers->second.empty()) {
+            unsigned char* buffer = buffers->second.back();
+            buffers->second.pop_back();
+            idleBytes -= size;
+            return buffer;
+        }
+    }
+
+    return static_cast<unsigned char*>(cv::fastMalloc(size)); // 64-byte aligned
+}
+
+void FramePool::release(unsigned char* data, size_t size) const {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (idleBytes + size <= maxIdleBytes) {
+            idleBuffers[size].push_back(data);
+            idleBytes += size;
+            return;
+        }
+    }
+
+    cv::fastFree(data);
+}
+
+//-------------------------------- QImage --------------------------------
+QImage FramePool::createImage(int width, int height, QImage::Format format) {
+    qsizetype bytesPerLine = ((static_cast<qsizetype>(width) * QImage::toPixelFormat(format).bitsPerPixel() + 31) / 32) * 4;
+    size_t size = static_cast<size_t>(bytesPerLine) * height;
+    unsigned char* data = acquire(size);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        imageBuffers[data] = size;
+    }
+
+    return QImage(data, width, height, bytesPerLine, format, &FramePool::releaseImageBuffer, data);
+}
+
+QImage FramePool::wrap(const cv::Mat& frame) {
+    if (frame.step[0] % 4 != 0) {
+        QImage image = createImage(frame.cols, frame.rows, QImage::Format_BGR888);
+        frame.copyTo(cv::Mat(frame.rows, frame.cols, CV_8UC3, image.bits(), image.bytesPerLine()));
+        return image;
+    }
+
+    // The image keeps a reference to the frame; const data, so the image is never modified in place
+    cv::Mat* reference = new cv::Mat(frame);
+    return QImage(static_cast<const uchar*>(frame.data), frame.cols, frame.rows, static_cast<qsizetype>(frame.step[0]), QImage::Format_BGR888,
+                  &FramePool::releaseWrappedFrame, reference);
+}
+
+void FramePool::releaseImageBuffer(void* data) {
+    FramePool& pool = getInstance();
+    unsigned char* buffer = static_cast<unsigned char*>(data);
+    size_t size;
+    {
+        std::lock_guard<std::mutex> lock(pool.mtx);
+        auto imageBuffer = pool.imageBuffers.find(buffer);
+        size = imageBuffer->second;
+        pool.imageBuffers.erase(imageBuffer);
+    }
+    pool.release(buffer, size);
+}
+
+void FramePool::releaseWrappedFrame(void* frame) {
+    delete static_cast<cv::Mat*>(frame);
+}
+
+//-------------------------------- cv::MatAllocator (as cv::StdMatAllocator, with pooled data) --------------------------------
+cv::UMatData* FramePool::allocate(int dims, const int* sizes, int type, void* data0, size_t* step, cv::AccessFlag, cv::UMatUsageFlags) const {
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = data0 ? static_cast<uchar*>(data0) : acquire(total);
+    u->size = total;
+    if (data0) {
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const {
+    return u != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+        release(u->origdata, u->size);
+        u->origdata = nullptr;
+    }
+    delete u;
+}
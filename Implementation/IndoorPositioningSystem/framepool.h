@@ -0,0 +1,56 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+/*********************************************** Frame Pool *************************************************************
+ * Recycled buffers for the frames of the played video (decoded frame, detector input, frame for Video Player), so that
+ * frames do not allocate (and page-fault) several MB of memory each:
+ *  - cv::Mat: the pool is a cv::MatAllocator (mat.allocator = &FramePool::getInstance() before create / read).
+ *    The buffer returns to the pool when the last Mat referencing it is destroyed (OpenCV reference counting)
+ *  - QImage: createImage wraps a pooled buffer; cv::Mat views of bits() write into the same memory.
+ *    The buffer returns to the pool when the last copy of the image is destroyed (QImage is implicitly shared,
+ *    so passing it through DataProcessor, ThreadSafeQueue and signals to the UI does not copy pixels)
+ *  - wrap: read-only QImage of a decoded cv::Mat (no copy at all), used when the frame is shown as decoded
+ *
+ * Frames queued for the Video Player can outlive Video Processor, so there is one pool for the whole application.
+ * Idle buffers are kept up to a limit, the rest is freed.
+*************************************************************************************************************************/
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <QImage>
+#include <opencv2/opencv.hpp>
+
+class FramePool : public cv::MatAllocator
+{
+public:
+    static FramePool& getInstance();
+
+    void reserve(size_t size, int count); // preallocates buffers of the size (bytes)
+    void setMaxIdleBytes(size_t bytes);
+
+    QImage createImage(int width, int height, QImage::Format format); // writable, scanlines 32-bit aligned
+    QImage wrap(const cv::Mat& frame); // BGR frame; copied into a pooled image only if its scanlines are not 32-bit aligned
+
+    // cv::MatAllocator
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+    FramePool();
+    ~FramePool();
+
+    mutable std::mutex mtx;
+    mutable std::unordered_map<size_t, std::vector<unsigned char*>> idleBuffers; // size -> buffers
+    mutable std::unordered_map<unsigned char*, size_t> imageBuffers; // buffers of QImages -> size
+    mutable size_t idleBytes;
+    size_t maxIdleBytes;
+
+    unsigned char* acquire(size_t size) const;
+    void release(unsigned char* data, size_t size) const;
+    static void releaseImageBuffer(void* data);
+    static void releaseWrappedFrame(void* frame);
+};
+
+#endif // FRAMEPOOL_H
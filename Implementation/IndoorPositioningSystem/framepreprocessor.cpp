@@ -0,0 +1,256 @@
+#include "framepreprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const double MIN_ROI_GAIN = 0.9; // ROI covering more of the frame is not worth cropping
+static const cv::Scalar PADDING_COLOR(114, 114, 114); // letterbox padding (as in YOLO training)
+
+FramePreprocessor::FramePreprocessor(): detectionFrameSize(640, 640), detectionROI(0, 0, 1, 1), inputSize(640), isInputSquare(false), detectorInputSize(640, 640), contentSize(640, 640), isCalibrated(false), isDisplayUndistortion(true) {}
+
+void FramePreprocessor::setDetectionFrameSize(const cv::Size& size) {
+    if (size != detectionFrameSize) {
+        detectionFrameSize = size;
+        updateDetectorInputSize();
+        mapsFrameSize = cv::Size(); // maps are rebuilt by the next prepare
+    }
+}
+
+void FramePreprocessor::setDetectorInputSize(int size, bool isSquare) {
+    inputSize = std::max(32, size / 32 * 32);
+    isInputSquare = isSquare;
+    updateDetectorInputSize();
+    mapsFrameSize = cv::Size();
+}
+
+void FramePreprocessor::setFrameSize(const cv::Size& size) {
+    frameSize = size;
+    updateDetectorInputSize();
+    mapsFrameSize = cv::Size();
+}
+
+void FramePreprocessor::setDetectionROI(const cv::Rect2d& roi) {
+    cv::Rect2d clipped = roi & cv::Rect2d(0, 0, 1, 1);
+    detectionROI = clipped.area() <= 0 || clipped.area() > MIN_ROI_GAIN ? cv::Rect2d(0, 0, 1, 1) : clipped;
+    updateDetectorInputSize();
+    mapsFrameSize = cv::Size();
+}
+
+const cv::Rect2d& FramePreprocessor::getDetectionROI() const {
+    return detectionROI;
+}
+
+const cv::Size& FramePreprocessor::getDetectorInputSize() const {
+    return detectorInputSize;
+}
+
+const cv::Size& FramePreprocessor::getContentSize() const {
+    return contentSize;
+}
+
+// Letterbox: the whole frame scaled (aspect ratio kept) so that its longer side is the input size; the ROI is cropped
+// at the same scale. The input is rounded up to a multiple of 32 (or the square of the input size) by padding
+void FramePreprocessor::updateDetectorInputSize() {
+    const cv::Size frame = frameSize.empty() ? detectionFrameSize : frameSize;
+    const double scale = static_cast<double>(inputSize) / std::max(frame.width, frame.height);
+    contentSize = cv::Size(std::clamp(cvRound(detectionROI.width * frame.width * scale), 1, inputSize),
+                           std::clamp(cvRound(detectionROI.height * frame.height * scale), 1, inputSize));
+
+    auto roundUp = [this](int size) { return std::min(inputSize, (size + 31) / 32 * 32); };
+    detectorInputSize = isInputSquare ? cv::Size(inputSize, inputSize) : cv::Size(roundUp(contentSize.width), roundUp(contentSize.height));
+}
+
+// Inverse letterbox: padding is cut off, the content is scaled to the ROI of the detection frame
+cv::Rect FramePreprocessor::toDetectionFrame(const cv::Rect& box) const {
+    cv::Rect content = box & cv::Rect(cv::Point(0, 0), contentSize);
+    double scaleX = detectionROI.width * detectionFrameSize.width / contentSize.width;
+    double scaleY = detectionROI.height * detectionFrameSize.height / contentSize.height;
+    double offsetX = detectionROI.x * detectionFrameSize.width;
+    double offsetY = detectionROI.y * detectionFrameSize.height;
+
+    return cv::Rect(cvRound(offsetX + content.x * scaleX), cvRound(offsetY + content.y * scaleY), cvRound(content.width * scaleX), cvRound(content.height * scaleY));
+}
+
+void FramePreprocessor::pad(cv::Mat& detectorInput) const {
+    if (contentSize.width < detectorInputSize.width) {
+        detectorInput(cv::Rect(contentSize.width, 0, detectorInputSize.width - contentSize.width, contentSize.height)).setTo(PADDING_COLOR);
+    }
+    if (contentSize.height < detectorInputSize.height) {
+        detectorInput.rowRange(contentSize.height, detectorInputSize.height).setTo(PADDING_COLOR);
+    }
+}
+
+void FramePreprocessor::setCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Mat& optimalCameraMatrix) {
+    this->cameraMatrix = cameraMatrix.clone();
+    this->distCoeffs = distCoeffs.clone();
+    this->optimalCameraMatrix = optimalCameraMatrix.empty() ? cameraMatrix.clone() : optimalCameraMatrix.clone();
+    isCalibrated = !cameraMatrix.empty() && !distCoeffs.empty();
+    mapsFrameSize = cv::Size();
+}
+
+void FramePreprocessor::clearCalibration() {
+    isCalibrated = false;
+    mapsFrameSize = cv::Size();
+    displayMap1.release();
+    displayMap2.release();
+    detectionMap1.release();
+    detectionMap2.release();
+    trackingMap1.release();
+    trackingMap2.release();
+}
+
+bool FramePreprocessor::isUndistorting() const {
+    return isCalibrated;
+}
+
+void FramePreprocessor::setDisplayUndistortion(bool isEnabled) {
+    isDisplayUndistortion = isEnabled;
+    mapsFrameSize = cv::Size();
+}
+
+bool FramePreprocessor::isUndistortingDisplay() const {
+    return isCalibrated && isDisplayUndistortion;
+}
+
+// Computed once per calibration / frame size
+void FramePreprocessor::prepare(const cv::Size& frameSize) {
+    if (this->frameSize != frameSize) {
+        this->frameSize = frameSize;
+        updateDetectorInputSize();
+        mapsFrameSize = cv::Size();
+    }
+    if (!isCalibrated || mapsFrameSize == frameSize) {
+        return;
+    }
+
+    if (isDisplayUndistortion) {
+        cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), optimalCameraMatrix, frameSize, CV_16SC2, displayMap1, displayMap2);
+        trackingMap1.release();
+        trackingMap2.release();
+    } else {
+        // The tracking image cannot be resized from the display frame: undistortion + resize to the detection frame
+        cv::Mat trackingCameraMatrix;
+        optimalCameraMatrix.convertTo(trackingCameraMatrix, CV_64F);
+        double scaleX = static_cast<double>(detectionFrameSize.width) / frameSize.width;
+        double scaleY = static_cast<double>(detectionFrameSize.height) / frameSize.height;
+        trackingCameraMatrix.at<double>(0, 0) *= scaleX;
+        trackingCameraMatrix.at<double>(0, 1) *= scaleX;
+        trackingCameraMatrix.at<double>(0, 2) = (trackingCameraMatrix.at<double>(0, 2) + 0.5) * scaleX - 0.5;
+        trackingCameraMatrix.at<double>(1, 1) *= scaleY;
+        trackingCameraMatrix.at<double>(1, 2) = (trackingCameraMatrix.at<double>(1, 2) + 0.5) * scaleY - 0.5;
+        cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), trackingCameraMatrix, detectionFrameSize, CV_16SC2, trackingMap1, trackingMap2);
+        displayMap1.release();
+        displayMap2.release();
+    }
+
+    // Composite map: undistortion followed by crop (ROI) and resize to the content of the detector input.
+    // Crop and resize only shift and scale the new camera matrix (pixel centers are kept aligned the same way as in cv::resize)
+    double scaleX = contentSize.width / (detectionROI.width * frameSize.width);
+    double scaleY = contentSize.height / (detectionROI.height * frameSize.height);
+    double offsetX = detectionROI.x * frameSize.width;
+    double offsetY = detectionROI.y * frameSize.height;
+    cv::Mat detectionCameraMatrix;
+    optimalCameraMatrix.convertTo(detectionCameraMatrix, CV_64F);
+    detectionCameraMatrix.at<double>(0, 0) *= scaleX;
+    detectionCameraMatrix.at<double>(0, 1) *= scaleX;
+    detectionCameraMatrix.at<double>(0, 2) = (detectionCameraMatrix.at<double>(0, 2) - offsetX + 0.5) * scaleX - 0.5;
+    detectionCameraMatrix.at<double>(1, 1) *= scaleY;
+    detectionCameraMatrix.at<double>(1, 2) = (detectionCameraMatrix.at<double>(1, 2) - offsetY + 0.5) * scaleY - 0.5;
+    cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), detectionCameraMatrix, contentSize, CV_16SC2, detectionMap1, detectionMap2);
+
+    mapsFrameSize = frameSize;
+}
+
+// Frames without prepared maps (other frame size) are passed without undistortion
+void FramePreprocessor::process(const cv::Mat& source, cv::Mat& displayFrame, cv::Mat* detectorInput) const {
+    if (!isCalibrated || mapsFrameSize != source.size()) {
+        displayFrame = source; // nothing to do, no copy
+        if (detectorInput) {
+            resizeForDetection(source, *detectorInput);
+        }
+        return;
+    }
+
+    if (!isDisplayUndistortion) {
+        displayFrame = source;
+    } else {
+        if (displayFrame.data == source.data) {
+            displayFrame.release(); // shares the source (previous frame without undistortion)
+        }
+        displayFrame.create(source.size(), source.type());
+    }
+    if (detectorInput) {
+        detectorInput->create(detectorInputSize, source.type());
+    }
+
+    // Both outputs are produced stripe by stripe, so the rows of the source used by a stripe stay in cache
+    const int stripes = std::max(1, cv::getNumThreads());
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+        for (int stripe = range.start; stripe < range.end; ++stripe) {
+            if (isDisplayUndistortion) {
+                int displayBegin = source.rows * stripe / stripes;
+                int displayEnd = source.rows * (stripe + 1) / stripes;
+                cv::Mat displayStripe = displayFrame.rowRange(displayBegin, displayEnd);
+                cv::remap(source, displayStripe, displayMap1.rowRange(displayBegin, displayEnd), displayMap2.rowRange(displayBegin, displayEnd), cv::INTER_LINEAR);
+            }
+
+            if (detectorInput) {
+                int detectionBegin = contentSize.height * stripe / stripes;
+                int detectionEnd = contentSize.height * (stripe + 1) / stripes;
+                cv::Mat detectionStripe = (*detectorInput)(cv::Range(detectionBegin, detectionEnd), cv::Range(0, contentSize.width));
+                cv::remap(source, detectionStripe, detectionMap1.rowRange(detectionBegin, detectionEnd), detectionMap2.rowRange(detectionBegin, detectionEnd), cv::INTER_LINEAR);
+            }
+        }
+    });
+    if (detectorInput) {
+        pad(*detectorInput);
+    }
+}
+
+void FramePreprocessor::resizeForDetection(const cv::Mat& source, cv::Mat& detectorInput) const {
+    detectorInput.create(detectorInputSize, source.type());
+    cv::Mat content = detectorInput(cv::Rect(cv::Point(0, 0), contentSize));
+    if (detectionROI == cv::Rect2d(0, 0, 1, 1)) {
+        cv::resize(source, content, contentSize);
+    } else {
+        cv::Rect roi(cvRound(detectionROI.x * source.cols), cvRound(detectionROI.y * source.rows),
+                     cvRound(detectionROI.width * source.cols), cvRound(detectionROI.height * source.rows));
+        cv::resize(source(roi & cv::Rect(0, 0, source.cols, source.rows)), content, contentSize);
+    }
+    pad(detectorInput);
+}
+
+void FramePreprocessor::makeTrackingImage(const cv::Mat& source, const cv::Mat& displayFrame, cv::Mat& trackingImage) const {
+    cv::Mat resized;
+    if (trackingMap1.empty() || mapsFrameSize != source.size()) {
+        cv::resize(displayFrame, resized, detectionFrameSize, 0, 0, cv::INTER_AREA);
+    } else {
+        cv::remap(source, resized, trackingMap1, trackingMap2, cv::INTER_LINEAR);
+    }
+    cv::cvtColor(resized, trackingImage, cv::COLOR_BGR2GRAY);
+}
+
+// Boxes are undistorted (detection frame); on a distorted display frame their corners are distorted back
+cv::Rect FramePreprocessor::toDisplayFrame(const cv::Rect& box, const cv::Size& displaySize) const {
+    double scaleX = static_cast<double>(displaySize.width) / detectionFrameSize.width;
+    double scaleY = static_cast<double>(displaySize.height) / detectionFrameSize.height;
+    cv::Rect scaled(cvRound(box.x * scaleX), cvRound(box.y * scaleY), cvRound(box.width * scaleX), cvRound(box.height * scaleY));
+    if (!isCalibrated || isDisplayUndistortion || displaySize != mapsFrameSize) {
+        return scaled;
+    }
+
+    cv::Mat newCameraMatrix;
+    optimalCameraMatrix.convertTo(newCameraMatrix, CV_64F);
+    double fx = newCameraMatrix.at<double>(0, 0), fy = newCameraMatrix.at<double>(1, 1);
+    double cx = newCameraMatrix.at<double>(0, 2), cy = newCameraMatrix.at<double>(1, 2);
+    std::vector<cv::Point3d> corners;
+    for (const cv::Point& corner : {scaled.tl(), cv::Point(scaled.br().x, scaled.y), scaled.br(), cv::Point(scaled.x, scaled.br().y)}) {
+        corners.emplace_back((corner.x - cx) / fx, (corner.y - cy) / fy, 1.0);
+    }
+    std::vector<cv::Point2d> distorted;
+    cv::projectPoints(corners, cv::Vec3d(0, 0, 0), cv::Vec3d(0, 0, 0), cameraMatrix, distCoeffs, distorted);
+
+    std::vector<cv::Point> points(distorted.begin(), distorted.end());
+    return cv::boundingRect(points);
+}
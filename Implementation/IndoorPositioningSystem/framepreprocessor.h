@@ -0,0 +1,70 @@
+#ifndef FRAMEPREPROCESSOR_H
+#define FRAMEPREPROCESSOR_H
+
+/*********************************************** Frame Preprocessor ***************************************************
+ * Prepares a decoded video frame for the Video Player and for the Human Detector in one pass:
+ *  - display frame: undistorted frame of the original size (BGR, shown by QImage::Format_BGR888 without conversion)
+ *  - detector input: undistorted frame letterboxed to the detector input size (e.g. 1280x720 at 640 -> 640x360 content,
+ *    padded to 640x384 with gray at the right and bottom; square: padded to 640x640). The aspect ratio is kept, so people
+ *    are not stretched. The input size (320 / 416 / 512 / 640) trades accuracy for speed.
+ *
+ * Detection ROI (optional): only the region where people can stand (floor area) is fed to the detector. The detector input
+ * is the crop of the ROI at the same pixel density as the whole letterboxed frame (e.g. half of the frame -> half of the
+ * content), so inference cost scales with the monitored area.
+ * Boxes are mapped back (padding removed) to the detection frame - the space of all detections (e.g. 640x640 for the whole
+ * frame, as the Pixel-to-Real model expects).
+ *
+ * Undistortion maps are computed only once, when the calibration (or the frame size) changes.
+ * The display frame can be left distorted (Quality Controller, to save the full-size remap): the detector input and the
+ * tracking image are still undistorted, and boxes are distorted when drawn (toDisplayFrame).
+ * The detector input is produced by a composite map (undistortion + resize), so it is sampled directly from the
+ * source frame. Both outputs are computed stripe by stripe in parallel (cv::remap is SIMD-vectorized).
+ * Colour conversion is not needed: QImage reads BGR and cv::dnn::blobFromImage swaps channels itself.
+************************************************************************************************************************/
+
+#include <opencv2/opencv.hpp>
+
+class FramePreprocessor
+{
+public:
+    FramePreprocessor();
+
+    void setDetectionFrameSize(const cv::Size& size);
+    void setDetectorInputSize(int size, bool isSquare = false); // the longer side of the letterboxed frame (multiple of 32)
+    void setFrameSize(const cv::Size& size); // of the decoded frames; unknown: as the detection frame (stretched)
+    void setDetectionROI(const cv::Rect2d& roi); // normalized (0..1) in the frame; empty or almost the whole frame: no ROI
+    const cv::Rect2d& getDetectionROI() const;
+    const cv::Size& getDetectorInputSize() const; // multiple of 32 (YOLO)
+    const cv::Size& getContentSize() const; // of the frame (ROI) in the detector input, at the top left; the rest is padding
+    cv::Rect toDetectionFrame(const cv::Rect& box) const; // box detected in the detector input -> detection frame
+    void setCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Mat& optimalCameraMatrix);
+    void clearCalibration();
+    bool isUndistorting() const; // the detector input (and the display frame, unless disabled)
+    void setDisplayUndistortion(bool isEnabled); // false: the display frame is the decoded frame as it is
+    bool isUndistortingDisplay() const;
+
+    // Builds the maps for the frame size. Must be called before process (process is const, so it can run in parallel)
+    void prepare(const cv::Size& frameSize);
+    // detectorInput is optional (nullptr if people are not detected in this frame)
+    void process(const cv::Mat& source, cv::Mat& displayFrame, cv::Mat* detectorInput) const;
+    // Detector input only, without undistortion (export works with frames as read)
+    void resizeForDetection(const cv::Mat& source, cv::Mat& detectorInput) const;
+    // Undistorted gray frame at the detection frame size (Person Tracker); displayFrame is the output of process
+    void makeTrackingImage(const cv::Mat& source, const cv::Mat& displayFrame, cv::Mat& trackingImage) const;
+    cv::Rect toDisplayFrame(const cv::Rect& box, const cv::Size& displaySize) const; // detection frame -> display frame
+
+private:
+    cv::Mat cameraMatrix, distCoeffs, optimalCameraMatrix;
+    cv::Size detectionFrameSize, mapsFrameSize, frameSize;
+    cv::Rect2d detectionROI;
+    int inputSize;
+    bool isInputSquare;
+    cv::Size detectorInputSize, contentSize;
+    cv::Mat displayMap1, displayMap2, detectionMap1, detectionMap2, trackingMap1, trackingMap2;
+    bool isCalibrated, isDisplayUndistortion;
+
+    void updateDetectorInputSize();
+    void pad(cv::Mat& detectorInput) const;
+};
+
+#endif // FRAMEPREPROCESSOR_H
@@ -1,83 +1,367 @@
 #include "humandetector.h"
 
-HumanDetector::HumanDetector(): _isInitialized(false) {}
+#include <algorithm>
+#include <chrono>
+
+static const int CALIBRATION_FRAMES = 16; // int8 quantization
+
+HumanDetector::HumanDetector(): _isInitialized(false), confidenceThreshold(0.5f), nmsThreshold(0.4f), format(DetectorFormat::Darknet), blobTime(0.0), inferenceTime(0.0), postprocessingTime(0.0), timedFrames(0), tunedBatchSize(1), isBatchSupported(true) {}
 
 void HumanDetector::initHumanDetection(const std::string &modelConfiguration, const std::string &modelWeights) {
 
     try {
         net = cv::dnn::readNetFromDarknet(modelConfiguration, modelWeights);
+        format = DetectorFormat::Darknet;
+        configureNet();
+    } catch (const cv::Exception &e) {
+        std::cerr << "Error: Failed to load network. " << e.what() << std::endl;
+        _isInitialized = false;
+    }
+}
 
-        net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-        net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+// Model files already read into memory (several detectors of the same model read the files once)
+void HumanDetector::initHumanDetection(const std::vector<uchar>& modelConfiguration, const std::vector<uchar>& modelWeights) {
+    initHumanDetection(DetectorConfig(), modelConfiguration, modelWeights);
+}
+
+// Darknet: configuration + weights; ONNX: the model only (configuration is empty)
+void HumanDetector::initHumanDetection(const DetectorConfig& config, const std::vector<uchar>& modelConfiguration, const std::vector<uchar>& model, const cv::Mat& calibrationBlob) {
 
-        _isInitialized = true;
+    try {
+        if (config.format == DetectorFormat::ONNX) {
+            net = cv::dnn::readNetFromONNX(model);
+        } else {
+            net = cv::dnn::readNetFromDarknet(modelConfiguration, model);
+        }
+        format = config.format;
+        confidenceThreshold = config.confidenceThreshold;
+        nmsThreshold = config.nmsThreshold;
+        configureNet(config.precision, calibrationBlob);
     } catch (const cv::Exception &e) {
         std::cerr << "Error: Failed to load network. " << e.what() << std::endl;
         _isInitialized = false;
     }
 }
 
+// INT8: a quantized ONNX model runs as it is; a float model is quantized here if calibration frames are given.
+// FP16 needs OpenCV 4.9+ (the CPU target is used otherwise)
+void HumanDetector::configureNet(DetectorPrecision precision, const cv::Mat& calibrationBlob) {
+    int target = cv::dnn::DNN_TARGET_CPU;
+
+    if (precision == DetectorPrecision::INT8 && !calibrationBlob.empty()) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+        try {
+            net = net.quantize(calibrationBlob, CV_32F, CV_32F);
+        } catch (const cv::Exception &e) {
+            std::cerr << "Warning: Failed to quantize the network, fp32 is used. " << e.what() << std::endl;
+        }
+#else
+        std::cerr << "Warning: Quantization requires OpenCV 4.6+, fp32 is used." << std::endl;
+#endif
+    } else if (precision == DetectorPrecision::FP16) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+        target = cv::dnn::DNN_TARGET_CPU_FP16;
+#else
+        std::cerr << "Warning: fp16 on the CPU requires OpenCV 4.9+, fp32 is used." << std::endl;
+#endif
+    }
+
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(target);
+
+    // Output layers do not change, resolved once
+    outputNames = net.getUnconnectedOutLayersNames();
+    tunedFrameSize = cv::Size();
+    isBatchSupported = true;
+
+    _isInitialized = true;
+}
+
+// Frames of the folder (jpg / png, at most CALIBRATION_FRAMES) in one blob, prepared as for detection
+cv::Mat HumanDetector::readCalibrationBlob(const std::string& folder, const cv::Size& detectionFrameSize) {
+    std::vector<cv::String> filenames, pngFilenames;
+    cv::glob(folder + "/*.jpg", filenames, false);
+    cv::glob(folder + "/*.png", pngFilenames, false);
+    filenames.insert(filenames.end(), pngFilenames.begin(), pngFilenames.end());
+
+    std::vector<cv::Mat> frames;
+    for (const cv::String& filename : filenames) {
+        if (static_cast<int>(frames.size()) >= CALIBRATION_FRAMES) {
+            break;
+        }
+        cv::Mat frame = cv::imread(filename);
+        if (!frame.empty()) {
+            frames.push_back(frame);
+        }
+    }
+    if (frames.empty()) {
+        std::cerr << "Warning: No calibration frames found in " << folder << std::endl;
+        return cv::Mat();
+    }
+
+    cv::Mat calibrationBlob;
+    cv::dnn::blobFromImages(frames, calibrationBlob, 1 / 255.0, detectionFrameSize, cv::Scalar(0, 0, 0), true, false);
+    return calibrationBlob;
+}
+
 HumanDetector::~HumanDetector() {}
 
 std::pair<std::vector<cv::Rect>, std::vector<int>> HumanDetector::detectPeople(const cv::Mat &frame, const cv::Size& detectionFrameSize)
 {
-    cv::Mat blob = cv::Mat();
-    std::vector<int> outLayers, indices;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
-    std::vector<std::string> layerNames, outputNames;
-    std::vector<cv::Mat> outputs;
-    cv::Point classIDPoint;
-    double confidence;
-    int centerX, centerY, width, height, left, top;
-
-    cv::dnn::blobFromImage(frame, blob, 1 / 255.0, detectionFrameSize, cv::Scalar(0, 0, 0), true, false);
+    return std::move(detectPeople(std::vector<cv::Mat>{frame}, detectionFrameSize).front());
+}
 
-    net.setInput(blob);
+// All frames in one blob (NCHW) and one forward pass; frames must have the same size
+std::vector<std::pair<std::vector<cv::Rect>, std::vector<int>>> HumanDetector::detectPeople(const std::vector<cv::Mat>& frames, const cv::Size& detectionFrameSize)
+{
+    std::vector<std::pair<std::vector<cv::Rect>, std::vector<int>>> results(frames.size());
+    if (frames.empty()) {
+        return results;
+    }
+    if (frames.size() > 1 && !isBatchSupported) {
+        for (size_t i = 0; i < frames.size(); ++i) {
+            results[i] = detectPeople(frames[i], detectionFrameSize);
+        }
+        return results;
+    }
 
-    layerNames = net.getLayerNames();
-    outLayers = net.getUnconnectedOutLayers();
-    outputNames.resize(outLayers.size());
-    for (size_t i = 0; i < outLayers.size(); i++)
-        outputNames[i] = layerNames[outLayers[i] - 1];
+    auto start = std::chrono::steady_clock::now();
 
-    net.forward(outputs, outputNames);
+    cv::dnn::blobFromImages(frames, blob, 1 / 255.0, detectionFrameSize, cv::Scalar(0, 0, 0), true, false);
 
-    for (const cv::Mat &output : outputs)
-    {
-        for (size_t i = 0; i < output.rows; i++)
+    auto blobEnd = std::chrono::steady_clock::now();
+    net.setInput(blob);
+    try {
+        net.forward(outputs, outputNames);
+    } catch (const cv::Exception &) {
+        if (frames.size() == 1) {
+            throw;
+        }
+        std::cerr << "Warning: The network does not take batches, frames are detected one by one." << std::endl;
+        isBatchSupported = false;
+        return detectPeople(frames, detectionFrameSize);
+    }
+
+    auto inferenceEnd = std::chrono::steady_clock::now();
+
+    const int batchSize = static_cast<int>(frames.size());
+    for (int b = 0; b < batchSize; ++b) {
+        boxes.clear();
+        confidences.clear();
+        for (const cv::Mat &output : outputs)
         {
-            const cv::Mat &scores = output.row(i).colRange(5, output.cols);
-            cv::minMaxLoc(scores, 0, &confidence, 0, &classIDPoint);
-            if (confidence > 0.5)
-            {
-                centerX = static_cast<int>(output.at<float>(i, 0) * frame.cols);
-                centerY = static_cast<int>(output.at<float>(i, 1) * frame.rows);
-                width = static_cast<int>(output.at<float>(i, 2) * frame.cols);
-                height = static_cast<int>(output.at<float>(i, 3) * frame.rows);
-                left = centerX - (width / 2);
-                top = centerY - (height / 2);
-
-                int classID = classIDPoint.x;
-                if (classID == 0)
-                {
-                    confidences.push_back(static_cast<float>(confidence));
-
-                    // we return only these values in order to draw rectangles;
-                    // the bottom center for position estimation will be calculated later
-                    boxes.emplace_back(left, top, width, height);
-                }
+            decodePeople(getFrameOutput(output, b, batchSize), frames[b].size(), detectionFrameSize);
+        }
+
+        // Only people are left, so NMS runs over person boxes only
+        cv::dnn::NMSBoxes(boxes, confidences, confidenceThreshold, nmsThreshold, indices);
+        results[b] = std::make_pair(boxes, indices);
+    }
+
+    // Timing
+    auto end = std::chrono::steady_clock::now();
+    blobTime += std::chrono::duration<double, std::milli>(blobEnd - start).count();
+    inferenceTime += std::chrono::duration<double, std::milli>(inferenceEnd - start).count();
+    postprocessingTime += std::chrono::duration<double, std::milli>(end - inferenceEnd).count();
+    timedFrames += batchSize;
+
+    return results;
+}
+
+// Rows of one frame: outputs of Darknet (region) layers stack the frames of the batch row-wise (N * rows x cols),
+// 3D outputs have the batch as the first dimension (N x rows x cols)
+cv::Mat HumanDetector::getFrameOutput(const cv::Mat& output, int frameIndex, int batchSize) {
+    if (output.dims == 3) {
+        return cv::Mat(output.size[1], output.size[2], CV_32F, const_cast<float*>(output.ptr<float>(frameIndex)));
+    }
+    int rows = output.rows / batchSize;
+    return output.rowRange(frameIndex * rows, (frameIndex + 1) * rows);
+}
+
+// Frames per second for batch sizes 1, 2, 4, ... up to maxBatchSize on a blank input; the fastest is kept for the input size.
+// Throughput of the CPU backend depends on the cores and cache, so it is measured, not guessed
+int HumanDetector::tuneBatchSize(const cv::Size& detectionFrameSize, int maxBatchSize) {
+    if (!_isInitialized) {
+        return 1;
+    }
+    if (tunedFrameSize == detectionFrameSize) {
+        return tunedBatchSize;
+    }
+
+    cv::Mat blank = cv::Mat::zeros(detectionFrameSize, CV_8UC3);
+    double bestRate = 0.0;
+    int bestBatchSize = 1;
+    for (int batchSize = 1; batchSize <= maxBatchSize; batchSize *= 2) {
+        std::vector<cv::Mat> frames(batchSize, blank);
+        cv::dnn::blobFromImages(frames, blob, 1 / 255.0, detectionFrameSize, cv::Scalar(0, 0, 0), true, false);
+        net.setInput(blob);
+        try {
+            net.forward(outputs, outputNames); // warm-up (memory for the new input shape)
+        } catch (const cv::Exception &) {
+            if (batchSize == 1) {
+                throw;
             }
+            isBatchSupported = false; // fixed input shape (e.g. ONNX exported for one frame)
+            break;
         }
+
+        const int runs = 2;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < runs; ++run) {
+            net.setInput(blob);
+            net.forward(outputs, outputNames);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double rate = runs * batchSize / seconds;
+        if (rate > bestRate * 1.05) { // a larger batch only if it is noticeably faster (it also delays results)
+            bestRate = rate;
+            bestBatchSize = batchSize;
+        }
+    }
+
+    tunedFrameSize = detectionFrameSize;
+    tunedBatchSize = bestBatchSize;
+
+    return bestBatchSize;
+}
+
+// Every output format gives the same result: person boxes in frame pixels + person scores (NMS follows).
+// ONNX outputs are told apart by their shape: more rows than columns - a row per box, otherwise a row per value
+void HumanDetector::decodePeople(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize) {
+    if (!output.isContinuous()) {
+        return;
     }
 
-    cv::dnn::NMSBoxes(boxes, confidences, 0.5, 0.4, indices);
-    std::pair<std::vector<cv::Rect>, std::vector<int>> pair = std::make_pair(boxes, indices);
+    if (format == DetectorFormat::Darknet) {
+        decodeRegionRows(output, frameSize);
+    } else if (output.rows >= output.cols) {
+        decodeAnchorRows(output, frameSize, inputSize);
+    } else {
+        decodeChannels(output, frameSize, inputSize);
+    }
+}
 
-    return pair;
+// Darknet region layers. Row: center x, center y, width, height (relative), objectness, class scores (already multiplied by objectness).
+// A row is a person if the person score (class 0) is above the threshold and no other class scores higher
+void HumanDetector::decodeRegionRows(const cv::Mat& output, const cv::Size& frameSize) {
+    if (output.cols <= 5) {
+        return;
+    }
+
+    const int stride = output.cols;
+    const float* row = output.ptr<float>();
+    for (int i = 0; i < output.rows; ++i, row += stride)
+    {
+        if (row[4] <= confidenceThreshold || row[5] <= confidenceThreshold) {
+            continue; // most rows end here, without reading class scores
+        }
+        float confidence = row[5];
+        if (stride > 6 && *std::max_element(row + 6, row + stride) > confidence) {
+            continue; // another class is more likely
+        }
+
+        // we return only these values in order to draw rectangles;
+        // the bottom center for position estimation will be calculated later
+        addPerson(row[0] * frameSize.width, row[1] * frameSize.height, row[2] * frameSize.width, row[3] * frameSize.height, confidence);
+    }
+}
+
+// YOLOv5-like ONNX (N x (5 + classes)). Row: center x, center y, width, height (input pixels), objectness, class scores.
+// Person score = objectness * class score, so rows with low objectness are rejected first
+void HumanDetector::decodeAnchorRows(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize) {
+    if (output.cols <= 5) {
+        return;
+    }
+
+    const float scaleX = static_cast<float>(frameSize.width) / inputSize.width;
+    const float scaleY = static_cast<float>(frameSize.height) / inputSize.height;
+    const int stride = output.cols;
+    const float* row = output.ptr<float>();
+    for (int i = 0; i < output.rows; ++i, row += stride)
+    {
+        if (row[4] <= confidenceThreshold) {
+            continue;
+        }
+        float confidence = row[4] * row[5];
+        if (confidence <= confidenceThreshold) {
+            continue;
+        }
+        if (stride > 6 && *std::max_element(row + 6, row + stride) > row[5]) {
+            continue;
+        }
+
+        addPerson(row[0] * scaleX, row[1] * scaleY, row[2] * scaleX, row[3] * scaleY, confidence);
+    }
+}
+
+// YOLOv8-like ONNX ((4 + classes) x N, no objectness). Row c holds value c of every box: the person scores (row 4)
+// are contiguous and scanned first; coordinates and other classes are read only for the remaining boxes
+void HumanDetector::decodeChannels(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize) {
+    if (output.rows <= 4) {
+        return;
+    }
+
+    const float scaleX = static_cast<float>(frameSize.width) / inputSize.width;
+    const float scaleY = static_cast<float>(frameSize.height) / inputSize.height;
+    const int boxCount = output.cols;
+    const float* personScores = output.ptr<float>(4);
+    for (int i = 0; i < boxCount; ++i)
+    {
+        float confidence = personScores[i];
+        if (confidence <= confidenceThreshold) {
+            continue;
+        }
+        bool isPerson = true;
+        for (int c = 5; c < output.rows && isPerson; ++c) {
+            isPerson = output.at<float>(c, i) <= confidence;
+        }
+        if (!isPerson) {
+            continue;
+        }
+
+        addPerson(output.at<float>(0, i) * scaleX, output.at<float>(1, i) * scaleY, output.at<float>(2, i) * scaleX, output.at<float>(3, i) * scaleY, confidence);
+    }
+}
+
+void HumanDetector::addPerson(float centerX, float centerY, float width, float height, float confidence) {
+    confidences.push_back(confidence);
+    boxes.emplace_back(static_cast<int>(centerX - width / 2), static_cast<int>(centerY - height / 2), static_cast<int>(width), static_cast<int>(height));
+}
+
+// Thresholds are part of the detection cache key (detections depend on them)
+float HumanDetector::getConfidenceThreshold() const {
+    return confidenceThreshold;
+}
+
+float HumanDetector::getNMSThreshold() const {
+    return nmsThreshold;
 }
 
 // Safety check. If weights are not loaded. The GUI will alert the user and request to load.
 bool HumanDetector::isInitialized() const {
     return _isInitialized;
 }
+
+// Blob + forward pass
+double HumanDetector::getAverageInferenceTime() const {
+    return timedFrames > 0 ? inferenceTime / timedFrames : 0.0;
+}
+
+double HumanDetector::getAverageBlobTime() const {
+    return timedFrames > 0 ? blobTime / timedFrames : 0.0;
+}
+
+double HumanDetector::getAverageForwardTime() const {
+    return timedFrames > 0 ? (inferenceTime - blobTime) / timedFrames : 0.0;
+}
+
+double HumanDetector::getAveragePostprocessingTime() const {
+    return timedFrames > 0 ? postprocessingTime / timedFrames : 0.0;
+}
+
+void HumanDetector::resetTiming() {
+    blobTime = 0.0;
+    inferenceTime = 0.0;
+    postprocessingTime = 0.0;
+    timedFrames = 0;
+}
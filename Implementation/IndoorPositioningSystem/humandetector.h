@@ -2,16 +2,25 @@
 #define HUMANDETECTOR_H
 
 /*********************************************** Human Detector ************************************************
- * YOLOv4 Human (People) detector
- * requires:
- *  - yolov4-tiny.cfg - or any other
- *  - yolov4-tiny.weights - or any other
+ * YOLO Human (People) detector
+ * requires (see DetectorConfig):
+ *  - yolov4-tiny.cfg + yolov4-tiny.weights - or any other Darknet model
+ *  - or an ONNX model of a newer YOLO (YOLOv5 / YOLOv8 export)
  *  * they are loaded though the GUI by the user!!!
+ * Runs on the CPU in fp32, fp16 or int8 (a quantized ONNX model, or quantized when loaded from calibration frames).
+ * Every output format is decoded into the same result: person boxes in frame pixels + person scores, then NMS.
+ * Output layers are resolved once when the network is loaded. Only people are decoded: rows are rejected by objectness
+ * first (person score <= objectness), class scores are read only for the remaining rows.
+ * Several frames can be detected in one forward pass (batch); the batch size giving the most frames per second
+ * is measured once per input size (tuneBatchSize).
+ * Buffers are kept between frames. Inference and post-processing times are measured (getAverage*Time).
 ****************************************************************************************************************/
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 
+#include "detectorconfig.h"
+
 class HumanDetector
 {
 public:
@@ -19,12 +28,50 @@ public:
     ~HumanDetector();
 
     void initHumanDetection(const std::string &modelConfiguration, const std::string &modelWeights);
+    void initHumanDetection(const std::vector<uchar>& modelConfiguration, const std::vector<uchar>& modelWeights);
+    void initHumanDetection(const DetectorConfig& config, const std::vector<uchar>& modelConfiguration, const std::vector<uchar>& model, const cv::Mat& calibrationBlob = cv::Mat());
+    static cv::Mat readCalibrationBlob(const std::string& folder, const cv::Size& detectionFrameSize); // int8 of a float model
     bool isInitialized() const;
     std::pair<std::vector<cv::Rect>, std::vector<int>> detectPeople(const cv::Mat &frame, const cv::Size& detectionFrameSize);
+    std::vector<std::pair<std::vector<cv::Rect>, std::vector<int>>> detectPeople(const std::vector<cv::Mat>& frames, const cv::Size& detectionFrameSize);
+    int tuneBatchSize(const cv::Size& detectionFrameSize, int maxBatchSize = 8);
+    float getConfidenceThreshold() const;
+    float getNMSThreshold() const;
+    double getAverageInferenceTime() const; // ms per frame (blob + forward pass)
+    double getAverageBlobTime() const; // ms per frame
+    double getAverageForwardTime() const; // ms per frame
+    double getAveragePostprocessingTime() const; // ms per frame (decoding + NMS)
+    void resetTiming();
 
 private:
     cv::dnn::Net net;
     bool _isInitialized; // safety check
+    float confidenceThreshold, nmsThreshold;
+    DetectorFormat format;
+    std::vector<std::string> outputNames;
+
+    // Reused between frames
+    cv::Mat blob;
+    std::vector<cv::Mat> outputs;
+    std::vector<cv::Rect> boxes;
+    std::vector<float> confidences;
+    std::vector<int> indices;
+
+    // Timing (ms)
+    double blobTime, inferenceTime, postprocessingTime;
+    int timedFrames;
+
+    cv::Size tunedFrameSize;
+    int tunedBatchSize;
+    bool isBatchSupported; // ONNX models are often exported for one frame per forward pass
+
+    void configureNet(DetectorPrecision precision = DetectorPrecision::FP32, const cv::Mat& calibrationBlob = cv::Mat());
+    void decodePeople(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize);
+    void decodeRegionRows(const cv::Mat& output, const cv::Size& frameSize);
+    void decodeAnchorRows(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize);
+    void decodeChannels(const cv::Mat& output, const cv::Size& frameSize, const cv::Size& inputSize);
+    void addPerson(float centerX, float centerY, float width, float height, float confidence);
+    static cv::Mat getFrameOutput(const cv::Mat& output, int frameIndex, int batchSize);
 };
 
 #endif // HUMANDETECTOR_H
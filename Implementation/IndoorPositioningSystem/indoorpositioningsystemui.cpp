@@ -33,6 +33,11 @@ IndoorPositioningSystemUI::IndoorPositioningSystemUI(QWidget *parent)
     connect(viewModel.get(), &IndoorPositioningSystemViewModel::requestChangePredictionButtonName, this, &IndoorPositioningSystemUI::onChangePredictionButtonName);
     connect(viewModel.get(), &IndoorPositioningSystemViewModel::humanDetectorNotInitialized, this, &IndoorPositioningSystemUI::onHumanDetectorNotInitialized);
     connect(viewModel.get(), &IndoorPositioningSystemViewModel::distCoeffsLoaded, this, &IndoorPositioningSystemUI::onDistCoeffsLoaded);
+    connect(viewModel.get(), &IndoorPositioningSystemViewModel::playbackQualityChanged, this, &IndoorPositioningSystemUI::onPlaybackQualityChanged);
+
+    // Current playback quality (lowered when the video cannot be processed in real time)
+    playbackQualityLabel = new QLabel("Playback quality: full", this);
+    ui->statusbar->addPermanentWidget(playbackQualityLabel);
 
     // make all buttons diabled when no video is opened
     ui->pushButton_Play_Pause->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
@@ -276,10 +281,9 @@ void IndoorPositioningSystemUI::onUWBDataUpdated(UWBData tag)
     }
 }
 
-// Video data
+// Video data. The frame is scaled before it is converted to a pixmap (only the smaller image is converted, the temporary is moved)
 void IndoorPositioningSystemUI::onDataUpdated(const QImage &image, int frameID, const QString &timestamp){
-    qPixmap = QPixmap::fromImage(image);
-    qPixmap = qPixmap.scaled(ui->label_Video->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    qPixmap = QPixmap::fromImage(image.scaled(ui->label_Video->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
 
     ui->label_Video->setPixmap(qPixmap);
     ui->label_Video_Frame_ID_value->setNum(frameID);
@@ -304,6 +308,11 @@ void IndoorPositioningSystemUI::onShowWarning(const QString& header, const QStri
     QMessageBox::warning(this, header, message);
 }
 
+void IndoorPositioningSystemUI::onPlaybackQualityChanged(const QString& description, bool isReduced) {
+    playbackQualityLabel->setText(description);
+    playbackQualityLabel->setStyleSheet(isReduced ? "color: #b35900;" : "");
+}
+
 // Not necessary. As video starts plying from the beginning
 void IndoorPositioningSystemUI::onFinishedVideoProcessing() {
     QMessageBox::information(this, "Finish", "Video processing has completed successfully.");
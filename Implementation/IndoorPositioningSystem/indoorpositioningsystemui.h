@@ -23,6 +23,7 @@
 #include <QFileDialog>
 #include <QException>
 #include <QProgressDialog>
+#include <QLabel>
 
 #include "structures.h"
 #include "dataanalysiswindow.h"
@@ -67,6 +68,7 @@ private slots:
     void onPositionUpdated(const QString& currentTime);
     void onDurationUpdated(int frameID, long long currentTimeInMSeconds);
     void onShowWarning(const QString& header, const QString& message);
+    void onPlaybackQualityChanged(const QString& description, bool isReduced);
     void onFinishedVideoProcessing();
 
     // Handle export
@@ -107,6 +109,7 @@ private:
     std::unique_ptr<AnchorInputWindow> anchorInputWindow;
 
     QProgressDialog* exportProgressDialog;
+    QLabel* playbackQualityLabel; // status bar
 
     void loadPixelToRealModelParams();
     void loadIntrinsicCalibrationParams();
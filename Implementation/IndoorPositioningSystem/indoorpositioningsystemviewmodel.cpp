@@ -12,6 +12,7 @@ IndoorPositioningSystemViewModel::IndoorPositioningSystemViewModel(QObject *pare
     // Timer is used to handle fps of video player
     frameTimer = new QTimer(this);
     frameTimer->setInterval(60); // corresponds to 17 fps at which videos are recorded
+    videoProcessor->setFrameBudget(frameTimer->interval()); // playback quality is lowered when frames are not ready in time
 
     isVideoOpened = false;
     toPredictByPixelToReal = false;
@@ -26,6 +27,7 @@ IndoorPositioningSystemViewModel::IndoorPositioningSystemViewModel(QObject *pare
     connect(videoProcessor.get(), &VideoProcessor::exportFinished, this, &IndoorPositioningSystemViewModel::onExportFinished, Qt::BlockingQueuedConnection);
     connect(videoProcessor.get(), &VideoProcessor::humanDetectorNotInitialized, this, &IndoorPositioningSystemViewModel::onHumanDetectorNotInitialized);
     connect(videoProcessor.get(), &VideoProcessor::distCoeffLoaded, this, &IndoorPositioningSystemViewModel::onDistCoeffsLoaded);
+    connect(videoProcessor.get(), &VideoProcessor::qualityLevelChanged, this, &IndoorPositioningSystemViewModel::onQualityLevelChanged);
 
     connect(dataProcessor.get(), &DataProcessor::exportProgressUpdated, this, &IndoorPositioningSystemViewModel::onExportProgressUpdated);
     connect(dataProcessor.get(), &DataProcessor::requestChangePredictionButtonName, this, &IndoorPositioningSystemViewModel::onChangePredictionButtonName);
@@ -212,51 +214,26 @@ void IndoorPositioningSystemViewModel::onDistCoeffsLoaded() {
     emit distCoeffsLoaded();
 }
 
-void IndoorPositioningSystemViewModel::loadHumanDetectorWeights(const QString& directory) {
-    bool missingFile = false;
-    std::string configFileName, weightsFileName;
-    QStringList missingFiles;
-
-    if (!directory.isEmpty()) {
-        QDir qDirectory(directory);
-
-        QStringList configFilter;
-        configFilter << "*.cfg";
-        QStringList configFiles = qDirectory.entryList(configFilter, QDir::Files);
-
-        if (configFiles.isEmpty()) {
-            missingFiles << "configuration file (*.cfg)";
-            missingFile = true;
-        } else if (configFiles.size() > 1){
-            emit showWarning("Failed to load", "More than one configuration file found.");
-            return;
-        } else {
-            configFileName = qDirectory.filePath(configFiles.first()).toStdString();
-        }
-
-        QStringList weightsFilter;
-        weightsFilter << "*.weights";
-        QStringList weightsFiles = qDirectory.entryList(weightsFilter, QDir::Files);
+void IndoorPositioningSystemViewModel::onQualityLevelChanged(int level, const QString& name) {
+    QString description = level == 0 ? QString("Playback quality: full") : QString("Playback quality: reduced (%1)").arg(name);
+    emit playbackQualityChanged(description, level != 0);
+}
 
-        if (weightsFiles.isEmpty()) {
-            missingFiles << "weights file (*.weights)";
-            missingFile = true;
-        } else if (weightsFiles.size() > 1){
-            emit showWarning("Failed to load", "More than one weights file found.");
-            return;
-        } else {
-            weightsFileName = qDirectory.filePath(weightsFiles.first()).toStdString();
-        }
+// detector.yml of the folder (format, precision, thresholds), otherwise one *.cfg + one *.weights (Darknet) or one *.onnx
+void IndoorPositioningSystemViewModel::loadHumanDetectorWeights(const QString& directory) {
+    if (directory.isEmpty()) {
+        return;
     }
 
-    if (missingFile) {
-        QString message = "Missing required files: " + missingFiles.join(", ");
-        emit showWarning("Failed to load", message);
-    } else {
-        videoProcessor->initHumanDetector(configFileName, weightsFileName);
-        emit weightsLoaded(true, "Weights are successfully loaded!");
+    DetectorConfig config;
+    std::string error;
+    if (!DetectorConfig::fromFolder(directory.toStdString(), config, error)) {
+        emit showWarning("Failed to load", QString::fromStdString(error));
+        return;
     }
 
+    videoProcessor->initHumanDetector(config);
+    emit weightsLoaded(true, "Weights are successfully loaded!");
 }
 
 // ---------------------------------- Display frames ---------------------------------------------------------------
@@ -298,19 +275,21 @@ void IndoorPositioningSystemViewModel::updateDataDisplay(const UWBVideoData& dat
             emit updateTagPosition(tag.coordinates, tag.tagID);
         }
 
-        if (data.pixelToRealCoordinates.size()) {
-            int i = 1;
-            for (const QPointF& coordinates: data.pixelToRealCoordinates) {
-                emit updatePixelToRealPosition(coordinates, i);
-                i++;
+        // People are shown under the ID of their paired tag (next to the tag's coordinates). Unpaired people are not shown,
+        // unless people were not paired at all (no tags): then by detection order
+        auto objectID = [&data](size_t i) {
+            return data.personTagIDs.empty() || data.uwbData.empty() ? static_cast<int>(i) + 1 : data.personTagIDs[i];
+        };
+
+        for (size_t i = 0; i < data.pixelToRealCoordinates.size(); ++i) {
+            if (objectID(i) >= 0) {
+                emit updatePixelToRealPosition(data.pixelToRealCoordinates[i], objectID(i));
             }
         }
 
-        if (data.opticalCoordinates.size()) {
-            int i = 1;
-            for (const QPointF& coordinates: data.opticalCoordinates) {
-                emit updateOpticalPosition(coordinates, i);
-                i++;
+        for (size_t i = 0; i < data.opticalCoordinates.size(); ++i) {
+            if (objectID(i) >= 0) {
+                emit updateOpticalPosition(data.opticalCoordinates[i], objectID(i));
             }
         }
 
@@ -328,6 +307,7 @@ void IndoorPositioningSystemViewModel::onStartTimer() {
 
     int totalFrames = dataProcessor->getTotalFrames();
     dataProcessor->setAnchorPositions(anchorPositions);
+    videoProcessor->updateDetectionROI(); // floor area bounded by the anchors
     isVideoOpened = true;
     _isPlaying = true;
     isExportState = false;
@@ -75,6 +75,7 @@ public slots:
     void onChangePredictionButtonName(PredictionType type, bool isPredictionRequested);
     void onHumanDetectorNotInitialized();
     void onDistCoeffsLoaded();
+    void onQualityLevelChanged(int level, const QString& name);
 
     // DataAnalysisWindow
     void setRangeForDataAnalysis(const long long startTimeSec, const long long endTimeSec);
@@ -98,6 +99,7 @@ signals:
     void modelParamsLoaded(bool success, const QString& message);
     void intrinsicCalibrationParamsLoaded(bool success, const QString& message);
     void distCoeffsLoaded();
+    void playbackQualityChanged(const QString& description, bool isReduced);
     void weightsLoaded(bool success, const QString& message);
     void modelNotLoaded(PredictionType type);
     void humanDetectorNotInitialized();
@@ -0,0 +1,55 @@
+#include "motiongate.h"
+
+#include <algorithm>
+
+static const int THUMBNAIL_WIDTH = 160; // pixels
+static const double PIXEL_THRESHOLD = 12.0; // gray levels
+static const double MOTION_FRACTION = 0.001; // of the thumbnail (a moving arm of a person far from the camera)
+static const int MAX_STILL_FRAMES = 150; // frames; people entering the ROI slowly are still detected
+
+MotionGate::MotionGate(): stillFrames(0) {}
+
+void MotionGate::reset() {
+    reference.release();
+    stillFrames = 0;
+}
+
+void MotionGate::setReference(const cv::Mat& frame, const cv::Rect2d& roi) {
+    makeThumbnail(frame, roi, reference);
+    referenceROI = roi;
+    stillFrames = 0;
+}
+
+bool MotionGate::isStill(const cv::Mat& frame, const cv::Rect2d& roi) {
+    if (reference.empty() || roi != referenceROI || stillFrames >= MAX_STILL_FRAMES) {
+        return false;
+    }
+
+    makeThumbnail(frame, roi, thumbnail);
+    if (thumbnail.size() != reference.size()) {
+        return false;
+    }
+    cv::absdiff(thumbnail, reference, difference);
+    int changedPixels = cv::countNonZero(difference > PIXEL_THRESHOLD);
+    if (changedPixels > MOTION_FRACTION * difference.total()) {
+        return false;
+    }
+
+    ++stillFrames;
+    return true;
+}
+
+// Area averaging of the ROI in colour, then gray (conversion of the thumbnail only)
+void MotionGate::makeThumbnail(const cv::Mat& frame, const cv::Rect2d& roi, cv::Mat& result) {
+    cv::Rect region(cvRound(roi.x * frame.cols), cvRound(roi.y * frame.rows), cvRound(roi.width * frame.cols), cvRound(roi.height * frame.rows));
+    region &= cv::Rect(0, 0, frame.cols, frame.rows);
+    if (region.empty()) {
+        region = cv::Rect(0, 0, frame.cols, frame.rows);
+    }
+
+    int width = std::min(THUMBNAIL_WIDTH, region.width);
+    int height = std::max(1, cvRound(static_cast<double>(region.height) * width / region.width));
+    cv::Mat small;
+    cv::resize(frame(region), small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, result, cv::COLOR_BGR2GRAY);
+}
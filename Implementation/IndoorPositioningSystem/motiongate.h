@@ -0,0 +1,35 @@
+#ifndef MOTIONGATE_H
+#define MOTIONGATE_H
+
+/*********************************************** Motion Gate ************************************************************
+ * Tells whether the detection ROI of a frame changed since the last detected frame (reference), so that detection
+ * can be skipped while people stand still (e.g. standing periods of calibration sessions):
+ *  - the ROI is reduced to a small gray thumbnail (THUMBNAIL_WIDTH, area averaging removes most of the noise)
+ *  - pixels differing from the reference by more than PIXEL_THRESHOLD are counted; more than MOTION_FRACTION
+ *    of the thumbnail is motion
+ * The reference is the last detected frame (not the previous frame), so slow movement adds up and is noticed.
+ * Detection is forced after MAX_STILL_FRAMES frames without it.
+ *
+ * Not thread-safe: frames must come in order (decode thread of Video Processor).
+*************************************************************************************************************************/
+
+#include <opencv2/opencv.hpp>
+
+class MotionGate
+{
+public:
+    MotionGate();
+
+    void reset(); // seek, flush: nothing to compare with
+    void setReference(const cv::Mat& frame, const cv::Rect2d& roi); // the frame is detected
+    bool isStill(const cv::Mat& frame, const cv::Rect2d& roi); // false without a reference
+
+private:
+    cv::Mat reference, thumbnail, difference;
+    cv::Rect2d referenceROI;
+    int stillFrames;
+
+    void makeThumbnail(const cv::Mat& frame, const cv::Rect2d& roi, cv::Mat& result);
+};
+
+#endif // MOTIONGATE_H
@@ -0,0 +1,176 @@
+#include "persontracker.h"
+
+#include <algorithm>
+#include <tuple>
+
+static const double MIN_IOU = 0.3; // detection <-> track
+static const int MAX_MISSED_DETECTIONS = 2; // detected frames without the person before the track is removed
+static const double MIN_MATCH_SCORE = 0.5; // template matching (normalized correlation)
+static const double TEMPLATE_HEIGHT = 32.0; // pixels; templates are matched at reduced resolution
+
+PersonTracker::PersonTracker(): nextTrackID(1), isDetectionNeeded_(false) {}
+
+void PersonTracker::reset() {
+    tracks.clear();
+    isDetectionNeeded_ = false;
+}
+
+bool PersonTracker::isDetectionNeeded() const {
+    return isDetectionNeeded_;
+}
+
+//-------------------------------- Detected frame --------------------------------
+void PersonTracker::update(std::vector<DetectionResult>& detections, const cv::Mat& trackingImage) {
+    std::vector<cv::Rect> predicted;
+    for (Track& track : tracks) {
+        predicted.push_back(toBox(track.filter.predict()));
+    }
+
+    // Greedy association, the best overlapping pairs first
+    std::vector<std::tuple<double, size_t, size_t>> pairs;
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        for (size_t d = 0; d < detections.size(); ++d) {
+            double intersection = (predicted[t] & detections[d].bbox).area();
+            double iou = intersection / (predicted[t].area() + detections[d].bbox.area() - intersection + 1e-9);
+            if (iou >= MIN_IOU) {
+                pairs.emplace_back(iou, t, d);
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+
+    std::vector<bool> isTrackMatched(tracks.size(), false), isDetectionMatched(detections.size(), false);
+    for (const auto& [iou, t, d] : pairs) {
+        if (isTrackMatched[t] || isDetectionMatched[d]) continue;
+        isTrackMatched[t] = isDetectionMatched[d] = true;
+
+        Track& track = tracks[t];
+        track.filter.correct(toMeasurement(detections[d].bbox));
+        track.missedDetections = 0;
+        track.isLost = false;
+        updateTemplate(track, detections[d].bbox, trackingImage);
+        detections[d].trackID = track.id;
+    }
+
+    // Tracks of people who left are removed; new people get new tracks
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        if (!isTrackMatched[t]) {
+            tracks[t].missedDetections++;
+            tracks[t].isLost = true;
+        }
+    }
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [](const Track& track) { return track.missedDetections > MAX_MISSED_DETECTIONS; }), tracks.end());
+
+    for (size_t d = 0; d < detections.size(); ++d) {
+        if (isDetectionMatched[d]) continue;
+        tracks.emplace_back();
+        Track& track = tracks.back();
+        track.id = nextTrackID++;
+        initTrack(track, detections[d].bbox);
+        updateTemplate(track, detections[d].bbox, trackingImage);
+        detections[d].trackID = track.id;
+    }
+
+    isDetectionNeeded_ = false;
+}
+
+//-------------------------------- Frame in between --------------------------------
+std::vector<DetectionResult> PersonTracker::predict(const cv::Mat& trackingImage) {
+    std::vector<DetectionResult> results;
+    cv::Rect imageRect(0, 0, trackingImage.cols, trackingImage.rows);
+
+    for (Track& track : tracks) {
+        cv::Rect box = toBox(track.filter.predict());
+        cv::Rect refined;
+        if (!track.isLost && refine(track, box, trackingImage, refined)) {
+            track.filter.correct(toMeasurement(refined));
+            box = refined;
+        } else {
+            track.isLost = true; // the prediction is used until the next detection
+            isDetectionNeeded_ = true;
+        }
+
+        box &= imageRect;
+        if (box.area() > 0) {
+            results.emplace_back(QPoint(box.x + box.width / 2, box.y + box.height), box, track.id);
+        }
+    }
+
+    return results;
+}
+
+//-------------------------------- Kalman filter and templates --------------------------------
+// State: center x, center y, width, height and their velocities (per frame). Measurement: center x, center y, width, height
+void PersonTracker::initTrack(Track& track, const cv::Rect& box) {
+    track.filter.init(8, 4, 0, CV_32F);
+    cv::setIdentity(track.filter.transitionMatrix);
+    for (int i = 0; i < 4; ++i) {
+        track.filter.transitionMatrix.at<float>(i, i + 4) = 1.0f;
+    }
+    cv::setIdentity(track.filter.measurementMatrix);
+    cv::setIdentity(track.filter.processNoiseCov, cv::Scalar::all(1.0));
+    for (int i = 4; i < 8; ++i) {
+        track.filter.processNoiseCov.at<float>(i, i) = 0.25f;
+    }
+    cv::setIdentity(track.filter.measurementNoiseCov, cv::Scalar::all(4.0));
+    cv::setIdentity(track.filter.errorCovPost, cv::Scalar::all(10.0));
+
+    track.filter.statePost = cv::Mat::zeros(8, 1, CV_32F);
+    toMeasurement(box).copyTo(track.filter.statePost.rowRange(0, 4));
+    track.missedDetections = 0;
+    track.isLost = false;
+}
+
+void PersonTracker::updateTemplate(Track& track, const cv::Rect& box, const cv::Mat& trackingImage) {
+    cv::Rect patch = box & cv::Rect(0, 0, trackingImage.cols, trackingImage.rows);
+    if (patch.width < 4 || patch.height < 4) {
+        track.personTemplate.release();
+        return;
+    }
+
+    track.templateScale = std::min(1.0, TEMPLATE_HEIGHT / patch.height);
+    cv::resize(trackingImage(patch), track.personTemplate, cv::Size(), track.templateScale, track.templateScale, cv::INTER_AREA);
+}
+
+// The template is searched around the prediction (half of the width and a quarter of the height in each direction)
+bool PersonTracker::refine(const Track& track, const cv::Rect& predicted, const cv::Mat& trackingImage, cv::Rect& refined) const {
+    if (track.personTemplate.empty() || predicted.area() <= 0) {
+        return false;
+    }
+
+    cv::Rect window(predicted.x - predicted.width / 2, predicted.y - predicted.height / 4, predicted.width * 2, predicted.height * 3 / 2);
+    window &= cv::Rect(0, 0, trackingImage.cols, trackingImage.rows);
+    if (window.width * track.templateScale < 1 || window.height * track.templateScale < 1) {
+        return false; // the prediction drifted out of the frame
+    }
+
+    cv::Mat searchArea, scores;
+    cv::resize(trackingImage(window), searchArea, cv::Size(), track.templateScale, track.templateScale, cv::INTER_AREA);
+    if (searchArea.cols < track.personTemplate.cols || searchArea.rows < track.personTemplate.rows) {
+        return false;
+    }
+
+    cv::matchTemplate(searchArea, track.personTemplate, scores, cv::TM_CCOEFF_NORMED);
+    double score;
+    cv::Point location;
+    cv::minMaxLoc(scores, nullptr, &score, nullptr, &location);
+    if (score < MIN_MATCH_SCORE) {
+        return false;
+    }
+
+    // Center of the match; the size is given by the filter
+    double centerX = window.x + (location.x + track.personTemplate.cols / 2.0) / track.templateScale;
+    double centerY = window.y + (location.y + track.personTemplate.rows / 2.0) / track.templateScale;
+    refined = cv::Rect(cvRound(centerX - predicted.width / 2.0), cvRound(centerY - predicted.height / 2.0), predicted.width, predicted.height);
+
+    return true;
+}
+
+cv::Rect PersonTracker::toBox(const cv::Mat& state) {
+    float width = std::max(1.0f, state.at<float>(2)), height = std::max(1.0f, state.at<float>(3));
+    return cv::Rect(cvRound(state.at<float>(0) - width / 2), cvRound(state.at<float>(1) - height / 2), cvRound(width), cvRound(height));
+}
+
+cv::Mat PersonTracker::toMeasurement(const cv::Rect& box) {
+    return (cv::Mat_<float>(4, 1) << box.x + box.width / 2.0f, box.y + box.height / 2.0f, static_cast<float>(box.width), static_cast<float>(box.height));
+}
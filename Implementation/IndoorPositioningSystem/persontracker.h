@@ -0,0 +1,54 @@
+#ifndef PERSONTRACKER_H
+#define PERSONTRACKER_H
+
+/*********************************************** Person Tracker *********************************************************
+ * Tracking by detection between the Human Detector and Data Processor, so that the detector runs only every K-th frame:
+ *  - detected frame (update): boxes are associated with the tracks (IoU); matched tracks are corrected, new tracks
+ *    are created for new people, tracks without detection are removed after a few detected frames
+ *  - frame in between (predict): every box is propagated by a Kalman filter (constant velocity of the center and size)
+ *    and refined locally by template matching (the person's patch from the last detection, searched around the prediction
+ *    at reduced resolution)
+ * Every person gets a stable ID (DetectionResult::trackID). If a track cannot be refined (occlusion, sudden movement),
+ * a detection is requested before the K-th frame.
+ *
+ * Boxes are in the detection frame; the tracking image is the frame (gray) at the detection frame size.
+ * Not thread-safe: frames must come in order (sync stage of the Playback Pipeline).
+*************************************************************************************************************************/
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "structures.h"
+
+class PersonTracker
+{
+public:
+    PersonTracker();
+
+    void reset();
+    void update(std::vector<DetectionResult>& detections, const cv::Mat& trackingImage); // assigns trackIDs
+    std::vector<DetectionResult> predict(const cv::Mat& trackingImage);
+    bool isDetectionNeeded() const; // a track was lost since the last detection
+
+private:
+    struct Track {
+        int id;
+        cv::KalmanFilter filter;
+        cv::Mat personTemplate; // reduced resolution
+        double templateScale;
+        int missedDetections;
+        bool isLost;
+    };
+
+    std::vector<Track> tracks;
+    int nextTrackID;
+    bool isDetectionNeeded_;
+
+    void initTrack(Track& track, const cv::Rect& box);
+    void updateTemplate(Track& track, const cv::Rect& box, const cv::Mat& trackingImage);
+    bool refine(const Track& track, const cv::Rect& predicted, const cv::Mat& trackingImage, cv::Rect& refined) const;
+    static cv::Rect toBox(const cv::Mat& state);
+    static cv::Mat toMeasurement(const cv::Rect& box);
+};
+
+#endif // PERSONTRACKER_H
@@ -0,0 +1,178 @@
+#include "playbackpipeline.h"
+
+#include <algorithm>
+#include <iostream>
+
+// Window: frames decoded but not yet synchronized. Two frames per worker keep all workers busy.
+PlaybackPipeline::PlaybackPipeline(ThreadSafeQueue& frameQueue, int workerCount):
+    frameQueue(frameQueue)
+    , workerCount(std::max(1, workerCount))
+    , windowSize(static_cast<size_t>(2 * std::max(1, workerCount)))
+    , inputQueue(static_cast<size_t>(2 * std::max(1, workerCount)))
+    , nextSequence(0)
+    , nextSequenceToSync(0)
+    , busyWorkers(0)
+    , generation(0)
+    , isStarted(false)
+    , isStopRequested(false)
+{}
+
+PlaybackPipeline::~PlaybackPipeline() {
+    stop();
+}
+
+void PlaybackPipeline::start(ProcessFunction process, SyncFunction sync) {
+    if (isStarted) {
+        return;
+    }
+    this->process = std::move(process);
+    this->sync = std::move(sync);
+
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&PlaybackPipeline::workerLoop, this, i);
+    }
+    syncThread = std::thread(&PlaybackPipeline::syncLoop, this);
+    isStarted = true;
+}
+
+void PlaybackPipeline::stop() {
+    if (!isStarted || isStopRequested.exchange(true)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        generation++;
+        windowCondition.notify_all();
+        reorderCondition.notify_all();
+    }
+    inputQueue.close();
+    frameQueue.clear(); // wakes the sync stage if it waits for space in the queue
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    syncThread.join();
+}
+
+int PlaybackPipeline::getWorkerCount() const {
+    return workerCount;
+}
+
+//-------------------------------- Decode stage (caller thread) --------------------------------
+bool PlaybackPipeline::submit(PlaybackFrame&& frame, const std::function<bool()>& isInterrupted) {
+    Task task;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto isWindowFull = [this] { return nextSequence - nextSequenceToSync >= windowSize; };
+        windowCondition.wait(lock, [&] { return !isWindowFull() || isStopRequested || (isInterrupted && isInterrupted()); });
+        if (isStopRequested || isWindowFull()) {
+            return false;
+        }
+        task.sequence = nextSequence++;
+        task.generation = generation;
+    }
+    task.frame = std::move(frame);
+
+    return inputQueue.push(std::move(task));
+}
+
+void PlaybackPipeline::interrupt() {
+    std::lock_guard<std::mutex> lock(mtx);
+    windowCondition.notify_all();
+}
+
+bool PlaybackPipeline::isStopped() const {
+    return isStopRequested;
+}
+
+void PlaybackPipeline::flush() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        generation++;
+        reorderBuffer.clear();
+        nextSequenceToSync = nextSequence; // dropped sequence numbers are never waited for
+        windowCondition.notify_all();
+    }
+    inputQueue.clear();
+    frameQueue.clear(); // after the generation is changed, so a frame of the old generation cannot be enqueued anymore
+}
+
+void PlaybackPipeline::waitUntilIdle() {
+    std::unique_lock<std::mutex> lock(mtx);
+    idleCondition.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+//-------------------------------- Preprocess + detect stage (worker pool) --------------------------------
+void PlaybackPipeline::workerLoop(int workerIndex) {
+    Task task;
+    while (inputQueue.pop(task)) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (task.generation != generation) {
+                continue; // flushed
+            }
+            busyWorkers++;
+        }
+
+        try {
+            process(task.frame, workerIndex);
+        } catch (const std::exception& e) { // cv::Exception, or rethrown by the Detector Pool (e.g. std::bad_alloc)
+            // the frame is still passed on, otherwise the reorder buffer would wait for it forever
+            std::cerr << "Failed to process frame " << task.frame.position << ": " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Failed to process frame " << task.frame.position << ": unknown error" << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--busyWorkers == 0) {
+            idleCondition.notify_all();
+        }
+        if (task.generation == generation) {
+            reorderBuffer.emplace(task.sequence, std::move(task.frame));
+            if (task.sequence == nextSequenceToSync) {
+                reorderCondition.notify_one();
+            }
+        }
+        task.frame = PlaybackFrame(); // release the frame buffers before waiting for the next task
+    }
+}
+
+//-------------------------------- Reorder + sync stage --------------------------------
+void PlaybackPipeline::syncLoop() {
+    while (true) {
+        PlaybackFrame frame;
+        uint64_t frameGeneration;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            reorderCondition.wait(lock, [this] {
+                return isStopRequested || (!reorderBuffer.empty() && reorderBuffer.begin()->first == nextSequenceToSync);
+            });
+            if (isStopRequested) {
+                return;
+            }
+
+            auto next = reorderBuffer.begin();
+            frame = std::move(next->second);
+            reorderBuffer.erase(next);
+            nextSequenceToSync++;
+            frameGeneration = generation;
+            windowCondition.notify_one();
+        }
+
+        UWBVideoData data;
+        try {
+            data = sync(frame);
+        } catch (const std::exception& e) { // e.g. cv::Exception of the tracker
+            // the frame is skipped, later frames are still synchronized
+            std::cerr << "Failed to synchronize frame " << frame.position << ": " << e.what() << std::endl;
+            continue;
+        } catch (...) {
+            std::cerr << "Failed to synchronize frame " << frame.position << ": unknown error" << std::endl;
+            continue;
+        }
+
+        // the frame is dropped if the pipeline was flushed while waiting for space in the queue (e.g. seeking when paused)
+        frameQueue.enqueue(std::move(data), [this, frameGeneration] { return frameGeneration == generation && !isStopRequested; });
+    }
+}
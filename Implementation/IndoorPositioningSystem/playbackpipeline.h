@@ -0,0 +1,97 @@
+#ifndef PLAYBACKPIPELINE_H
+#define PLAYBACKPIPELINE_H
+
+/*********************************************** Playback Pipeline ******************************************************
+ * Staged processing of the played video, so that the stages run concurrently instead of one after another:
+ *  decode (VideoProcessor thread) -> preprocess + detect (worker pool) -> reorder buffer -> sync (UWB + coordinates) -> ThreadSafeQueue
+ *
+ *  - every submitted frame gets a sequence number; the reorder buffer releases frames to the sync stage strictly in order
+ *  - the number of frames in flight is bounded (window), so a full ThreadSafeQueue stops decoding (back-pressure)
+ *  - flush (seek, new video, prediction or calibration change) invalidates all frames in flight by a generation counter;
+ *    invalidated frames are dropped by any stage, including the one waiting for space in the ThreadSafeQueue
+ *
+ * What the stages do is given by VideoProcessor (process function per worker, sync function). Every worker has its own index,
+ * so it can own resources that must not be used from several threads at once.
+*************************************************************************************************************************/
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <QImage>
+#include <opencv2/opencv.hpp>
+
+#include "boundedqueue.h"
+#include "threadsafequeue.h"
+#include "framepreprocessor.h"
+#include "detectioncache.h"
+#include "structures.h"
+
+struct PlaybackFrame {
+    int position; // video position after the frame was read (frame ID, from 1)
+    cv::Mat frame; // decoded frame (BGR), owned by this frame
+    std::shared_ptr<const FramePreprocessor> preprocessor; // snapshot of undistortion maps valid for this frame
+    bool toDetect; // run Human Detector in the worker
+    bool toTrack; // detection skipped: people are tracked (predicted) in the sync stage
+    bool isTracking; // Person Tracker runs in the sync stage; the worker prepares trackingImage
+    bool toReuse; // nothing moved since the last detection: the previous frame's detections are used (sync stage)
+    std::shared_ptr<DetectionCache> detectionCache; // detections of the worker are stored here (cache matching the preprocessor)
+    std::vector<DetectionResult> detectionResults; // recorded detections, or filled by the worker
+    cv::Mat trackingImage; // gray frame at the detection frame size, filled by the worker if tracking
+    QImage qImage; // frame for Video Player, filled by the worker; boxes are drawn by the sync stage
+
+    PlaybackFrame(): position(0), toDetect(false), toTrack(false), isTracking(false), toReuse(false) {}
+};
+
+class PlaybackPipeline
+{
+public:
+    using ProcessFunction = std::function<void(PlaybackFrame& frame, int workerIndex)>;
+    using SyncFunction = std::function<UWBVideoData(PlaybackFrame& frame)>;
+
+    PlaybackPipeline(ThreadSafeQueue& frameQueue, int workerCount);
+    ~PlaybackPipeline();
+
+    void start(ProcessFunction process, SyncFunction sync);
+    void stop();
+
+    // Blocks while the window is full; false if the pipeline is stopped or isInterrupted became true while waiting
+    bool submit(PlaybackFrame&& frame, const std::function<bool()>& isInterrupted = nullptr);
+    void interrupt(); // isInterrupted of a waiting submit is checked again
+    bool isStopped() const;
+    void flush(); // drops all frames in flight and clears the ThreadSafeQueue
+    void waitUntilIdle(); // after flush: waits until no worker processes a frame (e.g. before workers' detectors are used elsewhere)
+    int getWorkerCount() const;
+
+private:
+    struct Task {
+        uint64_t sequence;
+        uint64_t generation;
+        PlaybackFrame frame;
+    };
+
+    ThreadSafeQueue& frameQueue;
+    int workerCount;
+    size_t windowSize;
+
+    BoundedQueue<Task> inputQueue;
+    std::vector<std::thread> workers;
+    std::thread syncThread;
+    ProcessFunction process;
+    SyncFunction sync;
+
+    std::mutex mtx;
+    std::condition_variable windowCondition, reorderCondition, idleCondition;
+    std::map<uint64_t, PlaybackFrame> reorderBuffer;
+    uint64_t nextSequence, nextSequenceToSync;
+    int busyWorkers;
+    std::atomic<uint64_t> generation;
+    std::atomic<bool> isStarted, isStopRequested;
+
+    void workerLoop(int workerIndex);
+    void syncLoop();
+};
+
+#endif // PLAYBACKPIPELINE_H
@@ -0,0 +1,164 @@
+#include "qualitycontroller.h"
+
+#include <algorithm>
+#include <iterator>
+
+static const int WINDOW_FRAMES = 17; // about a second of playback
+static const double DEGRADE_LOAD = 0.9; // of the frame budget
+static const double RESTORE_LOAD = 0.6;
+static const double MIN_QUEUED_FRAMES = 3.0; // on average in the window; more frames queued cover a slow window
+static const int RESTORE_WINDOWS = 3;
+static const int MAX_RESTORE_WINDOWS = 48;
+
+static const QualityLevel LEVELS[] = {
+    {"full", 1, 0, true},
+    {"interval x2", 2, 0, true},
+    {"input 416", 2, 416, true},
+    {"input 320", 2, 320, true},
+    {"distorted view", 2, 320, false},
+};
+
+QualityController::QualityController():
+    frameBudget(0.0)
+    , level(0)
+    , lastPosition(0)
+    , windowsAtLevel(0)
+    , headroomWindows(0)
+    , restoreHold(RESTORE_WINDOWS)
+    , isRestored(false)
+{
+    clearWindow();
+}
+
+// Full quality until enabled; disabling restores it
+void QualityController::setFrameBudget(double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    frameBudget = std::max(0.0, milliseconds);
+    if (frameBudget == 0.0) {
+        level = 0;
+    }
+    clearWindow();
+}
+
+bool QualityController::isEnabled() const {
+    return frameBudget > 0.0;
+}
+
+void QualityController::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lastPosition = 0;
+    clearWindow();
+}
+
+void QualityController::recordDecodeTime(double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    decodeTime += milliseconds;
+    ++decodeFrames;
+}
+
+void QualityController::recordWorkerTime(double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    workerTime += milliseconds;
+    ++workerFrames;
+}
+
+bool QualityController::update(int position, double syncMilliseconds, size_t queued, int workerCount, bool isDetecting) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (frameBudget == 0.0) {
+        return false;
+    }
+    if (position != lastPosition + 1) {
+        clearWindow(); // seek, flush or the video started again: the times were not measured on continuous playback
+    }
+    lastPosition = position;
+
+    syncTime += syncMilliseconds;
+    queuedFrames += static_cast<double>(queued);
+    if (++syncFrames < WINDOW_FRAMES) {
+        return false;
+    }
+
+    // The slowest stage limits the pipeline
+    double cost = syncTime / syncFrames;
+    if (decodeFrames > 0) {
+        cost = std::max(cost, decodeTime / decodeFrames);
+    }
+    if (workerFrames > 0) {
+        cost = std::max(cost, workerTime / workerFrames / std::max(1, workerCount));
+    }
+    bool isBehind = cost > DEGRADE_LOAD * frameBudget && queuedFrames / syncFrames < MIN_QUEUED_FRAMES;
+    bool hasHeadroom = cost < RESTORE_LOAD * frameBudget;
+    clearWindow();
+
+    // The first window after a change still measures frames submitted at the previous level
+    if (windowsAtLevel++ == 0) {
+        return false;
+    }
+
+    int next = level;
+    if (isBehind) {
+        headroomWindows = 0;
+        if (isRestored && windowsAtLevel <= restoreHold) {
+            restoreHold = std::min(2 * restoreHold, MAX_RESTORE_WINDOWS); // the higher level did not hold
+        }
+        next = nextLevel(true, isDetecting);
+    } else if (hasHeadroom && ++headroomWindows >= restoreHold) {
+        next = nextLevel(false, isDetecting);
+    } else if (!hasHeadroom) {
+        headroomWindows = 0;
+    }
+    if (isRestored && windowsAtLevel > restoreHold) {
+        restoreHold = RESTORE_WINDOWS; // the restored level held
+        isRestored = false;
+    }
+
+    if (next == level) {
+        return false;
+    }
+    isRestored = next < level;
+    level = next;
+    windowsAtLevel = 0;
+    headroomWindows = 0;
+    return true;
+}
+
+int QualityController::getLevel() const {
+    return level;
+}
+
+const QualityLevel& QualityController::getQualityLevel() const {
+    return LEVELS[level];
+}
+
+const QualityLevel& QualityController::getQualityLevel(int level) {
+    return LEVELS[std::clamp(level, 0, getLevelCount() - 1)];
+}
+
+int QualityController::getLevelCount() {
+    return static_cast<int>(std::size(LEVELS));
+}
+
+void QualityController::clearWindow() {
+    decodeTime = workerTime = syncTime = queuedFrames = 0.0;
+    decodeFrames = workerFrames = syncFrames = 0;
+}
+
+// Without detection the levels differing only in detection are the same: they are skipped (down), or the highest
+// quality one is chosen (up)
+int QualityController::nextLevel(bool toDegrade, bool isDetecting) const {
+    const int current = level;
+    int next = toDegrade ? current + 1 : current - 1;
+    if (!isDetecting) {
+        if (toDegrade) {
+            while (next < getLevelCount() && LEVELS[next].isDisplayUndistorted == LEVELS[current].isDisplayUndistorted) {
+                ++next;
+            }
+        } else {
+            while (next > 0 && LEVELS[next - 1].isDisplayUndistorted == LEVELS[next].isDisplayUndistorted) {
+                --next;
+            }
+        }
+    }
+
+    return next >= 0 && next < getLevelCount() ? next : current;
+}
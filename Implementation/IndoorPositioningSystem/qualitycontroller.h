@@ -0,0 +1,71 @@
+#ifndef QUALITYCONTROLLER_H
+#define QUALITYCONTROLLER_H
+
+/*********************************************** Quality Controller *****************************************************
+ * Keeps playback in real time (quality of service): when the Playback Pipeline cannot deliver a frame per Video Player
+ * tick (frame budget, e.g. 60 ms), quality is lowered step by step, and raised again when there is headroom.
+ *
+ * Measured per frame: decode (Video Processor thread), worker (undistortion + detection) and sync stage times, and the
+ * frames waiting for Video Player (ThreadSafeQueue). Every WINDOW_FRAMES frames the cost of a frame is estimated as
+ * the slowest stage (workers run in parallel, so the worker time is divided by their number):
+ *  - behind: cost above DEGRADE_LOAD of the budget while the queue is (almost) empty -> one level down
+ *  - headroom: cost below RESTORE_LOAD of the budget for restoreHold windows -> one level up. If the level has to be
+ *    lowered again soon after, restoreHold is doubled (up to MAX_RESTORE_WINDOWS), so the quality does not oscillate
+ *
+ * Levels (QualityLevel), from the full quality:
+ *  0 full            - as set (detection interval, detector input size of the model, undistorted display)
+ *  1 interval x2     - people are detected half as often (tracked in between)
+ *  2 input 416       - smaller detector input (at most 416)
+ *  3 input 320
+ *  4 distorted view  - the display frame is not undistorted (detections and the tracking image still are)
+ * Without detection only the display undistortion helps, so levels that change detection only are skipped.
+ *
+ * Thread-safe: stage times are recorded by several threads; levels are evaluated by the sync stage (frames in order).
+*************************************************************************************************************************/
+
+#include <atomic>
+#include <mutex>
+
+struct QualityLevel {
+    const char* name;
+    int detectionIntervalFactor; // the detection interval is multiplied
+    int maxInputSize; // detector input (longer side) at most; 0: as the model config
+    bool isDisplayUndistorted;
+};
+
+class QualityController
+{
+public:
+    QualityController();
+
+    void setFrameBudget(double milliseconds); // Video Player tick; 0 disables the controller (full quality)
+    bool isEnabled() const;
+    void reset(); // seek, flush, pause: measurements start again (the level is kept)
+
+    void recordDecodeTime(double milliseconds);
+    void recordWorkerTime(double milliseconds);
+    // Sync stage, one call per frame; true if the level changed
+    bool update(int position, double syncMilliseconds, size_t queuedFrames, int workerCount, bool isDetecting);
+
+    int getLevel() const;
+    const QualityLevel& getQualityLevel() const;
+    static const QualityLevel& getQualityLevel(int level);
+    static int getLevelCount();
+
+private:
+    mutable std::mutex mutex;
+    std::atomic<double> frameBudget;
+    std::atomic<int> level;
+    double decodeTime, workerTime, syncTime, queuedFrames; // sums over the window
+    int decodeFrames, workerFrames, syncFrames;
+    int lastPosition;
+    int windowsAtLevel; // since the level changed
+    int headroomWindows; // in a row
+    int restoreHold; // windows with headroom before the next level up
+    bool isRestored; // the level was raised last
+
+    void clearWindow();
+    int nextLevel(bool toDegrade, bool isDetecting) const;
+};
+
+#endif // QUALITYCONTROLLER_H
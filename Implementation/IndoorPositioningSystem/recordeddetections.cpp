@@ -0,0 +1,114 @@
+#include "recordeddetections.h"
+
+#include <fstream>
+#include <sstream>
+
+RecordedDetections::RecordedDetections(): interval(1) {}
+
+bool RecordedDetections::load(const std::string& filename) {
+    clear();
+
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line, key;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+
+        std::istringstream ss(line);
+
+        // header
+        if (line[0] == '#') {
+            ss.ignore(1);
+            ss >> key;
+            if (key == "frameSize") {
+                ss >> frameSize.width >> frameSize.height;
+            } else if (key == "interval") {
+                ss >> interval;
+            }
+            continue;
+        }
+
+        int frameID, count;
+        long long timestamp;
+        if (!(ss >> frameID >> timestamp >> count)) continue;
+
+        std::vector<cv::Rect> boxes;
+        cv::Rect bbox;
+        for (int i = 0; i < count && ss >> bbox.x >> bbox.y >> bbox.width >> bbox.height; ++i) {
+            boxes.push_back(bbox);
+        }
+        detectionsPerFrame[frameID] = std::move(boxes);
+    }
+
+    if (frameSize.empty()) { // boxes cannot be mapped without the size of the recorded frame
+        clear();
+        return false;
+    }
+
+    return !detectionsPerFrame.empty();
+}
+
+void RecordedDetections::clear() {
+    detectionsPerFrame.clear();
+    frameSize = cv::Size();
+    interval = 1;
+}
+
+bool RecordedDetections::isEmpty() const {
+    return detectionsPerFrame.empty();
+}
+
+int RecordedDetections::getInterval() const {
+    return interval;
+}
+
+bool RecordedDetections::find(int frameID, int maxDistance, std::vector<cv::Rect>& boxes) const {
+    for (int distance = 0; distance <= maxDistance; ++distance) {
+        // previous frame is preferred (the same as holding the last detection during playback)
+        for (int candidate : {frameID - distance, frameID + distance}) {
+            auto it = detectionsPerFrame.find(candidate);
+            if (it != detectionsPerFrame.end()) {
+                boxes = it->second;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<DetectionResult> RecordedDetections::toDetectionFrame(const std::vector<cv::Rect>& boxes, const cv::Size& detectionFrameSize,
+                                                                  const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Mat& optimalCameraMatrix) const {
+    std::vector<DetectionResult> detectionResults;
+    if (boxes.empty()) return detectionResults;
+
+    // Top-left and bottom-right corners of all boxes
+    std::vector<cv::Point2f> corners;
+    for (const cv::Rect& bbox : boxes) {
+        corners.emplace_back(bbox.x, bbox.y);
+        corners.emplace_back(bbox.x + bbox.width, bbox.y + bbox.height);
+    }
+
+    // The same undistortion as applied to frames in VideoProcessor
+    if (!distCoeffs.empty()) {
+        std::vector<cv::Point2f> undistortedCorners;
+        cv::undistortPoints(corners, undistortedCorners, cameraMatrix, distCoeffs, cv::noArray(), optimalCameraMatrix);
+        corners = std::move(undistortedCorners);
+    }
+
+    double scaleX = static_cast<double>(detectionFrameSize.width) / frameSize.width;
+    double scaleY = static_cast<double>(detectionFrameSize.height) / frameSize.height;
+
+    for (size_t i = 0; i < corners.size(); i += 2) {
+        cv::Point topLeft(cvRound(corners[i].x * scaleX), cvRound(corners[i].y * scaleY));
+        cv::Point bottomRight(cvRound(corners[i + 1].x * scaleX), cvRound(corners[i + 1].y * scaleY));
+        cv::Rect bbox(topLeft, bottomRight);
+
+        QPoint bottomEdgeCenter(bbox.x + (bbox.width / 2), bbox.y + bbox.height);
+        detectionResults.emplace_back(std::move(bottomEdgeCenter), std::move(bbox));
+    }
+
+    return detectionResults;
+}
@@ -0,0 +1,44 @@
+#ifndef RECORDEDDETECTIONS_H
+#define RECORDEDDETECTIONS_H
+
+/*********************************************** Recorded Detections ***************************************************
+ * People detected by the Server during recording (detections.txt, optional sidecar of the video)
+ *  # frameSize <width> <height>
+ *  # interval <n>
+ *  frameID timestamp count x y width height [x y width height ...]
+ *
+ * Bounding boxes are stored in pixels of the recorded (distorted) frame. VideoProcessor detects people in the
+ * undistorted frame resized to the detection frame size, so the boxes are mapped to the same space here.
+ * When a frame has recorded detections, VideoProcessor does not run the detector (YOLO) for it.
+************************************************************************************************************************/
+
+#include <string>
+#include <unordered_map>
+#include <opencv2/opencv.hpp>
+
+#include "structures.h"
+
+class RecordedDetections
+{
+public:
+    RecordedDetections();
+
+    bool load(const std::string& filename);
+    void clear();
+    bool isEmpty() const;
+    int getInterval() const;
+
+    // Detections of the frame, or of the nearest detected frame not further than maxDistance frames
+    bool find(int frameID, int maxDistance, std::vector<cv::Rect>& boxes) const;
+
+    // Maps boxes from the recorded frame to the (undistorted) detection frame, as returned by HumanDetector
+    std::vector<DetectionResult> toDetectionFrame(const std::vector<cv::Rect>& boxes, const cv::Size& detectionFrameSize,
+                                                  const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs, const cv::Mat& optimalCameraMatrix) const;
+
+private:
+    cv::Size frameSize;
+    int interval;
+    std::unordered_map<int, std::vector<cv::Rect>> detectionsPerFrame;
+};
+
+#endif // RECORDEDDETECTIONS_H
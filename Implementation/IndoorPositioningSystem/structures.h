@@ -148,6 +148,7 @@ struct UWBVideoData {
     std::vector<UWBData> uwbData;
     std::vector<QPointF> pixelToRealCoordinates;
     std::vector<QPointF> opticalCoordinates;
+    std::vector<int> personTagIDs; // tag paired with each detected person (Tag Association), -1 if none; empty if people were not located
 
     UWBVideoData() {}
 
@@ -155,9 +156,9 @@ struct UWBVideoData {
 
     UWBVideoData(VideoData&& videoData, std::vector<UWBData>&& uwbData, std::vector<QPointF>&& pixelToRealCoordinates, std::vector<QPointF>&& opticalCoordinates): videoData(std::move(videoData)), uwbData(std::move(uwbData)), pixelToRealCoordinates(std::move(pixelToRealCoordinates)), opticalCoordinates(std::move(opticalCoordinates)) {}
 
-    UWBVideoData(const UWBVideoData& other): videoData(other.videoData), uwbData(other.uwbData), pixelToRealCoordinates(other.pixelToRealCoordinates), opticalCoordinates(other.opticalCoordinates) {}
+    UWBVideoData(const UWBVideoData& other): videoData(other.videoData), uwbData(other.uwbData), pixelToRealCoordinates(other.pixelToRealCoordinates), opticalCoordinates(other.opticalCoordinates), personTagIDs(other.personTagIDs) {}
 
-    UWBVideoData(UWBVideoData&& other) noexcept: videoData(std::move(other.videoData)), uwbData(std::move(other.uwbData)), pixelToRealCoordinates(std::move(other.pixelToRealCoordinates)), opticalCoordinates(std::move(other.opticalCoordinates)) {}
+    UWBVideoData(UWBVideoData&& other) noexcept: videoData(std::move(other.videoData)), uwbData(std::move(other.uwbData)), pixelToRealCoordinates(std::move(other.pixelToRealCoordinates)), opticalCoordinates(std::move(other.opticalCoordinates)), personTagIDs(std::move(other.personTagIDs)) {}
 
     UWBVideoData& operator=(UWBVideoData&& other) noexcept {
         if (this != &other) {
@@ -165,6 +166,7 @@ struct UWBVideoData {
             uwbData = std::move(other.uwbData);
             pixelToRealCoordinates = std::move(other.pixelToRealCoordinates);
             opticalCoordinates = std::move(other.opticalCoordinates);
+            personTagIDs = std::move(other.personTagIDs);
         }
 
         return *this;
@@ -176,14 +178,17 @@ struct UWBVideoData {
 struct DetectionResult {
     QPoint bottomEdgeCenter;
     cv::Rect bbox;
+    int trackID; // stable ID of the person (Person Tracker), -1 if not tracked
 
-    DetectionResult(const QPoint& bottomEdgeCenter, const cv::Rect& bbox): bottomEdgeCenter(bottomEdgeCenter), bbox(bbox) {}
+    DetectionResult(const QPoint& bottomEdgeCenter, const cv::Rect& bbox, int trackID = -1): bottomEdgeCenter(bottomEdgeCenter), bbox(bbox), trackID(trackID) {}
 
-    DetectionResult(QPoint&& bottomEdgeCenter, cv::Rect&& bbox): bottomEdgeCenter(std::move(bottomEdgeCenter)), bbox(std::move(bbox)) {}
+    DetectionResult(QPoint&& bottomEdgeCenter, cv::Rect&& bbox): bottomEdgeCenter(std::move(bottomEdgeCenter)), bbox(std::move(bbox)), trackID(-1) {}
 
-    DetectionResult(const DetectionResult& other): bottomEdgeCenter(other.bottomEdgeCenter), bbox(other.bbox) {}
+    DetectionResult(const DetectionResult& other): bottomEdgeCenter(other.bottomEdgeCenter), bbox(other.bbox), trackID(other.trackID) {}
 
-    DetectionResult(DetectionResult&& other) noexcept: bottomEdgeCenter(std::move(other.bottomEdgeCenter)), bbox(std::move(other.bbox)) {}
+    DetectionResult(DetectionResult&& other) noexcept: bottomEdgeCenter(std::move(other.bottomEdgeCenter)), bbox(std::move(other.bbox)), trackID(other.trackID) {}
+
+    DetectionResult& operator=(const DetectionResult& other) = default;
 
 };
 
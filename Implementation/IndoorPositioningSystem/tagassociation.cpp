@@ -0,0 +1,150 @@
+#include "tagassociation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static const double MAX_DISTANCE = 1.5; // meters; farther tag and person are not paired
+static const double STICKINESS = 0.3; // meters; preference for the pairs of the previous frame
+static const double SAME_PERSON_DISTANCE = 0.5; // meters; without track IDs, the previous person of a tag is the one this close
+static const double GATED_COST = 1e3; // cost of pairs farther than MAX_DISTANCE (dropped after the assignment)
+
+void TagAssociation::reset() {
+    previousPairs.clear();
+}
+
+const std::vector<int>& TagAssociation::associate(const std::vector<int>& tagIDs, const std::vector<QPointF>& tagPositions,
+                                                  const std::vector<QPointF>& personPositions, const std::vector<int>& trackIDs) {
+    const int tagCount = static_cast<int>(tagPositions.size());
+    const int personCount = static_cast<int>(personPositions.size());
+    personTagIDs.assign(personCount, -1);
+    if (tagCount == 0 || personCount == 0) {
+        previousPairs.clear();
+        return personTagIDs;
+    }
+
+    // Rows are the smaller side
+    const bool areTagsRows = tagCount <= personCount;
+    const int rows = areTagsRows ? tagCount : personCount;
+    const int columns = areTagsRows ? personCount : tagCount;
+
+    costs.resize(static_cast<size_t>(rows) * columns);
+    for (int tag = 0; tag < tagCount; ++tag) {
+        auto previous = std::find_if(previousPairs.begin(), previousPairs.end(), [&](const Pair& pair) { return pair.tagID == tagIDs[tag]; });
+
+        for (int person = 0; person < personCount; ++person) {
+            double cost = std::hypot(tagPositions[tag].x() - personPositions[person].x(), tagPositions[tag].y() - personPositions[person].y());
+            if (cost > MAX_DISTANCE) {
+                cost = GATED_COST;
+            } else if (previous != previousPairs.end()) {
+                int trackID = person < static_cast<int>(trackIDs.size()) ? trackIDs[person] : -1;
+                bool isSamePerson = trackID >= 0 ? trackID == previous->trackID
+                                                 : std::hypot(previous->personPosition.x() - personPositions[person].x(), previous->personPosition.y() - personPositions[person].y()) < SAME_PERSON_DISTANCE;
+                if (isSamePerson) {
+                    cost -= STICKINESS;
+                }
+            }
+
+            int row = areTagsRows ? tag : person;
+            int column = areTagsRows ? person : tag;
+            costs[static_cast<size_t>(row) * columns + column] = cost;
+        }
+    }
+
+    if (!assignGreedily(rows, columns)) {
+        assignOptimally(rows, columns);
+    }
+
+    previousPairs.clear();
+    for (int row = 0; row < rows; ++row) {
+        int column = rowColumns[row];
+        if (costs[static_cast<size_t>(row) * columns + column] >= GATED_COST) {
+            continue; // too far: nobody to pair with
+        }
+
+        int tag = areTagsRows ? row : column;
+        int person = areTagsRows ? column : row;
+        personTagIDs[person] = tagIDs[tag];
+        previousPairs.push_back({tagIDs[tag], person < static_cast<int>(trackIDs.size()) ? trackIDs[person] : -1, personPositions[person]});
+    }
+
+    return personTagIDs;
+}
+
+// Every row takes its cheapest column. If no column is taken twice, the sum is the lower bound of any assignment, so it is optimal
+bool TagAssociation::assignGreedily(int rows, int columns) {
+    rowColumns.resize(rows);
+    isColumnUsed.assign(columns, 0);
+
+    for (int row = 0; row < rows; ++row) {
+        const double* rowCosts = &costs[static_cast<size_t>(row) * columns];
+        int column = static_cast<int>(std::min_element(rowCosts, rowCosts + columns) - rowCosts);
+        if (isColumnUsed[column]) {
+            return false;
+        }
+        isColumnUsed[column] = 1;
+        rowColumns[row] = column;
+    }
+
+    return true;
+}
+
+// Hungarian algorithm. Index 0 of columns is a virtual column (start of the augmenting path), rows and columns are shifted by 1
+void TagAssociation::assignOptimally(int rows, int columns) {
+    const double infinity = std::numeric_limits<double>::infinity();
+    rowPotentials.assign(rows + 1, 0.0);
+    columnPotentials.assign(columns + 1, 0.0);
+    columnRows.assign(columns + 1, 0);
+    previousColumns.assign(columns + 1, 0);
+
+    for (int row = 1; row <= rows; ++row) {
+        columnRows[0] = row;
+        int column = 0;
+        minSlack.assign(columns + 1, infinity);
+        isColumnUsed.assign(columns + 1, 0);
+
+        // Shortest augmenting path from the row to a free column
+        do {
+            isColumnUsed[column] = 1;
+            int pathRow = columnRows[column];
+            double delta = infinity;
+            int nextColumn = 0;
+            const double* rowCosts = &costs[static_cast<size_t>(pathRow - 1) * columns];
+            for (int j = 1; j <= columns; ++j) {
+                if (isColumnUsed[j]) continue;
+                double slack = rowCosts[j - 1] - rowPotentials[pathRow] - columnPotentials[j];
+                if (slack < minSlack[j]) {
+                    minSlack[j] = slack;
+                    previousColumns[j] = column;
+                }
+                if (minSlack[j] < delta) {
+                    delta = minSlack[j];
+                    nextColumn = j;
+                }
+            }
+            for (int j = 0; j <= columns; ++j) {
+                if (isColumnUsed[j]) {
+                    rowPotentials[columnRows[j]] += delta;
+                    columnPotentials[j] -= delta;
+                } else {
+                    minSlack[j] -= delta;
+                }
+            }
+            column = nextColumn;
+        } while (columnRows[column] != 0);
+
+        // Augment along the path
+        do {
+            int previousColumn = previousColumns[column];
+            columnRows[column] = columnRows[previousColumn];
+            column = previousColumn;
+        } while (column != 0);
+    }
+
+    rowColumns.resize(rows);
+    for (int j = 1; j <= columns; ++j) {
+        if (columnRows[j] != 0) {
+            rowColumns[columnRows[j] - 1] = j - 1;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef TAGASSOCIATION_H
+#define TAGASSOCIATION_H
+
+/*********************************************** Tag Association ********************************************************
+ * Pairs UWB tags with detected people in one frame (optimal assignment), instead of pairing them by order:
+ *  - cost: distance between the tag and the person on the floor (meters, world coordinates of the Optical or
+ *    Pixel-to-Real method); pairs farther than MAX_DISTANCE are not paired (person without tag, tag out of view)
+ *  - warm start: pairs of the previous frame are preferred (their cost is lowered by STICKINESS), so pairings
+ *    stay stable when people are close to each other. A person is the same if it has the same track ID (Person Tracker),
+ *    or without tracking, if it is near the previous position of the tag's person.
+ *    If every tag's cheapest person is a different one (the usual case: the previous pairing still holds),
+ *    that is the optimal assignment and Hungarian algorithm is not run at all
+ *  - Hungarian algorithm (shortest augmenting paths with potentials, O(n^2 m)) otherwise
+ *
+ * Buffers are kept between frames, so associating dozens of tags and people does not allocate.
+ * One instance per sequence of frames (playback, export); not thread-safe.
+*************************************************************************************************************************/
+
+#include <vector>
+#include <QPointF>
+
+class TagAssociation
+{
+public:
+    void reset(); // frames are not consecutive anymore (seek, new export)
+
+    // Returns the tag ID paired with each person (-1: not paired). trackIDs may be empty (people are not tracked)
+    const std::vector<int>& associate(const std::vector<int>& tagIDs, const std::vector<QPointF>& tagPositions,
+                                      const std::vector<QPointF>& personPositions, const std::vector<int>& trackIDs);
+
+private:
+    struct Pair {
+        int tagID;
+        int trackID;
+        QPointF personPosition;
+    };
+
+    std::vector<Pair> previousPairs;
+    std::vector<int> personTagIDs;
+
+    // Work buffers (rows <= columns)
+    std::vector<double> costs;
+    std::vector<double> rowPotentials, columnPotentials, minSlack;
+    std::vector<int> columnRows, rowColumns, previousColumns;
+    std::vector<char> isColumnUsed;
+
+    bool assignGreedily(int rows, int columns);
+    void assignOptimally(int rows, int columns);
+};
+
+#endif // TAGASSOCIATION_H
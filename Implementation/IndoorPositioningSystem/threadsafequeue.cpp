@@ -18,6 +18,22 @@ void ThreadSafeQueue::enqueue(UWBVideoData&& data) {
     cvar.notify_all(); // notify all who waits for update in the queue, e.g. GUI to show frame
 }
 
+// isValid is checked under the lock; the producer has to change its state before calling clear() / notify_all() to drop the data
+bool ThreadSafeQueue::enqueue(UWBVideoData&& data, const std::function<bool()>& isValid) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cvar.wait(lock, [this, &isValid] {return buffer.size() < capacity || isInterruptionRequested || isStopRequested || !isValid(); });
+    if (isInterruptionRequested || isStopRequested) {
+        isInterruptionRequested = false;
+        return false;
+    }
+    if (!isValid()) {
+        return false;
+    }
+    buffer.push(std::move(data));
+    cvar.notify_all();
+    return true;
+}
+
 bool ThreadSafeQueue::dequeue(UWBVideoData& data) {
     std::unique_lock<std::mutex> lock(mtx);
     cvar.wait(lock, [this]{return !buffer.empty() || isStopRequested; });
@@ -4,13 +4,14 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 
 #include "structures.h"
 
 /**************************************** Thread Safe Queue *************************************************************
  * This is a thread safe Video + UWB data container
  * All threads are working with this structure
- * Pipeline: VideoProcessr (read video frame) -> DataProcessor (sync with UWB data) -> VideoPlayer (show synced data)
+ * Pipeline: VideoProcessr (read video frame) -> PlaybackPipeline (detect people, sync with UWB data) -> VideoPlayer (show synced data)
  * IMPORTANT: capacity of the queue should be set low (in constructor of VideModel), causes high load on machine
 *************************************************************************************************************************/
 
@@ -21,6 +22,7 @@ public:
     ~ThreadSafeQueue();
 
     void enqueue(UWBVideoData&& data);
+    bool enqueue(UWBVideoData&& data, const std::function<bool()>& isValid); // dropped if it becomes invalid while waiting
     bool dequeue(UWBVideoData& data);
     bool isEmpty();
     void notify_all();
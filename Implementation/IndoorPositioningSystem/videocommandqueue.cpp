@@ -0,0 +1,38 @@
+#include "videocommandqueue.h"
+
+#include <algorithm>
+
+void VideoCommandQueue::push(VideoCommand&& command) {
+    std::lock_guard<std::mutex> lock(mtx);
+    commands.push_back(std::move(command));
+    commandCondition.notify_one();
+}
+
+bool VideoCommandQueue::tryPop(VideoCommand& command) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (commands.empty()) {
+        return false;
+    }
+    command = std::move(commands.front());
+    commands.pop_front();
+    return true;
+}
+
+void VideoCommandQueue::waitPop(VideoCommand& command) {
+    std::unique_lock<std::mutex> lock(mtx);
+    commandCondition.wait(lock, [this] { return !commands.empty(); });
+    command = std::move(commands.front());
+    commands.pop_front();
+}
+
+bool VideoCommandQueue::hasPendingCommand() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return !commands.empty();
+}
+
+bool VideoCommandQueue::hasPreemptingCommand() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::any_of(commands.begin(), commands.end(), [](const VideoCommand& command) {
+        return command.type != VideoCommandType::Play && command.type != VideoCommandType::Pause;
+    });
+}
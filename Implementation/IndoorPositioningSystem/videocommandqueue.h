@@ -0,0 +1,50 @@
+#ifndef VIDEOCOMMANDQUEUE_H
+#define VIDEOCOMMANDQUEUE_H
+
+/*********************************************** Video Command Queue ****************************************************
+ * Requests to Video Processor (play, pause, seek, export, cancel, stop) from the GUI, batch or any other thread.
+ * Commands are applied by the Video Processor thread in the order they were pushed, between frames, so no caller waits
+ * for a frame, a seek or an export in progress.
+ *  - seek, export, cancel and stop preempt long operations (an export is interrupted between two frames)
+ *  - play and pause only change what the thread does after the current frame
+*************************************************************************************************************************/
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "structures.h"
+
+enum class VideoCommandType {
+    Play,
+    Pause,
+    Seek, // to position (frame ID)
+    Export, // frameRange of type exportType
+    Cancel, // the export in progress
+    Stop // processing ends (Video Processor is destroyed)
+};
+
+struct VideoCommand {
+    VideoCommandType type;
+    int position = 0;
+    std::vector<int> frameRange;
+    ExportType exportType = ExportType::FrameByFrameExport;
+};
+
+class VideoCommandQueue
+{
+public:
+    void push(VideoCommand&& command);
+    bool tryPop(VideoCommand& command);
+    void waitPop(VideoCommand& command); // blocks until a command is pushed
+    bool hasPendingCommand();
+    bool hasPreemptingCommand(); // seek, export, cancel or stop is pending
+
+private:
+    std::deque<VideoCommand> commands;
+    std::mutex mtx;
+    std::condition_variable commandCondition;
+};
+
+#endif // VIDEOCOMMANDQUEUE_H
@@ -0,0 +1,89 @@
+#include "videodecoder.h"
+
+#include <iostream>
+
+#ifdef HAVE_FFMPEG
+#include "ffmpegvideodecoder.h"
+#endif
+
+std::unique_ptr<VideoDecoder> VideoDecoder::create(const std::string& filename, Backend backend, int threadCount) {
+#ifdef HAVE_FFMPEG
+    if (backend != Backend::OpenCV) {
+        std::unique_ptr<VideoDecoder> decoder(new FFmpegVideoDecoder(threadCount));
+        if (decoder->open(filename) || backend == Backend::FFmpeg) {
+            return decoder;
+        }
+        std::cerr << "FFmpeg cannot decode the video, falling back to OpenCV: " << filename << std::endl;
+    }
+#else
+    (void)threadCount;
+    if (backend == Backend::FFmpeg) {
+        std::cerr << "Built without FFmpeg, the video is decoded by OpenCV" << std::endl;
+    }
+#endif
+
+    std::unique_ptr<VideoDecoder> decoder(new OpenCVVideoDecoder);
+    decoder->open(filename);
+    return decoder;
+}
+
+bool VideoDecoder::isAvailable(Backend backend) {
+#ifdef HAVE_FFMPEG
+    (void)backend;
+    return true;
+#else
+    return backend != Backend::FFmpeg;
+#endif
+}
+
+//-------------------------------- OpenCV (cv::VideoCapture) --------------------------------
+
+bool OpenCVVideoDecoder::open(const std::string& filename) {
+    capture.release();
+    return capture.open(filename);
+}
+
+void OpenCVVideoDecoder::release() {
+    capture.release();
+}
+
+bool OpenCVVideoDecoder::isOpened() const {
+    return capture.isOpened();
+}
+
+bool OpenCVVideoDecoder::read(cv::Mat& frame) {
+    return capture.read(frame) && !frame.empty();
+}
+
+bool OpenCVVideoDecoder::grab() {
+    return capture.grab();
+}
+
+bool OpenCVVideoDecoder::seek(int position) {
+    return getPosition() == position || capture.set(cv::CAP_PROP_POS_FRAMES, position);
+}
+
+int OpenCVVideoDecoder::getPosition() const {
+    return static_cast<int>(capture.get(cv::CAP_PROP_POS_FRAMES));
+}
+
+int OpenCVVideoDecoder::getFrameCount() const {
+    return static_cast<int>(capture.get(cv::CAP_PROP_FRAME_COUNT));
+}
+
+double OpenCVVideoDecoder::getFPS() const {
+    return capture.get(cv::CAP_PROP_FPS);
+}
+
+cv::Size OpenCVVideoDecoder::getFrameSize() const {
+    return cv::Size(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+// Derived from the position by some OpenCV backends (not the timestamp of the stream)
+double OpenCVVideoDecoder::getTimestamp() const {
+    return isOpened() ? capture.get(cv::CAP_PROP_POS_MSEC) : -1.0;
+}
+
+std::string OpenCVVideoDecoder::getName() const {
+    return "OpenCV (" + (isOpened() ? capture.getBackendName() : std::string("closed")) + ")";
+}
@@ -0,0 +1,73 @@
+#ifndef VIDEODECODER_H
+#define VIDEODECODER_H
+
+/*************************************************** Video Decoder ******************************************************
+ * Decoding of recorded videos for Video Processor, Frame Cache and benchmarks. Backends:
+ *  - FFmpeg (libavcodec, built with HAVE_FFMPEG): frame and slice threading of the decoder, multi-threaded conversion
+ *    to BGR straight into the buffer of the output Mat (pooled if its allocator is the Frame Pool), exact seeking
+ *    (previous keyframe + decoding forward) and the presentation timestamp of every frame
+ *  - OpenCV (cv::VideoCapture): fallback if FFmpeg is not available or cannot open the video
+ * VideoDecoder::create chooses the backend (Auto: FFmpeg first).
+ *
+ * Positions are 0-based, as CAP_PROP_POS_FRAMES: getPosition() is the position of the frame returned by the next read.
+ * Not thread-safe: one decoder per thread.
+*************************************************************************************************************************/
+
+#include <memory>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+class VideoDecoder
+{
+public:
+    enum class Backend {
+        Auto,
+        FFmpeg,
+        OpenCV
+    };
+
+    virtual ~VideoDecoder() = default;
+
+    // Never null: if the video cannot be opened, isOpened() is false. threadCount 0: as many threads as cores
+    static std::unique_ptr<VideoDecoder> create(const std::string& filename, Backend backend = Backend::Auto, int threadCount = 0);
+    static bool isAvailable(Backend backend);
+
+    virtual bool open(const std::string& filename) = 0;
+    virtual void release() = 0;
+    virtual bool isOpened() const = 0;
+
+    virtual bool read(cv::Mat& frame) = 0; // BGR; the frame is allocated by its allocator (e.g. the Frame Pool)
+    virtual bool grab() = 0; // skips a frame (decoded, not converted)
+    virtual bool seek(int position) = 0; // the next read returns the frame at position
+    virtual int getPosition() const = 0;
+
+    virtual int getFrameCount() const = 0;
+    virtual double getFPS() const = 0;
+    virtual cv::Size getFrameSize() const = 0;
+    virtual double getTimestamp() const = 0; // presentation time of the last read / grabbed frame (ms); -1 if unknown
+    virtual std::string getName() const = 0;
+};
+
+class OpenCVVideoDecoder : public VideoDecoder
+{
+public:
+    bool open(const std::string& filename) override;
+    void release() override;
+    bool isOpened() const override;
+
+    bool read(cv::Mat& frame) override;
+    bool grab() override;
+    bool seek(int position) override;
+    int getPosition() const override;
+
+    int getFrameCount() const override;
+    double getFPS() const override;
+    cv::Size getFrameSize() const override;
+    double getTimestamp() const override;
+    std::string getName() const override;
+
+private:
+    mutable cv::VideoCapture capture; // get() is not const
+};
+
+#endif // VIDEODECODER_H
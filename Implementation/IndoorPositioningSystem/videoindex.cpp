@@ -0,0 +1,338 @@
+#include "videoindex.h"
+
+#include <sstream>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    const uint32_t AVIIF_KEYFRAME = 0x00000010;
+    const uint32_t AVI_NON_KEYFRAME_BIT = 0x80000000; // in OpenDML standard index
+    const uint8_t AVI_INDEX_OF_INDEXES = 0x00;
+    const uint8_t AVI_INDEX_OF_CHUNKS = 0x01;
+
+    // AVI is little endian
+    uint32_t readU32(std::ifstream& file) {
+        unsigned char bytes[4] = {0, 0, 0, 0};
+        file.read(reinterpret_cast<char*>(bytes), 4);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    uint16_t readU16(std::ifstream& file) {
+        unsigned char bytes[2] = {0, 0};
+        file.read(reinterpret_cast<char*>(bytes), 2);
+        return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+    }
+
+    uint64_t readU64(std::ifstream& file) {
+        uint64_t low = readU32(file);
+        uint64_t high = readU32(file);
+        return low | (high << 32);
+    }
+
+    uint32_t toU32(const unsigned char* bytes) {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    bool isFourCC(const char* fourCC, const char* expected) {
+        return std::memcmp(fourCC, expected, 4) == 0;
+    }
+
+    // Chunk IDs of video frames: "NNdc" (compressed) or "NNdb" (uncompressed), NN = stream number
+    bool isVideoChunk(const char* fourCC, int videoStream) {
+        return fourCC[0] == '0' + (videoStream / 10) && fourCC[1] == '0' + (videoStream % 10)
+               && fourCC[2] == 'd' && (fourCC[3] == 'c' || fourCC[3] == 'b');
+    }
+}
+
+VideoIndex::VideoIndex() {}
+
+// -------------------------------- Sidecar file --------------------------------
+bool VideoIndex::load(const std::string& indexFilename) {
+    clear();
+
+    std::ifstream indexFile(indexFilename);
+    if (!indexFile.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    VideoIndexEntry entry;
+    int isKeyframe;
+    while (std::getline(indexFile, line)) {
+        if (line.empty() || line[0] == '#') continue; // header, recorder events
+
+        std::istringstream ss(line);
+        if (!(ss >> entry.frameID >> entry.offset >> entry.size >> isKeyframe >> entry.timestamp)) {
+            std::cerr << "Corrupted video index: " << indexFilename << std::endl;
+            clear();
+            return false;
+        }
+        entry.isKeyframe = isKeyframe != 0;
+
+        // Frames are stored sequentially, frame IDs start from 1
+        if (entry.frameID != static_cast<int>(entries.size()) + 1) {
+            std::cerr << "Video index is not sequential: " << indexFilename << std::endl;
+            clear();
+            return false;
+        }
+        entries.push_back(entry);
+    }
+
+    buildKeyframeLookup();
+    return !entries.empty();
+}
+
+bool VideoIndex::save(const std::string& indexFilename) const {
+    std::ofstream indexFile(indexFilename);
+    if (!indexFile.is_open()) {
+        return false;
+    }
+
+    indexFile << "# frameID offset size keyframe timestamp\n";
+    for (const VideoIndexEntry& entry : entries) {
+        indexFile << entry.frameID << " " << entry.offset << " " << entry.size << " " << (entry.isKeyframe ? 1 : 0) << " " << entry.timestamp << "\n";
+    }
+
+    return indexFile.good();
+}
+
+void VideoIndex::clear() {
+    entries.clear();
+    keyframeBefore.clear();
+}
+
+// -------------------------------- Lookup --------------------------------
+bool VideoIndex::isEmpty() const {
+    return entries.empty();
+}
+
+int VideoIndex::getFrameCount() const {
+    return static_cast<int>(entries.size());
+}
+
+int VideoIndex::getKeyframeBefore(int frameID) const {
+    if (keyframeBefore.empty()) return -1;
+    if (frameID < 1) frameID = 1;
+    if (frameID > static_cast<int>(keyframeBefore.size())) frameID = static_cast<int>(keyframeBefore.size());
+    return keyframeBefore[frameID - 1];
+}
+
+const VideoIndexEntry& VideoIndex::getEntry(int frameID) const {
+    return entries.at(frameID - 1);
+}
+
+void VideoIndex::buildKeyframeLookup() {
+    keyframeBefore.resize(entries.size());
+    int lastKeyframe = 1; // decoding from the beginning is always possible
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].isKeyframe) {
+            lastKeyframe = entries[i].frameID;
+        }
+        keyframeBefore[i] = lastKeyframe;
+    }
+}
+
+// -------------------------------- One-time indexer (AVI) --------------------------------
+// Reads the index already stored in the AVI file, no frame is decoded.
+// OpenDML (ix##) index is used when present (files > 1 GB), legacy idx1 otherwise.
+bool VideoIndex::buildFromAVI(const std::string& videoFilename, const std::string& videoTimestampsFilename) {
+    clear();
+
+    std::ifstream file(videoFilename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    ChunkHeader riff;
+    char formType[4];
+    if (!readChunkHeader(file, riff) || !isFourCC(riff.fourCC, "RIFF") || !file.read(formType, 4) || !isFourCC(formType, "AVI ")) {
+        return false; // not an AVI file (e.g. mp4)
+    }
+
+    int videoStream = -1;
+    int64_t moviPosition = -1;
+    bool hasLegacyIndex = false;
+    ChunkHeader idx1;
+    std::vector<int64_t> standardIndexPositions;
+
+    int64_t riffEnd = riff.dataPosition + riff.size;
+    ChunkHeader chunk;
+    while (file.tellg() < riffEnd && readChunkHeader(file, chunk)) {
+        int64_t chunkEnd = chunk.dataPosition + chunk.size + (chunk.size % 2);
+        if (isFourCC(chunk.fourCC, "LIST")) {
+            char listType[4];
+            file.read(listType, 4);
+            if (isFourCC(listType, "hdrl")) {
+                parseHeaderList(file, chunk.dataPosition + chunk.size, videoStream, standardIndexPositions);
+            } else if (isFourCC(listType, "movi")) {
+                moviPosition = chunk.dataPosition; // position of "movi" type, idx1 offsets are relative to it
+            }
+        } else if (isFourCC(chunk.fourCC, "idx1")) {
+            idx1 = chunk;
+            hasLegacyIndex = true;
+        }
+        file.seekg(chunkEnd);
+    }
+
+    if (videoStream < 0) {
+        return false;
+    }
+
+    file.clear();
+    bool success = false;
+    if (!standardIndexPositions.empty()) {
+        success = true;
+        for (int64_t position : standardIndexPositions) {
+            success = success && parseStandardIndex(file, position);
+        }
+    }
+    if (!success && hasLegacyIndex && moviPosition >= 0) {
+        entries.clear();
+        success = parseLegacyIndex(file, idx1, moviPosition, videoStream);
+    }
+    if (!success || entries.empty()) {
+        clear();
+        return false;
+    }
+
+    // Timestamps are taken from video_timestamps.txt (frame IDs of both files correspond)
+    std::ifstream videoTimestampsFile(videoTimestampsFilename);
+    std::string line;
+    int id;
+    long long timestamp;
+    size_t i = 0;
+    while (i < entries.size() && std::getline(videoTimestampsFile, line)) {
+        if (line.empty() || line[0] == '#') continue; // recorder events
+
+        std::istringstream ss(line);
+        if (ss >> id >> timestamp) {
+            entries[i++].timestamp = timestamp;
+        }
+    }
+
+    buildKeyframeLookup();
+    return true;
+}
+
+bool VideoIndex::readChunkHeader(std::ifstream& file, ChunkHeader& header) {
+    if (!file.read(header.fourCC, 4)) return false;
+    header.size = readU32(file);
+    header.dataPosition = static_cast<int64_t>(file.tellg());
+    return static_cast<bool>(file);
+}
+
+// Finds the first video stream and positions of its standard indexes (from the OpenDML super index "indx")
+void VideoIndex::parseHeaderList(std::ifstream& file, int64_t listEnd, int& videoStream, std::vector<int64_t>& standardIndexPositions) {
+    int streamNumber = 0;
+    ChunkHeader chunk;
+    while (file.tellg() < listEnd && readChunkHeader(file, chunk)) {
+        int64_t chunkEnd = chunk.dataPosition + chunk.size + (chunk.size % 2);
+        char listType[4];
+        if (isFourCC(chunk.fourCC, "LIST") && file.read(listType, 4) && isFourCC(listType, "strl")) {
+            bool isVideo = false;
+            ChunkHeader streamChunk;
+            while (file.tellg() < chunkEnd && readChunkHeader(file, streamChunk)) {
+                int64_t streamChunkEnd = streamChunk.dataPosition + streamChunk.size + (streamChunk.size % 2);
+                if (isFourCC(streamChunk.fourCC, "strh")) {
+                    char streamType[4];
+                    file.read(streamType, 4);
+                    isVideo = isFourCC(streamType, "vids") && videoStream < 0;
+                    if (isVideo) videoStream = streamNumber;
+                } else if (isFourCC(streamChunk.fourCC, "indx") && isVideo) {
+                    readU16(file); // wLongsPerEntry
+                    file.get(); // bIndexSubType
+                    uint8_t indexType = static_cast<uint8_t>(file.get());
+                    uint32_t entriesInUse = readU32(file);
+                    file.seekg(4 + 12, std::ios::cur); // dwChunkId, dwReserved[3]
+                    if (indexType == AVI_INDEX_OF_INDEXES) {
+                        for (uint32_t i = 0; i < entriesInUse; ++i) {
+                            uint64_t offset = readU64(file);
+                            readU32(file); // dwSize
+                            readU32(file); // dwDuration
+                            standardIndexPositions.push_back(static_cast<int64_t>(offset));
+                        }
+                    }
+                }
+                file.seekg(streamChunkEnd);
+            }
+            streamNumber++;
+        }
+        file.seekg(chunkEnd);
+    }
+}
+
+bool VideoIndex::parseStandardIndex(std::ifstream& file, int64_t position) {
+    file.seekg(position);
+    ChunkHeader chunk;
+    if (!readChunkHeader(file, chunk) || chunk.fourCC[0] != 'i' || chunk.fourCC[1] != 'x') {
+        return false;
+    }
+
+    readU16(file); // wLongsPerEntry
+    file.get(); // bIndexSubType
+    uint8_t indexType = static_cast<uint8_t>(file.get());
+    uint32_t entriesInUse = readU32(file);
+    file.seekg(4, std::ios::cur); // dwChunkId
+    uint64_t baseOffset = readU64(file);
+    readU32(file); // dwReserved
+    if (indexType != AVI_INDEX_OF_CHUNKS) {
+        return false;
+    }
+
+    // Read all entries at once (8 bytes each)
+    std::vector<unsigned char> buffer(static_cast<size_t>(entriesInUse) * 8);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        return false;
+    }
+
+    VideoIndexEntry entry;
+    entry.timestamp = -1;
+    for (uint32_t i = 0; i < entriesInUse; ++i) {
+        uint32_t offset = toU32(&buffer[i * 8]);
+        uint32_t size = toU32(&buffer[i * 8 + 4]);
+        entry.frameID = static_cast<int>(entries.size()) + 1;
+        entry.offset = static_cast<int64_t>(baseOffset + offset); // points to the frame data
+        entry.size = size & ~AVI_NON_KEYFRAME_BIT;
+        entry.isKeyframe = !(size & AVI_NON_KEYFRAME_BIT);
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+bool VideoIndex::parseLegacyIndex(std::ifstream& file, const ChunkHeader& idx1, int64_t moviPosition, int videoStream) {
+    file.seekg(idx1.dataPosition);
+    std::vector<unsigned char> buffer(idx1.size);
+    if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        return false;
+    }
+
+    // Offsets are usually relative to the "movi" list type, but some writers store absolute offsets
+    bool isAbsolute = false;
+    bool isFirst = true;
+
+    VideoIndexEntry entry;
+    entry.timestamp = -1;
+    for (size_t i = 0; i + 16 <= buffer.size(); i += 16) {
+        const char* chunkID = reinterpret_cast<const char*>(&buffer[i]);
+        if (!isVideoChunk(chunkID, videoStream)) continue;
+
+        uint32_t flags = toU32(&buffer[i + 4]);
+        uint32_t offset = toU32(&buffer[i + 8]);
+        uint32_t size = toU32(&buffer[i + 12]);
+
+        if (isFirst) {
+            isAbsolute = offset > moviPosition;
+            isFirst = false;
+        }
+
+        entry.frameID = static_cast<int>(entries.size()) + 1;
+        entry.offset = (isAbsolute ? offset : moviPosition + offset) + 8; // skip chunk header
+        entry.size = size;
+        entry.isKeyframe = flags & AVIIF_KEYFRAME;
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+// -------------------------------------------- End of Video Index -------------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+#ifndef VIDEOINDEX_H
+#define VIDEOINDEX_H
+
+/*********************************************** Video Index ***********************************************************
+ * Seek index of the recorded video: frame ID -> byte offset, size, keyframe flag and timestamp
+ * Sidecar file "video_index.txt" (one frame per line): frameID offset size keyframe timestamp
+ *  - written by the Server while recording in MJPEG passthrough mode
+ *  - otherwise built once from the AVI index (idx1 or OpenDML ix##) and saved next to the video
+ *
+ * VideoProcessor uses it to find the previous keyframe in O(1) and to decode forward from it.
+ * This makes seeking in long H.264 recordings frame accurate and fast (only frames of one GOP are decoded).
+************************************************************************************************************************/
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+struct VideoIndexEntry {
+    int frameID; // starts from 1 (the same as in video_timestamps.txt)
+    int64_t offset; // absolute offset of the frame data in the video file
+    uint32_t size;
+    bool isKeyframe;
+    long long timestamp;
+};
+
+class VideoIndex
+{
+public:
+    VideoIndex();
+
+    bool load(const std::string& indexFilename);
+    bool save(const std::string& indexFilename) const;
+    bool buildFromAVI(const std::string& videoFilename, const std::string& videoTimestampsFilename);
+    void clear();
+
+    bool isEmpty() const;
+    int getFrameCount() const;
+    int getKeyframeBefore(int frameID) const; // the nearest keyframe <= frameID
+    const VideoIndexEntry& getEntry(int frameID) const;
+
+private:
+    std::vector<VideoIndexEntry> entries;
+    std::vector<int> keyframeBefore; // precomputed for O(1) lookup
+
+    void buildKeyframeLookup();
+
+    // AVI parsing
+    struct ChunkHeader {
+        char fourCC[4];
+        uint32_t size;
+        int64_t dataPosition;
+    };
+
+    bool readChunkHeader(std::ifstream& file, ChunkHeader& header);
+    void parseHeaderList(std::ifstream& file, int64_t listEnd, int& videoStream, std::vector<int64_t>& standardIndexPositions);
+    bool parseStandardIndex(std::ifstream& file, int64_t position);
+    bool parseLegacyIndex(std::ifstream& file, const ChunkHeader& idx1, int64_t moviPosition, int videoStream);
+};
+
+#endif // VIDEOINDEX_H
@@ -1,20 +1,56 @@
 #include "videoprocessor.h"
 
-VideoProcessor::VideoProcessor(ThreadSafeQueue& frameQueue, DataProcessor* dataProcessor):
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Workers wait for the Detector Pool while it detects their frames, so there are as many workers as networks (limited by memory)
+static int playbackWorkerCount(int requested) {
+    return DetectorPool::defaultSize(requested);
+}
+
+VideoProcessor::VideoProcessor(ThreadSafeQueue& frameQueue, DataProcessor* dataProcessor, int workerCount):
     frameQueue(frameQueue)
     , dataProcessor(dataProcessor)
-    , isPaused(false)
-    , shouldStopVideoProcessing(false)
-    , isExportRequested(false)
-    , humanDetector(HumanDetector())
+    , detectorPool(playbackWorkerCount(workerCount))
+    , playbackPipeline(frameQueue, playbackWorkerCount(workerCount))
+    , exportEngine(playbackWorkerCount(workerCount))
+    , videoDecoder(new OpenCVVideoDecoder)
+    , nextPosition(0)
+    , recordedDetections(std::make_shared<RecordedDetections>())
+    , videoHash(0)
+    , modelHash(0)
+    , detectionCacheKey(0)
+    , exportDetectionCacheKey(0)
+    , isDetectionCacheChanged(false)
+    , detectorInputSize(640)
+    , isDetectorInputSquare(false)
+    , state(State::Paused)
+    , isStepRequested(false)
+    , videoGeneration(0)
+    , isPredictionRequested(false)
+    , isFlushRequested(false)
+    , isCalibrationChanged(false)
+    , lastTrackedPosition(0)
+    , detectionInterval(3)
+    , lastDetectedPosition(0)
+    , isDetectionRequested(false)
+    , isMotionGateEnabled(true)
+    , lastSynchronizedPosition(0)
+    , detectionBatchSize(0)
 {
     // Thread initiation
     videoProcessorThread.reset(new QThread);
     moveToThread(videoProcessorThread.get());
 
     detectionFrameSize = cv::Size(640, 640);
+    updateFramePreprocessor(cv::Size());
+
+    playbackPipeline.start([this](PlaybackFrame& playbackFrame, int workerIndex) { processFrame(playbackFrame, workerIndex); },
+                           [this](PlaybackFrame& playbackFrame) { return synchronizeFrame(playbackFrame); });
 
-    connect(this, &VideoProcessor::requestFindUWBMeasurementAndEnqueue, dataProcessor, &DataProcessor::onFindUWBMeasurementAndEnqueue, Qt::BlockingQueuedConnection);
     connect(this, &VideoProcessor::requestFindUWBMeasurementAndExport, dataProcessor, &DataProcessor::onFindUWBMeasurementAndExport, Qt::BlockingQueuedConnection);
 
     videoProcessorThread->start();
@@ -22,42 +58,95 @@ VideoProcessor::VideoProcessor(ThreadSafeQueue& frameQueue, DataProcessor* dataP
 
 // cleanup
 VideoProcessor::~VideoProcessor() {
+    pushCommand(VideoCommand{VideoCommandType::Stop});
+    playbackPipeline.stop();
     QMetaObject::invokeMethod(this, "cleanup");
     videoProcessorThread->wait();
 }
 
 void VideoProcessor::cleanup() {
-    if (camera.isOpened()) {
-        camera.release();
-    }
+    videoDecoder->release();
 
     videoProcessorThread->quit();
 }
 
 //-------------------------------- Load necessary files for video processing --------------------------------
-// Load video into cv::VideoCapture for further processing
+// Load video into the Video Decoder (FFmpeg if available, otherwise cv::VideoCapture) for further processing
 void VideoProcessor::init(const std::string& filename) {
     pauseProcessing();
     {
         QMutexLocker locker(&mutex);
-        if (camera.isOpened()) {
-            camera.release();
-        }
-        if (!camera.open(filename)) {
+        videoDecoder->release();
+        videoDecoder = VideoDecoder::create(filename);
+        if (!videoDecoder->isOpened()) {
+            std::cerr << "Failed to open video: " << filename << std::endl;
             return;
         }
+        loadVideoIndex(filename);
+
+        // Frames are cached by GOP (keyframe to keyframe)
+        std::vector<int> keyframePositions;
+        for (int frameID = 1; frameID <= videoIndex.getFrameCount(); ++frameID) {
+            if (videoIndex.getEntry(frameID).isKeyframe) {
+                keyframePositions.push_back(frameID - 1);
+            }
+        }
+        frameCache.open(filename, keyframePositions);
+        nextPosition = 0;
+
+        // Optional sidecar with people detected by the Server
+        std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+        auto loadedDetections = std::make_shared<RecordedDetections>();
+        if (loadedDetections->load((directory / "detections.txt").string())) {
+            std::cout << "Using people detections recorded by the Server" << std::endl;
+        }
+        recordedDetections = loadedDetections;
+
+        // Optional detection ROI drawn by the user: x y width height (normalized)
+        std::ifstream roiFile((directory / "detection_roi.txt").string());
+        double x, y, width, height;
+        userDetectionROI = (roiFile >> x >> y >> width >> height) ? cv::Rect2d(x, y, width, height) : cv::Rect2d();
+
+        videoDirectory = directory.string();
+        videoHash = DetectionCache::hashFile(filename);
+        videoGeneration++;
     }
 
     // set video attributes
-    totalFrames = static_cast<int>(camera.get(cv::CAP_PROP_FRAME_COUNT));
-    fps = camera.get(cv::CAP_PROP_FPS);
+    totalFrames = videoDecoder->getFrameCount();
+    fps = videoDecoder->getFPS();
     videoDuration = totalFrames / fps;
     isDistCoeffSet = false; // Distortion coefficients for frame undistortion
+    isCalibrationChanged = true; // maps for the frame size of the new video
+    isDetectionCacheChanged = true;
+    isFlushRequested = true; // frames of the previous video
     resumeProcessing();
 }
 
 void VideoProcessor::initHumanDetector(const std::string &modelConfiguration, const std::string &modelWeights) {
-    humanDetector.initHumanDetection(modelConfiguration, modelWeights);
+    initHumanDetector(DetectorConfig::darknet(modelConfiguration, modelWeights));
+}
+
+void VideoProcessor::initHumanDetector(const DetectorConfig& config) {
+    detectorPool.init(config);
+    detectorInputSize = config.inputSize;
+    isDetectorInputSquare = config.isInputSquare;
+
+    // Cached detections of another model (or the same model at another precision) are not used
+    uint64_t weightsHash = 0;
+    if (detectorPool.isInitialized()) {
+        int backend[] = {static_cast<int>(config.format), static_cast<int>(config.precision)};
+        weightsHash = DetectionCache::hash(backend, sizeof(backend));
+        weightsHash = DetectionCache::hashFile(config.model, DetectionCache::hashFile(config.configuration, weightsHash));
+        if (config.precision == DetectorPrecision::INT8) {
+            weightsHash = DetectionCache::hash(config.calibrationFolder.data(), config.calibrationFolder.size(), weightsHash);
+        }
+    }
+    {
+        QMutexLocker locker(&mutex);
+        modelHash = weightsHash;
+    }
+    isCalibrationChanged = true; // the preprocessor letterboxes for the input size of the model
 }
 
 double VideoProcessor::getVideoDuration() const {
@@ -72,186 +161,514 @@ int VideoProcessor::getTotalFrames() const {
     return totalFrames;
 }
 
+void VideoProcessor::setFrameCacheBudget(size_t budget) {
+    frameCache.setBudget(budget);
+}
+
 //-------------------------------- Main function for video processing --------------------------------
+// Commands are applied before every frame; while paused the thread waits for the next one
 void VideoProcessor::processVideo() {
+    while (handleCommands()) {
+        if (state == State::Exporting) {
+            exportFrameRange();
+        } else if (state == State::Playing || isStepRequested) {
+            if (!playNextFrame()) {
+                break; // stopped
+            }
+        }
+    }
 
+    state = State::Stopped;
+    videoDecoder->release();
+}
 
-    while (!shouldStopVideoProcessing) {
-
-        if (shouldStopVideoProcessing) break;
-
-        // Mutex is necessary for safe thread access from outside. It pauses thread, and force the thread to wait until "play" is pressed
-        {
-            QMutexLocker locker(&mutex);
-            while (isPaused && !isSeekRequested && !isExportRequested) { // when exporting or seeking the frame, video processor should work properly
-                pauseCondition.wait(&mutex);
-            }
+// Pending commands are applied in order. Seeks are coalesced (the last position wins), so dragging the slider costs one seek.
+// Play / Pause do not interrupt an export (it ends paused)
+bool VideoProcessor::handleCommands() {
+    VideoCommand command;
+    int seekPosition = -1;
+    while (state != State::Stopped) {
+        if (state == State::Paused && !isStepRequested && seekPosition < 0) {
+            commands.waitPop(command);
+        } else if (!commands.tryPop(command)) {
+            break;
         }
 
-        if (isSeekRequested) {
-            {
-                QMutexLocker locker(&mutex);
-                camera.set(cv::CAP_PROP_POS_FRAMES, seekPosition - 1); // -1 because of the following read
-                isSeekRequested = false;
-                emit seekingDone();
+        switch (command.type) {
+        case VideoCommandType::Play:
+            if (state == State::Paused) {
+                state = State::Playing;
+            }
+            break;
+        case VideoCommandType::Pause:
+            if (state == State::Playing) {
+                state = State::Paused;
+            }
+            break;
+        case VideoCommandType::Seek:
+            seekPosition = command.position;
+            break;
+        case VideoCommandType::Export:
+            if (command.frameRange.empty()) {
+                emit exportFinished(false);
+                break;
             }
+            frameRangeToExport = std::move(command.frameRange);
+            exportType = command.exportType;
+            state = State::Exporting;
+            break;
+        case VideoCommandType::Cancel:
+            if (state == State::Exporting) { // not started yet
+                state = State::Paused;
+                emit exportFinished(false);
+            }
+            break;
+        case VideoCommandType::Stop:
+            state = State::Stopped;
+            break;
         }
+    }
 
-        {
-            QMutexLocker locker(&mutex);
-            if (!camera.read(frame) || frame.empty()) {
-                camera.set(cv::CAP_PROP_POS_FRAMES, 0); // Play a video from the beginning if it was finished
-                continue;
-            }
+    if (seekPosition >= 0 && state != State::Stopped) {
+        seekTo(seekPosition);
+    }
+    return state != State::Stopped;
+}
 
-            if (cameraFrameSize.empty()) { // nesessary for frame reconstruction after detecting people
-                cameraFrameSize = frame.size();
-            }
+void VideoProcessor::seekTo(int position) {
+    QMutexLocker locker(&mutex);
+    playbackPipeline.flush(); // frames decoded before seeking are not shown
+    nextPosition = position - 1; // -1 because of the following read
+    frameCache.prefetch(nextPosition); // frames before the position (stepping backward)
+    lastDetectedPosition = 0;
+    qualityController.reset();
+    isStepRequested = true;
+    emit seekingDone();
+}
 
-            // Apply undistortion if the intrinsic parameters are loaded succesfully
-            if (!distCoeffs.empty()) {
-                if (!isDistCoeffSet) {
-                    emit distCoeffLoaded();
-                    isDistCoeffSet = true;
-                }
-                cv::Mat tempFrame;
-                // Initialize the undistortion and rectification maps
-                cv::Mat map1, map2;
-                cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, cv::Mat(), optimalCameraMatrix, frame.size(), CV_16SC2, map1, map2);
-
-                // Undistort the image using remap
-                cv::remap(frame, tempFrame, map1, map2, cv::INTER_LINEAR);
-                frame = tempFrame;
+// Decodes the next frame and submits it to the Playback Pipeline
+bool VideoProcessor::playNextFrame() {
+    if (isFlushRequested.exchange(false)) {
+        playbackPipeline.flush();
+        lastDetectedPosition = 0; // tracks are reset by the gap
+        qualityController.reset();
+    }
+
+    // Every frame is decoded into a new (pooled) buffer, because the previous one can still be processed by the pipeline
+    // Cached frames are shared (the pipeline does not modify the decoded frame)
+    PlaybackFrame playbackFrame;
+    playbackFrame.frame.allocator = &FramePool::getInstance();
+    int position;
+    RecordedDetectionsSnapshot recorded;
+    auto decodeStart = std::chrono::steady_clock::now();
+    {
+        QMutexLocker locker(&mutex);
+        if (!frameCache.find(nextPosition, playbackFrame.frame)) {
+            seekToPosition(nextPosition); // nothing to do if the decoder is already there
+            if (!videoDecoder->read(playbackFrame.frame) || playbackFrame.frame.empty()) {
+                nextPosition = 0; // Play a video from the beginning if it was finished (seekToPosition moves the decoder)
+                return true;
             }
+            frameCache.insert(nextPosition, playbackFrame.frame);
         }
+        position = ++nextPosition; // video position for Video Player (as CAP_PROP_POS_FRAMES after the read)
 
-        cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB); // necessary for qImage
-        int position;
-        {
-            QMutexLocker locker(&mutex);
-            position = static_cast<int>(camera.get(cv::CAP_PROP_POS_FRAMES)); // get video position for Video Player
+        if (cameraFrameSize.empty()) { // nesessary for frame reconstruction after detecting people
+            cameraFrameSize = playbackFrame.frame.size();
+            // Frames in flight in the pipeline: decoded frames and images for Video Player
+            FramePool::getInstance().reserve(playbackFrame.frame.total() * playbackFrame.frame.elemSize(), 2 * playbackPipeline.getWorkerCount() + 2);
         }
+        applySettingsChanges(playbackFrame.frame.size());
+        recorded = getRecordedDetectionsSnapshot();
+    }
+    qualityController.recordDecodeTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decodeStart).count());
+
+    playbackFrame.position = position;
+    playbackFrame.preprocessor = framePreprocessor;
+    // Detections at a reduced detector input (Quality Controller) are not stored: the cache holds full-quality ones
+    playbackFrame.detectionCache = framePreprocessor->getDetectorInputSize() == fullQualityPreprocessor->getDetectorInputSize() ? detectionCache : nullptr;
+
+    // People are detected only if prediction is requested.
+    // Optimized to predict only once even if both Pixel-to-Real and Optical methods are requested
+    // Detections recorded by the Server are used if available (sub-rate: the nearest detected frame),
+    // then the Detection Cache: on a hit the worker neither detects nor undistorts the detector input.
+    // Between detected frames (every detectionInterval-th) people are tracked in the sync stage,
+    // earlier detection is requested by the tracker if it loses someone.
+    // While nothing moves in the ROI and all tags stand still, the previous detections are shown again (motion gate)
+    // The Quality Controller lengthens the interval when playback falls behind
+    int previousDetectedPosition = lastDetectedPosition;
+    if (isPredictionRequested
+        && !findRecordedDetections(recorded, position, recorded.detections->getInterval() - 1, framePreprocessor->isUndistorting(), playbackFrame.detectionResults))
+    {
+        int interval = detectionInterval * qualityController.getQualityLevel().detectionIntervalFactor;
+        playbackFrame.isTracking = interval > 1;
+        const cv::Rect2d& roi = framePreprocessor->getDetectionROI();
+        if (isMotionGateEnabled && lastDetectedPosition != 0 && position > lastDetectedPosition && !isDetectionRequested
+            && dataProcessor->areTagsStationary(position) && motionGate.isStill(playbackFrame.frame, roi)) {
+            playbackFrame.toReuse = true;
+        } else if (!playbackFrame.isTracking || lastDetectedPosition == 0 || position < lastDetectedPosition
+            || position - lastDetectedPosition >= interval || isDetectionRequested.exchange(false)) {
+            playbackFrame.toDetect = !findCachedDetections(detectionCache, position, playbackFrame.detectionResults)
+                                     && detectorPool.isInitialized();
+            lastDetectedPosition = position;
+            motionGate.setReference(playbackFrame.frame, roi);
+        } else {
+            playbackFrame.toTrack = true;
+        }
+    }
 
-        // Data export uses frame ID, not timestamp
-        if (isExportRequested && frameRangeToExport.size() > 0) {
-            {
-                QMutexLocker locker(&mutex);
-                int i = 0;
-                for (i = 0; i < frameRangeToExport.size(); ++i) {
-                    if (shouldStopExport) { // handle export interruption
-                        break;
-                    }
-                    camera.set(cv::CAP_PROP_POS_FRAMES, frameRangeToExport[i]);
-                    if (!camera.read(frame)) {
-                        // std::cout << "Failed to read frame while export" << std::endl;
-                        break;
-                    }
-
-                    // Safty check. Export alway involves the use of Human Detector
-                    if (!humanDetector.isInitialized()) {
-                        emit humanDetectorNotInitialized();
-                        shouldStopExport = true;
-                        break;
-                    }
-
-                    // Detect people
-                    std::vector<DetectionResult> detectionResults;
-                    detectPeople(frame, detectionResults);
-                    DetectionData detectedPeople(detectionResults, cameraFrameSize, detectionFrameSize);
-
-                    // Send frame with detections to Data Processor for synchronization with coordinates and export
-                    if (i != (frameRangeToExport.size() - 1)) {
-                        emit requestFindUWBMeasurementAndExport(frameRangeToExport[i], i, exportType, detectedPeople, false);
-                    } else {
-                        emit requestFindUWBMeasurementAndExport(frameRangeToExport[i], i, exportType, detectedPeople, true);
-                        break;
-                    }
-                }
+    // Undistortion, detection and synchronization run in the pipeline. Blocks while the pipeline is full (frame queue is full),
+    // unless a command comes: the frame is then decoded again (Frame Cache) after the command
+    if (!playbackPipeline.submit(std::move(playbackFrame), [this] { return commands.hasPendingCommand(); })) {
+        if (playbackPipeline.isStopped()) {
+            return false;
+        }
+        nextPosition = position - 1;
+        lastDetectedPosition = previousDetectedPosition;
+        return true;
+    }
+    isStepRequested = false;
+    return true;
+}
 
-            }
-            isPaused = true;
-            isExportRequested = false;
-            if (shouldStopExport) {
-                shouldStopExport = false;
-                emit exportFinished(false);
-            } else {
-                emit exportFinished(true);
-            }
-            continue;
-        } else { // If no export requested, process as usual
+// Requested frames are read in one forward scan (Export Engine); detections are delivered in the requested order.
+// The video is locked only while a frame is read; the export stops between two frames on seek, export, cancel or stop
+void VideoProcessor::exportFrameRange() {
+    // Workers' detectors are used by the export
+    playbackPipeline.flush();
+    playbackPipeline.waitUntilIdle();
+    lastDetectedPosition = 0;
+
+    std::shared_ptr<const FramePreprocessor> preprocessor;
+    std::shared_ptr<DetectionCache> cache;
+    RecordedDetectionsSnapshot recorded;
+    cv::Size frameSize;
+    uint64_t generation;
+    {
+        QMutexLocker locker(&mutex);
+        frameSize = videoDecoder->getFrameSize();
+        applySettingsChanges(frameSize);
+        preprocessor = exportPreprocessor;
+        cache = exportDetectionCache;
+        recorded = getRecordedDetectionsSnapshot();
+        generation = videoGeneration;
+    }
 
-            std::vector<DetectionResult> detectionResults;
+    // Frames are detected in batches (one forward pass); the size is measured once if not set
+    if (detectorPool.isInitialized()) {
+        exportEngine.setBatchSize(detectionBatchSize > 0 ? detectionBatchSize : detectorPool.tuneBatchSize(preprocessor->getDetectorInputSize()));
+    }
 
-            // People are detected only if prediction is requested.
-            // Optimized to predict only once even if both Pixel-to-Real and Optical methods are requested
-            if (isPredictionRequested)
-            {    
-                detectPeople(frame, detectionResults);
+    std::atomic<bool> isHumanDetectorMissing(false);
+    bool success = exportEngine.run(frameRangeToExport,
+        [this, generation](int position, cv::Mat& frame) {
+            QMutexLocker locker(&mutex);
+            if (videoGeneration != generation) {
+                return false; // another video was opened
             }
-            DetectionData detectedPeople(detectionResults, cameraFrameSize, detectionFrameSize);
-
-
-            // Prepare frame for Video Player. Video Player works with QImage.
-            if (qImage.isNull() || qImage.width() != frame.cols || qImage.height() != frame.rows) {
-                qImage = QImage(frame.data, frame.cols, frame.rows, frame.step, QImage::Format_RGB888);
+            seekToPosition(position);
+            return videoDecoder->read(frame);
+        },
+        [this, &preprocessor, &cache, &recorded, &isHumanDetectorMissing](const std::vector<int>& positions, const std::vector<cv::Mat>& frames, std::vector<std::vector<DetectionResult>>& detectionResults, int) {
+            // Recorded detections are used if the Server detected people in this frame
+            // Frames are exported as read (not undistorted); the rest of the batch is detected at once
+            std::vector<size_t> framesToDetect;
+            std::vector<cv::Mat> detectorInputs;
+            for (size_t i = 0; i < frames.size(); ++i) {
+                if (findRecordedDetections(recorded, positions[i] + 1, 0, false, detectionResults[i])
+                    || findCachedDetections(cache, positions[i] + 1, detectionResults[i])) {
+                    continue;
+                }
+                framesToDetect.push_back(i);
+                detectorInputs.emplace_back();
+                preprocessor->resizeForDetection(frames[i], detectorInputs.back());
+            }
+            if (framesToDetect.empty()) {
+                return;
+            }
+            // Safty check. Export alway involves the use of Human Detector
+            if (!detectorPool.isInitialized()) {
+                isHumanDetectorMissing = true;
+                return;
             }
 
-            if (frame.data != qImage.bits()) {
-                memcpy(qImage.bits(), frame.data, static_cast<size_t>(frame.cols * frame.rows * frame.channels()));
+            std::vector<std::vector<DetectionResult>> detected(framesToDetect.size());
+            detectPeople(*preprocessor, detectorInputs, detected);
+            for (size_t i = 0; i < framesToDetect.size(); ++i) {
+                detectionResults[framesToDetect[i]] = std::move(detected[i]);
+                storeCachedDetections(cache, positions[framesToDetect[i]] + 1, detectionResults[framesToDetect[i]]);
             }
+        },
+        [this, &frameSize](int rangeIndex, int position, std::vector<DetectionResult>& detectionResults, bool lastRecord) {
+            // Send detections to Data Processor for synchronization with coordinates and export
+            DetectionData detectedPeople(std::move(detectionResults), cv::Size(frameSize), cv::Size(detectionFrameSize));
+            emit requestFindUWBMeasurementAndExport(position, rangeIndex, exportType, detectedPeople, lastRecord);
+        },
+        [this, &isHumanDetectorMissing] { return isHumanDetectorMissing || commands.hasPreemptingCommand(); });
+
+    if (isHumanDetectorMissing) {
+        emit humanDetectorNotInitialized();
+    }
+    state = State::Paused;
+    emit exportFinished(success && !isHumanDetectorMissing);
+}
 
-            // Send the data to DataProcessor for synchronization
-            emit requestFindUWBMeasurementAndEnqueue(position, qImage, detectedPeople);
-        }
+// Runs with the mutex locked. Undistortion maps are computed only when the intrinsic parameters change
+void VideoProcessor::applySettingsChanges(const cv::Size& frameSize) {
+    if (isCalibrationChanged) {
+        updateFramePreprocessor(frameSize);
+        isCalibrationChanged = false;
+        isDetectionCacheChanged = true;
+    }
+    if (isDetectionCacheChanged.exchange(false)) {
+        updateDetectionCaches();
     }
 
-    camera.release();
+    // Undistortion is applied if the intrinsic parameters are loaded succesfully
+    if (framePreprocessor->isUndistorting() && !isDistCoeffSet) {
+        emit distCoeffLoaded();
+        isDistCoeffSet = true;
+    }
 }
 
 //---------------- Helping functions for Play / Pause / Seeking video in Video Player -----------------------
+void VideoProcessor::pushCommand(VideoCommand&& command) {
+    commands.push(std::move(command));
+    playbackPipeline.interrupt(); // the thread may wait for space in the pipeline
+}
+
 void VideoProcessor::resumeProcessing() {
-    isPaused = false;
-    QMutexLocker locker(&mutex);
-    pauseCondition.wakeOne();
+    pushCommand(VideoCommand{VideoCommandType::Play});
 }
 
 void VideoProcessor::pauseProcessing() {
-    isPaused = true;
+    pushCommand(VideoCommand{VideoCommandType::Pause});
 }
 
 void VideoProcessor::stopProcessing() {
-    shouldStopVideoProcessing = true;
-    resumeProcessing();
+    pushCommand(VideoCommand{VideoCommandType::Stop});
+    playbackPipeline.stop(); // releases the sync stage if it waits for space in the frame queue
 }
 
 void VideoProcessor::seekToFrame(int position) {
-    isSeekRequested = true;
+    VideoCommand command{VideoCommandType::Seek};
+    command.position = position;
+    pushCommand(std::move(command));
+}
 
-    QMutexLocker locker(&mutex);
-    seekPosition = position;
-    pauseCondition.wakeOne();
+VideoProcessor::State VideoProcessor::getState() const {
+    return state;
+}
+
+// Seek index: video_index.txt next to the video (written by Server) or built once from the AVI index and saved
+void VideoProcessor::loadVideoIndex(const std::string& videoFilename) {
+    std::filesystem::path directory = std::filesystem::path(videoFilename).parent_path();
+    std::string indexFilename = (directory / "video_index.txt").string();
+
+    if (videoIndex.load(indexFilename) && videoIndex.getFrameCount() == videoDecoder->getFrameCount()) {
+        return;
+    }
+
+    if (videoIndex.buildFromAVI(videoFilename, (directory / "video_timestamps.txt").string())) {
+        if (!videoIndex.save(indexFilename)) {
+            std::cerr << "Failed to save video index: " << indexFilename << std::endl;
+        }
+    } else {
+        videoIndex.clear(); // e.g. mp4; seeking falls back to OpenCV
+    }
+}
+
+// Moves the video so that the next read returns frame at "position" (0-based, as CAP_PROP_POS_FRAMES)
+// With the index: jump to the previous keyframe and decode forward (grab) to the position.
+// If the position is ahead of the current one within the same GOP, only decoding forward is needed.
+// Without the index the decoder seeks by itself (FFmpeg exactly, from the previous keyframe)
+// If the decoder cannot seek (e.g. no frame rate or timestamps), frames are decoded forward, from the start if needed
+void VideoProcessor::seekToPosition(int position) {
+    int currentPosition = videoDecoder->getPosition();
+    if (currentPosition == position) {
+        return;
+    }
+
+    int keyframePosition = videoIndex.isEmpty() ? position : videoIndex.getKeyframeBefore(position + 1) - 1; // index uses frame IDs (from 1)
+    if (currentPosition > position || currentPosition < keyframePosition) {
+        if (videoDecoder->seek(keyframePosition)) {
+            currentPosition = keyframePosition;
+        } else if (currentPosition > position) {
+            if (!videoDecoder->seek(0)) {
+                std::cerr << "Failed to seek to frame " << position << std::endl;
+                return;
+            }
+            currentPosition = 0;
+        }
+    }
+
+    while (currentPosition < position && videoDecoder->grab()) {
+        currentPosition++;
+    }
 }
 
 //---------------- Helping functions to handle export -----------------------
 
 void VideoProcessor::setFrameRangeToExport(const std::vector<int>& frameRange, ExportType type) {
-    isExportRequested = true;
-
-    QMutexLocker locker(&mutex);
-    frameRangeToExport = frameRange;
-    exportType = type;
+    VideoCommand command{VideoCommandType::Export};
+    command.frameRange = frameRange;
+    command.exportType = type;
+    pushCommand(std::move(command));
 }
 
 void VideoProcessor::stopExport() {
-    shouldStopExport = true;
+    pushCommand(VideoCommand{VideoCommandType::Cancel});
+}
+
+//---------------- Stages of the Playback Pipeline -----------------------
+
+// Runs in a worker: one pass of undistortion (display frame + detector input), detection and the tracking image
+void VideoProcessor::processFrame(PlaybackFrame& playbackFrame, int workerIndex) {
+    auto start = std::chrono::steady_clock::now();
+    const cv::Mat& frame = playbackFrame.frame;
+    FramePool& framePool = FramePool::getInstance();
+    cv::Mat displayFrame, workerDetectorInput;
+    workerDetectorInput.allocator = &framePool;
+
+    // Video Player works with QImage (BGR is read directly, no colour conversion); the undistorted frame is written into its (pooled) buffer
+    if (playbackFrame.preprocessor->isUndistortingDisplay()) {
+        playbackFrame.qImage = framePool.createImage(frame.cols, frame.rows, QImage::Format_BGR888);
+        displayFrame = cv::Mat(frame.rows, frame.cols, CV_8UC3, playbackFrame.qImage.bits(), playbackFrame.qImage.bytesPerLine());
+    }
+    playbackFrame.preprocessor->process(frame, displayFrame, playbackFrame.toDetect ? &workerDetectorInput : nullptr);
+
+    if (playbackFrame.toDetect) {
+        detectPeople(*playbackFrame.preprocessor, workerDetectorInput, playbackFrame.detectionResults);
+        storeCachedDetections(playbackFrame.detectionCache, playbackFrame.position, playbackFrame.detectionResults);
+    }
+
+    if (playbackFrame.isTracking && !playbackFrame.toReuse) {
+        playbackFrame.preprocessor->makeTrackingImage(frame, displayFrame, playbackFrame.trackingImage);
+    }
+
+    // Without undistortion the decoded frame is shown as it is (no copy). It is shared (Frame Cache),
+    // so it is copied into the image (here, not in the sync stage) only if boxes will be drawn
+    if (displayFrame.data == frame.data) {
+        if (playbackFrame.detectionResults.empty() && !playbackFrame.toTrack && !playbackFrame.toReuse) {
+            playbackFrame.qImage = framePool.wrap(frame);
+        } else {
+            playbackFrame.qImage = framePool.createImage(frame.cols, frame.rows, QImage::Format_BGR888);
+            displayFrame = cv::Mat(frame.rows, frame.cols, CV_8UC3, playbackFrame.qImage.bits(), playbackFrame.qImage.bytesPerLine());
+            frame.copyTo(displayFrame);
+        }
+    }
+
+    playbackFrame.frame.release();
+    qualityController.recordWorkerTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Runs in the sync stage, frames come in order: tracking, drawing and synchronization
+UWBVideoData VideoProcessor::synchronizeFrame(PlaybackFrame& playbackFrame) {
+    auto start = std::chrono::steady_clock::now();
+    // People stand still: the detections of the previous frame (detected, tracked or reused) are shown again
+    if (playbackFrame.toReuse && playbackFrame.position == lastSynchronizedPosition + 1) {
+        playbackFrame.detectionResults = lastDetectionResults;
+    }
+    lastSynchronizedPosition = playbackFrame.position;
+
+    if (playbackFrame.isTracking) {
+        if (playbackFrame.position != lastTrackedPosition + 1) {
+            personTracker.reset(); // seek, flush or the video started again
+        }
+        lastTrackedPosition = playbackFrame.position;
+
+        if (playbackFrame.toReuse) {
+            // tracks are kept as they are
+        } else if (playbackFrame.toTrack) {
+            playbackFrame.detectionResults = personTracker.predict(playbackFrame.trackingImage);
+        } else {
+            personTracker.update(playbackFrame.detectionResults, playbackFrame.trackingImage);
+        }
+        if (personTracker.isDetectionNeeded()) {
+            isDetectionRequested = true;
+        }
+        playbackFrame.trackingImage.release();
+    }
+    lastDetectionResults = playbackFrame.detectionResults;
+
+    // Boxes are drawn after synchronization, labeled with the paired tags
+    DetectionData detectedPeople(std::move(playbackFrame.detectionResults), cv::Size(playbackFrame.qImage.width(), playbackFrame.qImage.height()), cv::Size(detectionFrameSize));
+    UWBVideoData data = dataProcessor->synchronizeFrame(playbackFrame.position, std::move(playbackFrame.qImage), detectedPeople);
+
+    if (!detectedPeople.detectionResults.empty()) {
+        QImage& qImage = data.videoData.qImage;
+        cv::Mat displayFrame(qImage.height(), qImage.width(), CV_8UC3, qImage.bits(), qImage.bytesPerLine());
+        drawDetections(*playbackFrame.preprocessor, displayFrame, detectedPeople.detectionResults, data.personTagIDs);
+    }
+
+    // A new level applies to the next decoded frames; the preprocessor is rebuilt if the detector input or display changes
+    const QualityLevel previous = qualityController.getQualityLevel();
+    double syncTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (qualityController.update(playbackFrame.position, syncTime, frameQueue.size(), playbackPipeline.getWorkerCount(), isPredictionRequested && detectorPool.isInitialized())) {
+        const QualityLevel& quality = qualityController.getQualityLevel();
+        if (quality.maxInputSize != previous.maxInputSize || quality.isDisplayUndistorted != previous.isDisplayUndistorted) {
+            isCalibrationChanged = true;
+        }
+        emit qualityLevelChanged(qualityController.getLevel(), QString::fromUtf8(quality.name));
+    }
+
+    return data;
+}
+
+// A new preprocessor is created, so frames in flight keep using the maps they were submitted with
+// Export detects at full quality: the playback quality level never changes its detector input (nor its cache)
+void VideoProcessor::updateFramePreprocessor(const cv::Size& frameSize) {
+    std::shared_ptr<FramePreprocessor> preprocessor = createFramePreprocessor(frameSize, qualityController.getQualityLevel());
+    if (!distCoeffs.empty() && !cameraMatrix.empty() && !frameSize.empty()) {
+        preprocessor->setCalibration(cameraMatrix, distCoeffs, optimalCameraMatrix);
+        preprocessor->prepare(frameSize);
+    }
+    framePreprocessor = std::move(preprocessor);
+    fullQualityPreprocessor = createFramePreprocessor(frameSize, QualityController::getQualityLevel(0));
+
+    // Frames are exported as read, no maps. The ROI is in the undistorted frame, so a calibrated video is exported without it
+    exportPreprocessor = fullQualityPreprocessor;
+    if (framePreprocessor->isUndistorting()) {
+        preprocessor = createFramePreprocessor(frameSize, QualityController::getQualityLevel(0));
+        preprocessor->setDetectionROI(cv::Rect2d());
+        exportPreprocessor = std::move(preprocessor);
+    }
+}
+
+// People are detected only in the ROI: drawn by the user, or the floor area bounded by the anchors
+std::shared_ptr<FramePreprocessor> VideoProcessor::createFramePreprocessor(const cv::Size& frameSize, const QualityLevel& quality) const {
+    std::shared_ptr<FramePreprocessor> preprocessor = std::make_shared<FramePreprocessor>();
+    preprocessor->setDetectionFrameSize(detectionFrameSize);
+    // Models with a fixed input shape (square) keep their input size
+    int inputSize = detectorInputSize;
+    if (quality.maxInputSize > 0 && !isDetectorInputSquare) {
+        inputSize = std::min(inputSize, quality.maxInputSize);
+    }
+    preprocessor->setDetectorInputSize(inputSize, isDetectorInputSquare);
+    preprocessor->setDisplayUndistortion(quality.isDisplayUndistorted);
+    preprocessor->setFrameSize(frameSize);
+    preprocessor->setDetectionROI(!userDetectionROI.empty() ? userDetectionROI : dataProcessor->estimateFloorROI(frameSize));
+    return preprocessor;
 }
 
 //---------------- Detect people -----------------------
 
-void VideoProcessor::detectPeople(cv::Mat& frame, std::vector<DetectionResult>& detectionsVector) {
+// Detector input is already undistorted (if calibrated), cropped to the ROI and resized by FramePreprocessor.
+// Boxes are mapped back to the detection frame
+void VideoProcessor::detectPeople(const FramePreprocessor& preprocessor, const cv::Mat& detectorInput, std::vector<DetectionResult>& detectionsVector) {
+    toDetectionResults(preprocessor, detectorPool.submit(detectorInput).get(), detectionsVector);
+}
+
+// Detector inputs of the same size (preprocessed by the same preprocessor) in one forward pass
+void VideoProcessor::detectPeople(const FramePreprocessor& preprocessor, const std::vector<cv::Mat>& detectorInputs, std::vector<std::vector<DetectionResult>>& detectionsVectors) {
+    std::vector<DetectorPool::Detections> detectedPeople = detectorPool.submit(detectorInputs).get();
+    for (size_t i = 0; i < detectedPeople.size(); ++i) {
+        toDetectionResults(preprocessor, detectedPeople[i], detectionsVectors[i]);
+    }
+}
+
+void VideoProcessor::toDetectionResults(const FramePreprocessor& preprocessor, const std::pair<std::vector<cv::Rect>, std::vector<int>>& detectedPeople, std::vector<DetectionResult>& detectionsVector) {
     int idx;
-    cv::resize(frame, frame, detectionFrameSize);
-    std::pair<std::vector<cv::Rect>, std::vector<int>> detectedPeople = humanDetector.detectPeople(frame, detectionFrameSize);
     if (!detectedPeople.first.empty() && !detectedPeople.second.empty())
     {
         for (int i = 0; i < detectedPeople.second.size(); i++)
@@ -259,17 +676,129 @@ void VideoProcessor::detectPeople(cv::Mat& frame, std::vector<DetectionResult>&
             QPoint bottomEdgeCenter;
             cv::Rect bbox;
             idx = detectedPeople.second[i];
-            bbox = detectedPeople.first[idx];
-            cv::rectangle(frame, bbox, cv::Scalar(0, 0, 255), 2);
+            bbox = preprocessor.toDetectionFrame(detectedPeople.first[idx]);
             bottomEdgeCenter.setX(bbox.x + (bbox.width / 2));
             bottomEdgeCenter.setY(bbox.y + bbox.height);
             DetectionResult detectionResult = DetectionResult(std::move(bottomEdgeCenter), std::move(bbox));
             detectionsVector.push_back(std::move(detectionResult));
-            // detectionsVector.push_back(std::move(std::make_pair(bottomEdgeCenter, box)));
         }
     }
+}
+
+RecordedDetectionsSnapshot VideoProcessor::getRecordedDetectionsSnapshot() {
+    return RecordedDetectionsSnapshot{recordedDetections, cameraMatrix, distCoeffs, optimalCameraMatrix};
+}
+
+// Recorded boxes are mapped to the detection frame (the same space as of detectPeople)
+// Works on the snapshot only: called by the video processing thread and by export workers
+bool VideoProcessor::findRecordedDetections(const RecordedDetectionsSnapshot& recorded, int frameID, int maxDistance, bool isUndistorted,
+                                            std::vector<DetectionResult>& detectionsVector) const {
+    std::vector<cv::Rect> boxes;
+    if (recorded.detections->isEmpty() || !recorded.detections->find(frameID, maxDistance, boxes)) {
+        return false;
+    }
+
+    if (isUndistorted) {
+        detectionsVector = recorded.detections->toDetectionFrame(boxes, detectionFrameSize, recorded.cameraMatrix, recorded.distCoeffs, recorded.optimalCameraMatrix);
+    } else {
+        detectionsVector = recorded.detections->toDetectionFrame(boxes, detectionFrameSize, cv::Mat(), cv::Mat(), cv::Mat());
+    }
+
+    return true;
+}
+
+// Cached boxes are in the detection frame (as detected by detectPeople)
+bool VideoProcessor::findCachedDetections(const std::shared_ptr<DetectionCache>& cache, int frameID, std::vector<DetectionResult>& detectionsVector) {
+    std::vector<cv::Rect> boxes;
+    if (!cache || !cache->find(frameID, boxes)) {
+        return false;
+    }
+
+    for (const cv::Rect& bbox : boxes) {
+        detectionsVector.emplace_back(QPoint(bbox.x + (bbox.width / 2), bbox.y + bbox.height), bbox);
+    }
+
+    return true;
+}
 
-    cv::resize(frame, frame, cameraFrameSize);
+void VideoProcessor::storeCachedDetections(const std::shared_ptr<DetectionCache>& cache, int frameID, const std::vector<DetectionResult>& detectionsVector) {
+    if (!cache) {
+        return;
+    }
+
+    std::vector<cv::Rect> boxes;
+    for (const DetectionResult& detection : detectionsVector) {
+        boxes.push_back(detection.bbox);
+    }
+    cache->store(frameID, boxes);
+}
+
+// Runs in the video processing thread (with the mutex locked) after a new video, model, calibration or quality level.
+// Both keys are of full quality, so a quality level change keeps the caches open; a cache is replaced only when its key
+// changes (not reopened: frames in flight keep storing into the cache they were submitted with)
+void VideoProcessor::updateDetectionCaches() {
+    if (videoHash == 0 || modelHash == 0) {
+        detectionCache.reset();
+        exportDetectionCache.reset();
+        detectionCacheKey = exportDetectionCacheKey = 0;
+        return;
+    }
+
+    uint64_t exportKey = getDetectionCacheKey(*exportPreprocessor, false);
+    if (!exportDetectionCache || exportKey != exportDetectionCacheKey) {
+        exportDetectionCache = std::make_shared<DetectionCache>();
+        exportDetectionCache->open(DetectionCache::getFilename(videoDirectory, exportKey), exportKey, detectionFrameSize);
+        exportDetectionCacheKey = exportKey;
+    }
+
+    // Without undistortion, playback and export detect on the same input (one file)
+    uint64_t playbackKey = getDetectionCacheKey(*fullQualityPreprocessor, framePreprocessor->isUndistorting());
+    if (playbackKey == exportKey) {
+        detectionCache = exportDetectionCache;
+    } else if (!detectionCache || playbackKey != detectionCacheKey) {
+        detectionCache = std::make_shared<DetectionCache>();
+        detectionCache->open(DetectionCache::getFilename(videoDirectory, playbackKey), playbackKey, detectionFrameSize);
+    }
+    detectionCacheKey = playbackKey;
+}
+
+// Everything the detections depend on: video, model, detection frame size, detector input (letterbox), thresholds, ROI and undistortion of the detector input
+uint64_t VideoProcessor::getDetectionCacheKey(const FramePreprocessor& preprocessor, bool isUndistorted) const {
+    const cv::Size& inputSize = preprocessor.getDetectorInputSize();
+    const cv::Size& contentSize = preprocessor.getContentSize();
+    int32_t size[6] = {detectionFrameSize.width, detectionFrameSize.height, inputSize.width, inputSize.height, contentSize.width, contentSize.height};
+    float thresholds[2] = {detectorPool.getConfidenceThreshold(), detectorPool.getNMSThreshold()};
+    const cv::Rect2d& roi = preprocessor.getDetectionROI();
+    double roiValues[4] = {roi.x, roi.y, roi.width, roi.height};
+
+    uint64_t key = DetectionCache::hash(&videoHash, sizeof(videoHash));
+    key = DetectionCache::hash(&modelHash, sizeof(modelHash), key);
+    key = DetectionCache::hash(size, sizeof(size), key);
+    key = DetectionCache::hash(thresholds, sizeof(thresholds), key);
+    key = DetectionCache::hash(roiValues, sizeof(roiValues), key);
+    if (isUndistorted) {
+        key = DetectionCache::hashMat(cameraMatrix, key);
+        key = DetectionCache::hashMat(distCoeffs, key);
+        key = DetectionCache::hashMat(optimalCameraMatrix, key);
+    }
+
+    return key;
+}
+
+// Boxes are in the detection frame; they are mapped to the displayed frame (the frame itself is never resized)
+// Label: paired tag ("tag 2"), otherwise the track ("#5")
+void VideoProcessor::drawDetections(const FramePreprocessor& preprocessor, cv::Mat& frame, const std::vector<DetectionResult>& detectionsVector, const std::vector<int>& personTagIDs) {
+    for (size_t i = 0; i < detectionsVector.size(); ++i) {
+        const DetectionResult& detection = detectionsVector[i];
+        cv::Rect bbox = preprocessor.toDisplayFrame(detection.bbox, frame.size());
+        cv::rectangle(frame, bbox, cv::Scalar(255, 0, 0), 2); // BGR
+
+        int tagID = i < personTagIDs.size() ? personTagIDs[i] : -1;
+        std::string label = tagID >= 0 ? "tag " + std::to_string(tagID) : detection.trackID >= 0 ? "#" + std::to_string(detection.trackID) : "";
+        if (!label.empty()) {
+            cv::putText(frame, label, bbox.tl() + cv::Point(4, 20), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 0, 0), 2);
+        }
+    }
 }
 
 //---------------- Handle Pixel-to-Real and Optical methods -----------------------
@@ -278,24 +807,81 @@ void VideoProcessor::detectPeople(cv::Mat& frame, std::vector<DetectionResult>&
 int VideoProcessor::setPredict(bool toPredict) {
 
     // Safety check if Human Detector is initialized
-    if (!humanDetector.isInitialized() && toPredict) {
+    bool hasRecordedDetections;
+    {
+        QMutexLocker locker(&mutex);
+        hasRecordedDetections = !recordedDetections->isEmpty();
+    }
+    if (!detectorPool.isInitialized() && !hasRecordedDetections && toPredict) {
         return -1;
     }
     isPredictionRequested = toPredict;
+    isFlushRequested = true; // frames in flight were processed with the previous setting
 
     // everythong is ok
     return 0;
 }
 
+// Undistortion maps are recomputed (once) by the video processing thread when calibration changes
 void VideoProcessor::setCameraMatrix(const cv::Mat& matrix) {
+    QMutexLocker locker(&mutex);
     cameraMatrix = matrix;
+    isCalibrationChanged = true;
 }
 
 void VideoProcessor::setOptimalCameraMatrix(const cv::Mat& matrix) {
+    QMutexLocker locker(&mutex);
     optimalCameraMatrix = matrix;
+    isCalibrationChanged = true;
 }
 
 void VideoProcessor::setDistCoeffs(const cv::Mat& matrix) {
+    QMutexLocker locker(&mutex);
     distCoeffs = matrix;
+    isCalibrationChanged = true;
+}
+
+// Detector input (and maps) are rebuilt for the new ROI by the video processing thread
+void VideoProcessor::setDetectionROI(const cv::Rect2d& roi) {
+    QMutexLocker locker(&mutex);
+    userDetectionROI = roi;
+    isCalibrationChanged = true;
+}
+
+void VideoProcessor::updateDetectionROI() {
+    isCalibrationChanged = true;
+}
+
+// Applied by the next export
+void VideoProcessor::setDetectionBatchSize(int batchSize) {
+    detectionBatchSize = std::max(0, batchSize);
+}
+
+// Playback: detection is skipped while nothing moves (frame differencing in the ROI) and all tags stand still
+void VideoProcessor::setMotionGate(bool isEnabled) {
+    isMotionGateEnabled = isEnabled;
+}
+
+// Full quality is restored at once when disabled; the level is kept across videos and seeking
+void VideoProcessor::setFrameBudget(double milliseconds) {
+    bool wasDegraded = qualityController.getLevel() != 0;
+    qualityController.setFrameBudget(milliseconds);
+    if (wasDegraded && qualityController.getLevel() == 0) {
+        isCalibrationChanged = true;
+        emit qualityLevelChanged(0, QString::fromUtf8(qualityController.getQualityLevel().name));
+    }
+}
+
+double VideoProcessor::getDetectionLatency() const {
+    return detectorPool.getAverageInferenceTime();
+}
+
+double VideoProcessor::getDetectionThroughput() const {
+    return detectorPool.getThroughput();
+}
+
+// Applied from the next detected frame
+void VideoProcessor::setDetectionInterval(int interval) {
+    detectionInterval = std::max(1, interval);
 }
 // -------------------------------------------- End of Video Processor -------------------------------------------------------------------------------
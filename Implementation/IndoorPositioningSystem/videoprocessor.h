@@ -6,6 +6,16 @@
  * This class is responsible for video processing. It reads video, detects people and prepares video data for DataProcessor (for synchronization)
  * It operates in a separate thread for player optimization.
  * For example, this way people detection (involves very high resource consumption) do not block the Video Player (GUI) and Data Processor.
+ * When playing, this thread only decodes frames. Undistortion, people detection (Detector Pool) and synchronization
+ * run in the stages of the Playback Pipeline. Export reads the requested frames in one forward scan (Export Engine) using the same workers.
+ * Decoded frames are kept in the Frame Cache (by GOP), so seeking back and forth over the same frames does not decode them again.
+ * Detections are persisted in the Detection Cache next to the video, so frames detected once (playback, export, batch) are not detected again.
+ * When playing, people are detected only every K-th frame (detection interval); in between the Person Tracker predicts their boxes.
+ * The Quality Controller measures the stages and lowers the playback quality in steps when they fall behind Video Player (frame budget).
+ *
+ * Play / Pause / Seek / Export / Cancel / Stop are commands (Video Command Queue) applied by this thread between frames, so every
+ * command takes effect within a frame time: nobody waits for the thread, and an export is interrupted between two frames.
+ * States: Paused (waits for a command), Playing, Exporting, Stopped. The video is locked (mutex) only while a frame is read.
  *
 *************************************************************************************************************************************************/
 
@@ -13,20 +23,46 @@
 #include <QThread>
 #include <atomic>
 #include <QMutex>
-#include <QWaitCondition>
 #include <QImage>
 #include <opencv2/opencv.hpp>
 
 #include "dataprocessor.h"
 #include "structures.h"
-#include "humandetector.h"
+#include "detectorpool.h"
+#include "videoindex.h"
+#include "framecache.h"
+#include "framepool.h"
+#include "recordeddetections.h"
+#include "detectioncache.h"
+#include "framepreprocessor.h"
+#include "playbackpipeline.h"
+#include "persontracker.h"
+#include "motiongate.h"
+#include "qualitycontroller.h"
+#include "exportengine.h"
+#include "videocommandqueue.h"
+#include "videodecoder.h"
+
+// Recorded detections with the calibration their boxes are mapped with, copied under the mutex for a frame or an export,
+// because init() and the calibration setters replace the members while workers map boxes
+struct RecordedDetectionsSnapshot {
+    std::shared_ptr<const RecordedDetections> detections; // never null
+    cv::Mat cameraMatrix, distCoeffs, optimalCameraMatrix;
+};
 
 class VideoProcessor : public QObject
 {
     Q_OBJECT
 
 public:
-    VideoProcessor(ThreadSafeQueue& frameQueue, DataProcessor* dataProcessor);
+    enum class State {
+        Paused,
+        Playing,
+        Exporting,
+        Stopped
+    };
+
+    VideoProcessor(ThreadSafeQueue& frameQueue, DataProcessor* dataProcessor, int workerCount = 0); // 0: chosen by the number of cores
     ~VideoProcessor();
 
     // Load video
@@ -34,21 +70,32 @@ public:
     double getVideoDuration() const;
     double getFPS() const;
     int getTotalFrames() const;
+    void setFrameCacheBudget(size_t budget); // bytes of decoded frames kept for seeking; 0 disables the cache
 
-    // Play / Pause / Seek
+    // Play / Pause / Seek (commands: they return at once and are applied in order by the video processing thread)
     void resumeProcessing();
     void pauseProcessing();
     void stopProcessing();
-    void seekToFrame(int position);
-    void setFrameRangeToExport(const std::vector<int>& frameRange, ExportType type);
+    void seekToFrame(int position); // the frame is shown even when paused
+    void setFrameRangeToExport(const std::vector<int>& frameRange, ExportType type); // starts the export; it ends paused (exportFinished)
 
     void stopExport(); // export
+    State getState() const;
 
     // Handle people detection
     void initHumanDetector(const std::string &modelConfiguration, const std::string &modelWeights);
+    void initHumanDetector(const DetectorConfig& config);
     void setOptimalCameraMatrix(const cv::Mat& matrix);
     void setCameraMatrix(const cv::Mat& matrix);
     void setDistCoeffs(const cv::Mat& matrix);
+    void setDetectionROI(const cv::Rect2d& roi); // normalized; empty: derived from the anchors (floor area)
+    void updateDetectionROI(); // anchors changed
+    void setDetectionInterval(int interval); // playback: detect every interval-th frame, track in between; 1 disables tracking
+    void setDetectionBatchSize(int batchSize); // export: frames per forward pass; 0: measured (fastest on this machine)
+    double getDetectionLatency() const; // ms per frame of the detector (forward pass)
+    double getDetectionThroughput() const; // frames per second of all detectors
+    void setMotionGate(bool isEnabled); // playback: skip detection while people stand still
+    void setFrameBudget(double milliseconds); // playback: Video Player tick the quality is kept for; 0: full quality always
     int setPredict(bool toPredict);
 
 public slots:
@@ -60,40 +107,93 @@ private slots:
 signals:
     void seekingDone();
 
-    void requestFindUWBMeasurementAndEnqueue(int position, QImage qImage, DetectionData detectedPeople);
     void requestFindUWBMeasurementAndExport(int position, int rangeIndex, ExportType type, const DetectionData& detectedPeople, bool lastRecord);
 
     void exportFinished(bool success);
 
     void humanDetectorNotInitialized();
     void distCoeffLoaded();
+    void qualityLevelChanged(int level, const QString& name); // playback quality (0: full)
 
 private:
     ThreadSafeQueue& frameQueue;
     DataProcessor* dataProcessor;
-    HumanDetector humanDetector;
+    DetectorPool detectorPool; // networks shared by playback and export (as many as workers of the pipeline)
     std::unique_ptr<QThread> videoProcessorThread;
-
-    cv::VideoCapture camera;
-    cv::Size cameraFrameSize, detectionFrameSize;
-    cv::Mat frame;
-    QImage qImage;
+    PlaybackPipeline playbackPipeline;
+    ExportEngine exportEngine;
+
+    std::unique_ptr<VideoDecoder> videoDecoder; // FFmpeg (threaded) or cv::VideoCapture; never null
+    VideoIndex videoIndex; // keyframe positions for fast seeking
+    FrameCache frameCache; // decoded frames around the played / seeked position
+    int nextPosition; // position of the next played frame (0-based); the decoder is moved there only on a cache miss
+    std::shared_ptr<const RecordedDetections> recordedDetections; // people detected already during recording; replaced (not modified) by init
+    std::string videoDirectory;
+    uint64_t videoHash, modelHash; // parts of the detection cache key (0: no video / no Human Detector)
+    std::shared_ptr<DetectionCache> detectionCache; // playback: detector input as preprocessed by fullQualityPreprocessor
+    std::shared_ptr<DetectionCache> exportDetectionCache; // export: detector input as preprocessed by exportPreprocessor (not undistorted)
+    uint64_t detectionCacheKey, exportDetectionCacheKey; // of the open caches
+    std::atomic<bool> isDetectionCacheChanged; // new video, model or calibration
+    cv::Size cameraFrameSize, detectionFrameSize; // detections are in the detection frame (the frame resized, e.g. 640x640)
+    std::atomic<int> detectorInputSize; // letterboxed frame (longer side) fed to the detector, from the model config
+    std::atomic<bool> isDetectorInputSquare;
     double fps;
     double videoDuration;
     int totalFrames;
-    int seekPosition;
 
-    QMutex mutex;
-    QWaitCondition pauseCondition;
-    std::atomic<bool> shouldStopVideoProcessing, isSeekRequested, isExportRequested, isPaused, shouldStopExport, isPredictionRequested;
+    QMutex mutex; // video, calibration and caches shared with the setters
+    VideoCommandQueue commands;
+    std::atomic<State> state; // changed by the video processing thread only
+    bool isStepRequested; // video processing thread; a frame is decoded even when paused (after seeking)
+    uint64_t videoGeneration; // new video; an export of the previous one fails
+    std::atomic<bool> isPredictionRequested;
+    std::atomic<bool> isFlushRequested; // frames in flight are outdated (new video, prediction changed)
 
     ExportType exportType;
     std::vector<int> frameRangeToExport;
 
     cv::Mat optimalCameraMatrix, cameraMatrix, distCoeffs;
+    cv::Rect2d userDetectionROI; // drawn by the user (detection_roi.txt next to the video); overrides the floor area of the anchors
     bool isDistCoeffSet;
-
-    void detectPeople(cv::Mat& frame, std::vector<DetectionResult>& detectionsVector);
+    std::shared_ptr<const FramePreprocessor> framePreprocessor; // cached undistortion maps; replaced (not modified) when calibration changes
+    std::shared_ptr<const FramePreprocessor> fullQualityPreprocessor; // framePreprocessor at level 0 (no maps): key of the playback detection cache
+    std::shared_ptr<const FramePreprocessor> exportPreprocessor; // full quality, whatever the playback quality level
+    std::atomic<bool> isCalibrationChanged;
+
+    PersonTracker personTracker; // sync stage only
+    int lastTrackedPosition; // sync stage; a gap (seek, flush) resets the tracks
+    std::atomic<int> detectionInterval;
+    int lastDetectedPosition; // decode thread; 0: no detection since seek / flush
+    std::atomic<bool> isDetectionRequested; // the tracker lost a person, detection is needed before the interval elapses
+    MotionGate motionGate; // decode thread
+    std::atomic<bool> isMotionGateEnabled;
+    int lastSynchronizedPosition; // sync stage
+    std::vector<DetectionResult> lastDetectionResults; // sync stage; shown again while people stand still
+    std::atomic<int> detectionBatchSize;
+    QualityController qualityController; // decode thread, workers and sync stage
+
+    void pushCommand(VideoCommand&& command);
+    bool handleCommands(); // false when stopped
+    void seekTo(int position);
+    bool playNextFrame(); // false when stopped
+    void exportFrameRange();
+    void applySettingsChanges(const cv::Size& frameSize);
+    void processFrame(PlaybackFrame& playbackFrame, int workerIndex); // worker stage of the Playback Pipeline
+    UWBVideoData synchronizeFrame(PlaybackFrame& playbackFrame); // sync stage of the Playback Pipeline
+    void updateFramePreprocessor(const cv::Size& frameSize);
+    std::shared_ptr<FramePreprocessor> createFramePreprocessor(const cv::Size& frameSize, const QualityLevel& quality) const;
+    void detectPeople(const FramePreprocessor& preprocessor, const cv::Mat& detectorInput, std::vector<DetectionResult>& detectionsVector);
+    void detectPeople(const FramePreprocessor& preprocessor, const std::vector<cv::Mat>& detectorInputs, std::vector<std::vector<DetectionResult>>& detectionsVectors);
+    void toDetectionResults(const FramePreprocessor& preprocessor, const std::pair<std::vector<cv::Rect>, std::vector<int>>& detectedPeople, std::vector<DetectionResult>& detectionsVector);
+    RecordedDetectionsSnapshot getRecordedDetectionsSnapshot(); // mutex locked by the caller
+    bool findRecordedDetections(const RecordedDetectionsSnapshot& recorded, int frameID, int maxDistance, bool isUndistorted, std::vector<DetectionResult>& detectionsVector) const;
+    bool findCachedDetections(const std::shared_ptr<DetectionCache>& cache, int frameID, std::vector<DetectionResult>& detectionsVector);
+    void storeCachedDetections(const std::shared_ptr<DetectionCache>& cache, int frameID, const std::vector<DetectionResult>& detectionsVector);
+    void updateDetectionCaches();
+    uint64_t getDetectionCacheKey(const FramePreprocessor& preprocessor, bool isUndistorted) const;
+    void drawDetections(const FramePreprocessor& preprocessor, cv::Mat& frame, const std::vector<DetectionResult>& detectionsVector, const std::vector<int>& personTagIDs);
+    void loadVideoIndex(const std::string& videoFilename);
+    void seekToPosition(int position);
 };
 
 #endif // VIDEOPROCESSOR_H
@@ -3,17 +3,40 @@
 int Camera::cameraIndex;
 cv::Mat Camera::frame;
 cv::VideoCapture Camera::camera;
+bool Camera::isMJPEGPassthrough = false;
 
-void Camera::initCamera(const int &cameraIndex)
+void Camera::initCamera(const int &cameraIndex, bool isMJPEGPassthrough)
 {
     Camera::cameraIndex = cameraIndex;
-    camera = cv::VideoCapture(cameraIndex);
+    Camera::isMJPEGPassthrough = isMJPEGPassthrough;
+
+    if (!isMJPEGPassthrough)
+    {
+        camera = cv::VideoCapture(cameraIndex);
+    }
+    else
+    {
+        // Raw (not decoded) buffers are available only through V4L2
+        camera = cv::VideoCapture(cameraIndex, cv::CAP_V4L2);
+    }
 
     // safety check
     if (!camera.isOpened())
     {
         throw std::runtime_error("Failed to open camera " + std::to_string(cameraIndex));
     }
+
+    if (isMJPEGPassthrough)
+    {
+        int mjpg = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+        camera.set(cv::CAP_PROP_FOURCC, mjpg);
+        camera.set(cv::CAP_PROP_CONVERT_RGB, 0); // do not decode frames to BGR
+
+        if (static_cast<int>(camera.get(cv::CAP_PROP_FOURCC)) != mjpg)
+        {
+            throw std::runtime_error("Camera " + std::to_string(cameraIndex) + " does not deliver MJPEG stream");
+        }
+    }
 }
 
 void Camera::release()
@@ -32,6 +55,22 @@ cv::Mat &Camera::getFrame()
     return frame;
 }
 
+cv::Mat &Camera::getCompressedFrame()
+{
+    if (!camera.read(frame))
+    {
+        throw std::runtime_error("Failed to read the frame from the camera " + std::to_string(Camera::cameraIndex));
+    }
+
+    // safety check: backend has to return the compressed buffer, not the decoded image
+    if (frame.rows != 1 || frame.type() != CV_8UC1)
+    {
+        throw std::runtime_error("Camera " + std::to_string(Camera::cameraIndex) + " returned decoded frame. MJPEG passthrough is not supported by the backend");
+    }
+
+    return frame;
+}
+
 cv::Size Camera::getCameraSize()
 {
     return cv::Size(camera.get(cv::CAP_PROP_FRAME_WIDTH), camera.get(cv::CAP_PROP_FRAME_HEIGHT));
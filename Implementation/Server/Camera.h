@@ -4,6 +4,9 @@
 /*********************************************** Camera ********************************************************
  * This class is responsible for accessing the webcam using OpenCV
  * Executed in a separated thread (in main.cpp) together with VideoManager - to not block UWB data collection
+ *
+ * In MJPEG passthrough mode the camera is asked for MJPG and the compressed buffers are returned without decoding
+ * (requires V4L2 backend of OpenCV)
 ****************************************************************************************************************/
 
 #include <opencv2/opencv.hpp>
@@ -17,9 +20,11 @@ public:
     static cv::VideoCapture camera;
     static int cameraIndex;
     static cv::Mat frame;
+    static bool isMJPEGPassthrough;
 
-    static void initCamera(const int &cameraIndex);
+    static void initCamera(const int &cameraIndex, bool isMJPEGPassthrough = false);
     static cv::Mat &getFrame();
+    static cv::Mat &getCompressedFrame(); // raw MJPEG buffer (1 x N, CV_8UC1); passthrough mode only
     static cv::Size getCameraSize();
     static double getCameraFPS();
     static void release(); // release camera
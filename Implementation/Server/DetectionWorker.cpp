@@ -0,0 +1,140 @@
+#include "DetectionWorker.h"
+
+bool DetectionWorker::isEnabled = false;
+size_t DetectionWorker::detectionInterval = 3;
+bool DetectionWorker::isCompressed = false;
+
+const size_t DetectionWorker::MAX_QUEUE_SIZE = 4;
+std::queue<DetectionWorker::DetectionTask> DetectionWorker::taskQueue;
+std::mutex DetectionWorker::mtx;
+std::condition_variable DetectionWorker::cvar;
+bool DetectionWorker::isStopRequested = false;
+
+cv::dnn::Net DetectionWorker::net;
+std::vector<std::string> DetectionWorker::outputNames;
+cv::Size DetectionWorker::detectionFrameSize = cv::Size(640, 640);
+std::ofstream DetectionWorker::detectionFile;
+
+void DetectionWorker::initDetectionWorker(const std::string &modelConfiguration, const std::string &modelWeights)
+{
+    net = cv::dnn::readNetFromDarknet(modelConfiguration, modelWeights);
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+    std::vector<std::string> layerNames = net.getLayerNames();
+    std::vector<int> outLayers = net.getUnconnectedOutLayers();
+    outputNames.resize(outLayers.size());
+    for (size_t i = 0; i < outLayers.size(); i++)
+        outputNames[i] = layerNames[outLayers[i] - 1];
+
+    detectionFile.open("detections.txt");
+    if (!detectionFile.is_open())
+        throw std::runtime_error("Failed to open detections.txt file");
+
+    isEnabled = true;
+}
+
+// Called by Video Manager. Never blocks: the frame is skipped if the worker does not keep up
+void DetectionWorker::enqueue(size_t frameIndex, std::time_t timestamp, const cv::Mat &data)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (taskQueue.size() >= MAX_QUEUE_SIZE)
+            return;
+
+        // camera reuses its buffers, so the data have to be copied
+        taskQueue.push({frameIndex, timestamp, data.clone()});
+    }
+    cvar.notify_one();
+}
+
+void DetectionWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        isStopRequested = true;
+    }
+    cvar.notify_one();
+}
+
+void DetectionWorker::runDetectionWorker()
+{
+    bool isHeaderWritten = false;
+
+    while (true)
+    {
+        DetectionTask task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cvar.wait(lock, []
+                      { return !taskQueue.empty() || isStopRequested; });
+            if (taskQueue.empty())
+                break; // stop requested and everything is processed
+
+            task = std::move(taskQueue.front());
+            taskQueue.pop();
+        }
+
+        cv::Mat frame = isCompressed ? cv::imdecode(task.data, cv::IMREAD_COLOR) : task.data;
+        if (frame.empty())
+            continue;
+
+        if (!isHeaderWritten)
+        {
+            detectionFile << "# frameSize " << frame.cols << " " << frame.rows << "\n";
+            detectionFile << "# interval " << detectionInterval << "\n";
+            isHeaderWritten = true;
+        }
+
+        std::vector<cv::Rect> people = detectPeople(frame);
+
+        detectionFile << task.frameIndex << " " << task.timestamp << " " << people.size();
+        for (const cv::Rect &bbox : people)
+            detectionFile << " " << bbox.x << " " << bbox.y << " " << bbox.width << " " << bbox.height;
+        detectionFile << "\n";
+    }
+
+    detectionFile.close();
+    std::cout << "Detections have been saved successfully!" << std::endl;
+}
+
+// The same detection as in Indoor Positioning System (HumanDetector), boxes in pixels of the given frame
+std::vector<cv::Rect> DetectionWorker::detectPeople(const cv::Mat &frame)
+{
+    cv::Mat blob;
+    std::vector<cv::Mat> outputs;
+    std::vector<cv::Rect> boxes, people;
+    std::vector<float> confidences;
+    std::vector<int> indices;
+    cv::Point classIDPoint;
+    double confidence;
+
+    cv::dnn::blobFromImage(frame, blob, 1 / 255.0, detectionFrameSize, cv::Scalar(0, 0, 0), true, false);
+    net.setInput(blob);
+    net.forward(outputs, outputNames);
+
+    for (const cv::Mat &output : outputs)
+    {
+        for (int i = 0; i < output.rows; i++)
+        {
+            const cv::Mat &scores = output.row(i).colRange(5, output.cols);
+            cv::minMaxLoc(scores, 0, &confidence, 0, &classIDPoint);
+            if (confidence > 0.5 && classIDPoint.x == 0) // person
+            {
+                int centerX = static_cast<int>(output.at<float>(i, 0) * frame.cols);
+                int centerY = static_cast<int>(output.at<float>(i, 1) * frame.rows);
+                int width = static_cast<int>(output.at<float>(i, 2) * frame.cols);
+                int height = static_cast<int>(output.at<float>(i, 3) * frame.rows);
+
+                confidences.push_back(static_cast<float>(confidence));
+                boxes.emplace_back(centerX - width / 2, centerY - height / 2, width, height);
+            }
+        }
+    }
+
+    cv::dnn::NMSBoxes(boxes, confidences, 0.5, 0.4, indices);
+    for (int index : indices)
+        people.push_back(boxes[index]);
+
+    return people;
+}
@@ -0,0 +1,60 @@
+#ifndef DETECTIONWORKER_H
+#define DETECTIONWORKER_H
+
+/*********************************************** Detection Worker *****************************************************
+ * Optional people detection during recording (YOLO, the same model as in Indoor Positioning System)
+ * Executed in a separated thread (in Server_Multithreaded.cpp), so it does not block video recording:
+ *  - Video Manager passes every n-th written frame (--detect-every n)
+ *  - if the worker is busy and the queue is full, the frame is skipped (recording has priority)
+ *
+ * Output: detections.txt (sidecar of video.avi), used by GUI instead of running the detector again
+ *  # frameSize <width> <height>
+ *  # interval <n>
+ *  frameID timestamp count x y width height [x y width height ...]
+ * Bounding boxes are in pixels of the recorded (distorted) frame.
+***********************************************************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+
+class DetectionWorker
+{
+public:
+    static bool isEnabled;
+    static size_t detectionInterval; // detect people in every n-th frame
+    static bool isCompressed;        // frames are MJPEG buffers (passthrough mode)
+
+    static void initDetectionWorker(const std::string &modelConfiguration, const std::string &modelWeights);
+    static void enqueue(size_t frameIndex, std::time_t timestamp, const cv::Mat &data);
+    static void runDetectionWorker();
+    static void stop(); // processes frames remaining in the queue and finishes
+
+private:
+    struct DetectionTask
+    {
+        size_t frameIndex;
+        std::time_t timestamp;
+        cv::Mat data;
+    };
+
+    static const size_t MAX_QUEUE_SIZE;
+    static std::queue<DetectionTask> taskQueue;
+    static std::mutex mtx;
+    static std::condition_variable cvar;
+    static bool isStopRequested;
+
+    static cv::dnn::Net net;
+    static std::vector<std::string> outputNames;
+    static cv::Size detectionFrameSize;
+    static std::ofstream detectionFile;
+
+    static std::vector<cv::Rect> detectPeople(const cv::Mat &frame);
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "MJPEGWriter.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t AVIF_HASINDEX = 0x00000010;
+static const uint32_t AVIF_ISINTERLEAVED = 0x00000100;
+static const uint32_t AVIIF_KEYFRAME = 0x00000010;
+static const uint8_t AVI_INDEX_OF_INDEXES = 0x00;
+static const uint8_t AVI_INDEX_OF_CHUNKS = 0x01;
+
+static const uint64_t MAX_SEGMENT_SIZE = 1000 * 1000 * 1000; // ~1 GB per RIFF segment (OpenDML recommendation)
+static const size_t SUPER_INDEX_ENTRIES = 256;              // space reserved in the header for segment indexes
+static const size_t DMLH_SIZE = 248;
+
+MJPEGWriter::MJPEGWriter() : fps(0), width(0), height(0), totalFrames(0), maxFrameSize(0), riffSizePos(0), moviSizePos(0), isFirstSegment(true) {}
+
+MJPEGWriter::~MJPEGWriter()
+{
+    release();
+}
+
+bool MJPEGWriter::open(const std::string &filename, double fps, int width, int height)
+{
+    release();
+
+    file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    this->fps = fps;
+    this->width = width;
+    this->height = height;
+    totalFrames = 0;
+    maxFrameSize = 0;
+    isFirstSegment = true;
+    segmentIndex.clear();
+    legacyIndex.clear();
+    superIndex.clear();
+
+    writeHeader();
+    startSegment();
+
+    return file.good();
+}
+
+bool MJPEGWriter::isOpened() const
+{
+    return file.is_open();
+}
+
+size_t MJPEGWriter::getFrameCount() const
+{
+    return totalFrames;
+}
+
+int64_t MJPEGWriter::write(const uint8_t *data, size_t size)
+{
+    if (!file.is_open())
+        return -1;
+
+    // Start new RIFF (AVIX) segment if the current one is full
+    uint64_t segmentSize = position() - (riffSizePos - 4);
+    if (segmentSize + size > MAX_SEGMENT_SIZE && !segmentIndex.empty() && superIndex.size() + 1 < SUPER_INDEX_ENTRIES)
+    {
+        finishSegment();
+        startSegment();
+    }
+
+    writeFourCC("00dc");
+    writeU32(static_cast<uint32_t>(size));
+    uint64_t dataPos = position();
+    file.write(reinterpret_cast<const char *>(data), size);
+    if (size % 2)
+        file.put(0); // chunks are word aligned
+
+    IndexEntry entry = {dataPos, static_cast<uint32_t>(size)};
+    segmentIndex.push_back(entry);
+    if (isFirstSegment)
+        legacyIndex.push_back(entry);
+
+    totalFrames++;
+    maxFrameSize = std::max(maxFrameSize, static_cast<uint32_t>(size));
+
+    return file.good() ? static_cast<int64_t>(dataPos) : -1;
+}
+
+void MJPEGWriter::release()
+{
+    if (!file.is_open())
+        return;
+
+    finishSegment();
+
+    // Fill in the values known only at the end of recording
+    patchU32(strhLengthPos, static_cast<uint32_t>(totalFrames));
+    patchU32(dmlhTotalFramesPos, static_cast<uint32_t>(totalFrames));
+    patchU32(avihMaxBytesPerSecPos, static_cast<uint32_t>(std::ceil(maxFrameSize * fps)));
+    patchU32(avihSuggestedBufferSizePos, maxFrameSize + 8);
+    patchU32(strhSuggestedBufferSizePos, maxFrameSize + 8);
+
+    // Super index pointing to the standard index of every segment
+    patchU32(superIndexPos, static_cast<uint32_t>(superIndex.size()));
+    file.seekp(superIndexPos + 20); // nEntriesInUse, dwChunkId, dwReserved[3]
+    for (const SuperIndexEntry &entry : superIndex)
+    {
+        writeU64(entry.offset);
+        writeU32(entry.size);
+        writeU32(entry.duration);
+    }
+
+    file.close();
+}
+
+//------------------------------------------------ AVI structure ------------------------------------------------------
+
+void MJPEGWriter::writeHeader()
+{
+    riffSizePos = beginList("RIFF", "AVI ");
+
+    uint64_t hdrl = beginList("LIST", "hdrl");
+
+    // Main AVI header
+    uint64_t avih = beginChunk("avih");
+    writeU32(static_cast<uint32_t>(std::lround(1000000.0 / fps))); // dwMicroSecPerFrame
+    avihMaxBytesPerSecPos = position();
+    writeU32(0);
+    writeU32(0); // dwPaddingGranularity
+    writeU32(AVIF_HASINDEX | AVIF_ISINTERLEAVED);
+    avihTotalFramesPos = position(); // frames of the first RIFF segment only
+    writeU32(0);
+    writeU32(0); // dwInitialFrames
+    writeU32(1); // dwStreams
+    avihSuggestedBufferSizePos = position();
+    writeU32(0);
+    writeU32(width);
+    writeU32(height);
+    for (int i = 0; i < 4; i++)
+        writeU32(0); // dwReserved
+    endChunk(avih);
+
+    uint64_t strl = beginList("LIST", "strl");
+
+    // Stream header
+    uint64_t strh = beginChunk("strh");
+    writeFourCC("vids");
+    writeFourCC("MJPG");
+    writeU32(0); // dwFlags
+    writeU16(0); // wPriority
+    writeU16(0); // wLanguage
+    writeU32(0); // dwInitialFrames
+    writeU32(1000); // dwScale
+    writeU32(static_cast<uint32_t>(std::lround(fps * 1000))); // dwRate; fps = dwRate / dwScale
+    writeU32(0); // dwStart
+    strhLengthPos = position();
+    writeU32(0);
+    strhSuggestedBufferSizePos = position();
+    writeU32(0);
+    writeU32(0xFFFFFFFF); // dwQuality
+    writeU32(0); // dwSampleSize
+    writeU16(0);
+    writeU16(0);
+    writeU16(static_cast<uint16_t>(width));
+    writeU16(static_cast<uint16_t>(height));
+    endChunk(strh);
+
+    // Stream format (BITMAPINFOHEADER)
+    uint64_t strf = beginChunk("strf");
+    writeU32(40);
+    writeU32(width);
+    writeU32(height);
+    writeU16(1);  // biPlanes
+    writeU16(24); // biBitCount
+    writeFourCC("MJPG");
+    writeU32(width * height * 3);
+    for (int i = 0; i < 4; i++)
+        writeU32(0);
+    endChunk(strf);
+
+    // OpenDML super index; entries are filled in when recording is finished
+    uint64_t indx = beginChunk("indx");
+    writeU16(4); // wLongsPerEntry
+    file.put(0); // bIndexSubType
+    file.put(AVI_INDEX_OF_INDEXES);
+    superIndexPos = position();
+    writeU32(0); // nEntriesInUse
+    writeFourCC("00dc");
+    for (int i = 0; i < 3; i++)
+        writeU32(0);
+    for (size_t i = 0; i < SUPER_INDEX_ENTRIES; i++)
+    {
+        writeU64(0);
+        writeU32(0);
+        writeU32(0);
+    }
+    endChunk(indx);
+
+    endChunk(strl);
+
+    // OpenDML extended header with the total number of frames
+    uint64_t odml = beginList("LIST", "odml");
+    uint64_t dmlh = beginChunk("dmlh");
+    dmlhTotalFramesPos = position();
+    for (size_t i = 0; i < DMLH_SIZE / 4; i++)
+        writeU32(0);
+    endChunk(dmlh);
+    endChunk(odml);
+
+    endChunk(hdrl);
+}
+
+void MJPEGWriter::startSegment()
+{
+    if (!isFirstSegment)
+    {
+        riffSizePos = beginList("RIFF", "AVIX");
+    }
+    moviSizePos = beginList("LIST", "movi");
+}
+
+void MJPEGWriter::finishSegment()
+{
+    // Standard index of the segment (stored inside movi list)
+    uint64_t ixPos = position();
+    uint64_t ix = beginChunk("ix00");
+    writeU16(2); // wLongsPerEntry
+    file.put(0); // bIndexSubType
+    file.put(AVI_INDEX_OF_CHUNKS);
+    writeU32(static_cast<uint32_t>(segmentIndex.size()));
+    writeFourCC("00dc");
+    writeU64(moviSizePos); // qwBaseOffset
+    writeU32(0);
+    for (const IndexEntry &entry : segmentIndex)
+    {
+        writeU32(static_cast<uint32_t>(entry.offset - moviSizePos));
+        writeU32(entry.size); // bit 31 is not set: every frame is a keyframe
+    }
+    endChunk(ix);
+
+    SuperIndexEntry superIndexEntry = {ixPos, static_cast<uint32_t>(position() - ixPos), static_cast<uint32_t>(segmentIndex.size())};
+    superIndex.push_back(superIndexEntry);
+
+    endChunk(moviSizePos);
+
+    // Legacy index for the first segment. Offsets are relative to the "movi" list type.
+    if (isFirstSegment)
+    {
+        uint64_t idx1 = beginChunk("idx1");
+        for (const IndexEntry &entry : legacyIndex)
+        {
+            writeFourCC("00dc");
+            writeU32(AVIIF_KEYFRAME);
+            writeU32(static_cast<uint32_t>(entry.offset - 8 - (moviSizePos + 4)));
+            writeU32(entry.size);
+        }
+        endChunk(idx1);
+        patchU32(avihTotalFramesPos, static_cast<uint32_t>(legacyIndex.size()));
+    }
+
+    endChunk(riffSizePos);
+
+    segmentIndex.clear();
+    isFirstSegment = false;
+}
+
+//------------------------------------------------ Helping functions ---------------------------------------------------
+
+void MJPEGWriter::writeFourCC(const char *fourCC)
+{
+    file.write(fourCC, 4);
+}
+
+void MJPEGWriter::writeU16(uint16_t value)
+{
+    file.put(static_cast<char>(value & 0xFF));
+    file.put(static_cast<char>((value >> 8) & 0xFF));
+}
+
+void MJPEGWriter::writeU32(uint32_t value)
+{
+    writeU16(static_cast<uint16_t>(value & 0xFFFF));
+    writeU16(static_cast<uint16_t>(value >> 16));
+}
+
+void MJPEGWriter::writeU64(uint64_t value)
+{
+    writeU32(static_cast<uint32_t>(value & 0xFFFFFFFF));
+    writeU32(static_cast<uint32_t>(value >> 32));
+}
+
+void MJPEGWriter::patchU32(uint64_t position, uint32_t value)
+{
+    std::streampos current = file.tellp();
+    file.seekp(position);
+    writeU32(value);
+    file.seekp(current);
+}
+
+uint64_t MJPEGWriter::position()
+{
+    return static_cast<uint64_t>(file.tellp());
+}
+
+// Writes chunk header with the size placeholder. Returns position of the size field.
+uint64_t MJPEGWriter::beginChunk(const char *fourCC)
+{
+    writeFourCC(fourCC);
+    uint64_t sizePosition = position();
+    writeU32(0);
+    return sizePosition;
+}
+
+uint64_t MJPEGWriter::beginList(const char *listType, const char *fourCC)
+{
+    uint64_t sizePosition = beginChunk(listType);
+    writeFourCC(fourCC);
+    return sizePosition;
+}
+
+void MJPEGWriter::endChunk(uint64_t sizePosition)
+{
+    uint64_t end = position();
+    patchU32(sizePosition, static_cast<uint32_t>(end - sizePosition - 4));
+    if ((end - sizePosition - 4) % 2)
+        file.put(0);
+}
@@ -0,0 +1,84 @@
+#ifndef MJPEGWRITER_H
+#define MJPEGWRITER_H
+
+/*********************************************** MJPEG Writer *********************************************************
+ * Minimal AVI muxer for already compressed MJPEG frames (passthrough recording).
+ * Most USB webcams deliver MJPEG, so frames taken from the camera are written "as is", without decoding them to BGR
+ * and re-encoding them with cv::VideoWriter. This is the most CPU-expensive step of the recorder.
+ *
+ * The produced file is a regular OpenDML (AVI 2.0) file readable by OpenCV / FFmpeg:
+ *  - every RIFF segment is limited to ~1 GB, so multi-hour recordings are possible
+ *  - standard index (ix00) is written for every segment, super index (indx) in the header
+ *  - legacy index (idx1) is written for the first segment (for old readers)
+ *
+ * Every written frame is a keyframe (MJPEG is intra-only).
+***********************************************************************************************************************/
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class MJPEGWriter
+{
+public:
+    MJPEGWriter();
+    ~MJPEGWriter();
+
+    bool open(const std::string &filename, double fps, int width, int height);
+    bool isOpened() const;
+    // returns the absolute byte offset of the frame data in the file (-1 in case of failure)
+    int64_t write(const uint8_t *data, size_t size);
+    void release();
+
+    size_t getFrameCount() const;
+
+private:
+    struct IndexEntry
+    {
+        uint64_t offset; // absolute offset of the frame data (after the chunk header)
+        uint32_t size;
+    };
+
+    struct SuperIndexEntry
+    {
+        uint64_t offset; // absolute offset of ix00 chunk
+        uint32_t size;
+        uint32_t duration;
+    };
+
+    std::ofstream file;
+    double fps;
+    int width, height;
+
+    size_t totalFrames;
+    uint32_t maxFrameSize;
+
+    // current RIFF segment (positions of the size fields of RIFF and LIST movi)
+    uint64_t riffSizePos, moviSizePos;
+    std::vector<IndexEntry> segmentIndex;
+    std::vector<IndexEntry> legacyIndex; // frames of the first segment (idx1)
+    std::vector<SuperIndexEntry> superIndex;
+    bool isFirstSegment;
+
+    // positions of header fields which are known only at the end of recording
+    uint64_t avihTotalFramesPos, avihMaxBytesPerSecPos, avihSuggestedBufferSizePos;
+    uint64_t strhLengthPos, strhSuggestedBufferSizePos;
+    uint64_t superIndexPos, dmlhTotalFramesPos;
+
+    void writeHeader();
+    void startSegment();
+    void finishSegment();
+
+    void writeFourCC(const char *fourCC);
+    void writeU16(uint16_t value);
+    void writeU32(uint32_t value);
+    void writeU64(uint64_t value);
+    void patchU32(uint64_t position, uint32_t value);
+    uint64_t position();
+    uint64_t beginChunk(const char *fourCC);
+    uint64_t beginList(const char *listType, const char *fourCC);
+    void endChunk(uint64_t sizePosition);
+};
+
+#endif
@@ -27,6 +27,12 @@ extern SharedData sharedData; // extern shared variable that is used for communi
 
 bool Server::debugMode = true; // DEBUG
 
+double Server::tagMotionThreshold = 0.3;
+uint64_t Server::eventCursor = 0;
+bool Server::isStreamPaused = false;
+std::deque<Server::UWBRecord> Server::preRollBuffer;
+std::map<int, std::vector<double>> Server::lastDistances;
+
 // Helping structure, showing which file descriptors are already set
 void Server::printFDSet(fd_set *set)
 {
@@ -123,6 +129,7 @@ void Server::runServer()
         // If stop was requested by video manager
         if (sharedData.terminationFlag())
         {
+            writeEvents(timestampFile, LLONG_MAX); // stop event
             for (size_t socketID = 0; socketID < MAX_CLIENTS; socketID++)
             {
                 clientSocketFD = clientSocketList[socketID];
@@ -133,6 +140,8 @@ void Server::runServer()
             return;
         }
 
+        writeEvents(timestampFile, SharedData::now());
+
         // Clear socket set
         FD_ZERO(&readFDS);
 
@@ -215,18 +224,37 @@ void Server::runServer()
                     std::string request(buffer, nbytes);
                     std::cout << "Received distance " << request << " from client: " << clientSocketFD << std::endl;
 
-                    // Check if recording is paused
-                    if (!sharedData.isRecordingPaused())
+                    // Check if recording is paused (events stamped before the record are applied first)
+                    writeEvents(timestampFile, timestamp);
+                    if (!isStreamPaused)
                     {
-                        // write measurements and timestamps to the output file (UWB_timestamps.txt)
-                        timestampFile << dataIndex << " " << timestamp << " " << request;
-                        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(responseTime - requestTime);
-                        timestampFile << "Request time: " << std::chrono::duration_cast<std::chrono::milliseconds>(requestTime.time_since_epoch()).count() << "\n";
-                        timestampFile << "Response time: " << std::chrono::duration_cast<std::chrono::milliseconds>(responseTime.time_since_epoch()).count() << "\n";
-                        timestampFile << "Overall time of the request (response time - request time): " << duration.count() << "\n"
-                                      << std::endl;
-
-                        dataIndex++;
+                        UWBRecord record = {timestamp, request, requestTime, responseTime};
+
+                        if (!sharedData.triggerMode())
+                        {
+                            writeRecord(timestampFile, record);
+                        }
+                        else
+                        {
+                            if (isTagMoving(request))
+                                sharedData.trigger(timestamp);
+
+                            if (sharedData.isEventActive(timestamp))
+                            {
+                                // pre-roll records first
+                                for (const UWBRecord &preRollRecord : preRollBuffer)
+                                    writeRecord(timestampFile, preRollRecord);
+                                preRollBuffer.clear();
+
+                                writeRecord(timestampFile, record);
+                            }
+                            else
+                            {
+                                preRollBuffer.push_back(record);
+                                while (!preRollBuffer.empty() && timestamp - preRollBuffer.front().timestamp > sharedData.getPreRollMs())
+                                    preRollBuffer.pop_front();
+                            }
+                        }
                     }
 
                     // Response with ACK - show successful receipt
@@ -276,4 +304,62 @@ void Server::runServer()
             currentClientSocketFD = clientSocketFD;
         }
     }
-}
\ No newline at end of file
+}
+
+// write measurements and timestamps to the output file (UWB_timestamps.txt)
+// Data index is assigned here, so record IDs stay sequential in trigger mode as well
+void Server::writeRecord(std::ofstream &timestampFile, const UWBRecord &record)
+{
+    timestampFile << dataIndex << " " << record.timestamp << " " << record.request;
+    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(record.responseTime - record.requestTime);
+    timestampFile << "Request time: " << std::chrono::duration_cast<std::chrono::milliseconds>(record.requestTime.time_since_epoch()).count() << "\n";
+    timestampFile << "Response time: " << std::chrono::duration_cast<std::chrono::milliseconds>(record.responseTime.time_since_epoch()).count() << "\n";
+    timestampFile << "Overall time of the request (response time - request time): " << duration.count() << "\n"
+                  << std::endl;
+
+    dataIndex++;
+}
+
+// Tag message: tagID anchorID distance anchorID distance ...
+// The tag moves if any of its distances changed more than tagMotionThreshold since its previous measurement
+bool Server::isTagMoving(const std::string &request)
+{
+    std::istringstream ss(request);
+    int tagID, anchorID;
+    double distance;
+    std::vector<double> distances;
+
+    if (!(ss >> tagID))
+        return false;
+    while (ss >> anchorID >> distance)
+        distances.push_back(distance);
+
+    bool isMoving = false;
+    auto last = lastDistances.find(tagID);
+    if (last != lastDistances.end() && last->second.size() == distances.size())
+    {
+        for (size_t i = 0; i < distances.size(); i++)
+        {
+            if (std::abs(distances[i] - last->second[i]) > tagMotionThreshold)
+                isMoving = true;
+        }
+    }
+
+    lastDistances[tagID] = distances;
+    return isMoving;
+}
+
+// Recorder events are written as comment lines with the timestamp shared by both streams
+void Server::writeEvents(std::ofstream &timestampFile, long long untilTimestamp)
+{
+    RecorderEvent event;
+    while (sharedData.readEvent(eventCursor, event, untilTimestamp))
+    {
+        timestampFile << "# " << event.getName() << " " << event.timestamp << std::endl;
+
+        if (event.type == EventPause)
+            isStreamPaused = true;
+        else if (event.type == EventResume)
+            isStreamPaused = false;
+    }
+}
@@ -8,6 +8,12 @@
  * 
  * Executed in a separated thread (in main.cpp) - to not block Video data collection
  * 
+ * Trigger mode: records are kept in the pre-roll buffer and written only while an event is active.
+ *   Tag motion (change of the measured distance) triggers an event.
+ *
+ * Recorder events (pause, resume, stop, marker) are written as "# <event> <timestamp>" lines. A record is dropped
+ *   if it was received between pause and resume events (by timestamp), so both streams are paused at the same time.
+ * 
 ****************************************************************************************************************/
 
 #include <iostream>
@@ -24,6 +30,11 @@
 #include <thread>
 #include <vector>
 #include <future>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <cmath>
+#include <climits>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 
@@ -61,11 +72,32 @@ public:
     // and selects another tag to work with
     static std::queue<int> clientQueue;
     
+    // Trigger mode
+    static double tagMotionThreshold; // change of distance (m) between consecutive measurements of a tag
+
     static void runServer();
     static void printFDSet(fd_set *set);
     static void checkForActive();
 
     static bool debugMode;
+
+private:
+    struct UWBRecord
+    {
+        std::time_t timestamp;
+        std::string request;
+        std::chrono::time_point<std::chrono::high_resolution_clock> requestTime, responseTime;
+    };
+
+    static uint64_t eventCursor; // position in the recorder event channel (SharedData)
+    static bool isStreamPaused;  // pause state at the time of the last written event
+
+    static std::deque<UWBRecord> preRollBuffer;
+    static std::map<int, std::vector<double>> lastDistances; // per tag
+
+    static void writeRecord(std::ofstream &timestampFile, const UWBRecord &record);
+    static bool isTagMoving(const std::string &request);
+    static void writeEvents(std::ofstream &timestampFile, long long untilTimestamp);
 };
 
 #endif
\ No newline at end of file
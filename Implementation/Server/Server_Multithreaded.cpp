@@ -3,6 +3,7 @@
  *      - Video Manager
  *      - (UWB) Server
  *      - Activity watchdog separately
+ *      - Detection worker (optional, --detect)
  * 
  * !! These data are not yet synchornized; synchronization is performed later in Indoor Positioning System (GUI)
  * 
@@ -10,20 +11,36 @@
  *      - Video processing: handles video recording
  *      - Server: communicates with tags and collects distance measurements from them
  *      - Activity watchdog: monitors tag responses and detects if communication between anchor and tag is blocked
+ * 
+ * Options:
+ *      --mjpeg                         record compressed MJPEG frames without decoding / re-encoding (low CPU load)
+ *      --preview-every <n>             decode only every n-th frame for the preview (with --mjpeg)
+ *      --gop <n>                       keyframe interval of H.264 video (default 18, i.e. 1 s); faster seeking in GUI
+ *      --transcode <input> <output>    convert recorded (MJPEG) video to H.264 and exit
+ *      --trigger                       event-triggered recording (tag motion, frame differencing, manual "m")
+ *      --pre-roll <s>                  seconds kept in memory and written when an event starts (default 3)
+ *      --quiet <s>                     event finishes after <s> seconds without trigger (default 10)
+ *      --motion-threshold <v>          frame differencing threshold, mean absolute difference (default 8)
+ *      --tag-motion <m>                change of tag distance (m) which triggers an event (default 0.3)
+ *      --detect <cfg> <weights>        detect people during recording, writes detections.txt (used by GUI)
+ *      --detect-every <n>              detect people in every n-th frame (default 3)
 ***************************************************************************************************************************************/
 
 #include "Server.h"
 #include "VideoManager.h"
 #include "SharedData.h"
 #include "Camera.h"
+#include "DetectionWorker.h"
 #include <iostream>
+#include <algorithm>
+#include <string>
 #include <thread>
 
 SharedData sharedData;
  
 void startCamera()
 {
-    Camera::initCamera(2);
+    Camera::initCamera(2, VideoManager::isMJPEGPassthrough);
     VideoManager::runVideoRecorder();
 }
 
@@ -37,15 +54,74 @@ void startActivityWatchdog()
     Server::checkForActive();
 }
 
-int main()
+void startDetectionWorker()
+{
+    DetectionWorker::runDetectionWorker();
+}
+
+int main(int argc, char *argv[])
 {
+    bool isTriggerMode = false;
+    std::string modelConfiguration, modelWeights;
+    double preRollSeconds = 3.0, quietPeriodSeconds = 10.0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--gop" && i + 1 < argc)
+            VideoManager::gopSize = std::stoi(argv[++i]);
+        else if (arg == "--transcode" && i + 2 < argc)
+        {
+            // Offline stage. Does not start recording
+            VideoManager::transcodeToH264(argv[i + 1], argv[i + 2]);
+            return 0;
+        }
+        else if (arg == "--mjpeg")
+            VideoManager::isMJPEGPassthrough = true;
+        else if (arg == "--preview-every" && i + 1 < argc)
+            VideoManager::previewDecimation = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--trigger")
+            isTriggerMode = true;
+        else if (arg == "--pre-roll" && i + 1 < argc)
+            preRollSeconds = std::stod(argv[++i]);
+        else if (arg == "--quiet" && i + 1 < argc)
+            quietPeriodSeconds = std::stod(argv[++i]);
+        else if (arg == "--motion-threshold" && i + 1 < argc)
+            VideoManager::motionThreshold = std::stod(argv[++i]);
+        else if (arg == "--tag-motion" && i + 1 < argc)
+            Server::tagMotionThreshold = std::stod(argv[++i]);
+        else if (arg == "--detect" && i + 2 < argc)
+        {
+            modelConfiguration = argv[++i];
+            modelWeights = argv[++i];
+        }
+        else if (arg == "--detect-every" && i + 1 < argc)
+            DetectionWorker::detectionInterval = std::max(1, std::stoi(argv[++i]));
+        else
+            std::cerr << "Unknown option: " << arg << std::endl;
+    }
+
+    if (isTriggerMode)
+        sharedData.setTriggerMode(static_cast<long long>(preRollSeconds * 1000), static_cast<long long>(quietPeriodSeconds * 1000));
+
+    std::thread detection_thread;
+    if (!modelConfiguration.empty())
+    {
+        DetectionWorker::isCompressed = VideoManager::isMJPEGPassthrough;
+        DetectionWorker::initDetectionWorker(modelConfiguration, modelWeights);
+        detection_thread = std::thread(startDetectionWorker);
+    }
+
     std::thread camera_thread(startCamera);
     std::thread server_thread(startServer);
     std::thread watchdog_thread(startActivityWatchdog);
 
     camera_thread.join();
+    DetectionWorker::stop(); // no more frames; remaining queued frames are still processed
     server_thread.join();
     watchdog_thread.join();
+    if (detection_thread.joinable())
+        detection_thread.join();
 
     return 0;
 }
\ No newline at end of file
@@ -1,69 +1,195 @@
 #ifndef SHAREDDATA_H
 #define SHAREDDATA_H
 
-// Allows to synchronize threads. 
+// Allows to synchronize threads.
 
 /*********************************************** Shared Data **********************************************************
  * This is an auxiliary structure, which helps in communcation between the Server, Video Manager and Activity Watchdog
- * For example, it ensures safe termination of the Server_Multithreaded (when "s" is pressed): 
+ * For example, it ensures safe termination of the Server_Multithreaded (when "s" is pressed):
  *  - safe shutdown of the (UWB) Server
  *  - safe releasing cv::VideoCapture webcam
  *  - pause recording of both data streams (when "p" is pressed in cv::imshow window)
+ *  - trigger mode: both streams are written only while an event is active (last trigger is younger than quiet period)
+ *
+ * The state is lock-free (atomics), so hot loops of the threads never take a mutex.
+ *
+ * Recorder events (pause, resume, stop, marker) are stamped once and broadcast to every stream through a ring buffer.
+ * Each consumer (Video Manager, Server) keeps its own cursor and writes the event into its output as a comment line:
+ *  # <event> <timestamp>
+ * Both streams use the same timestamp, so pause / resume boundaries line up exactly.
 ***********************************************************************************************************************/
 
-#include <mutex>
+#include <atomic>
 #include <chrono>
 #include <ctime>
+#include <cstdint>
+
+enum RecorderEventType
+{
+    EventPause,
+    EventResume,
+    EventStop,
+    EventMarker
+};
+
+struct RecorderEvent
+{
+    RecorderEventType type;
+    long long timestamp; // ms since epoch (the same clock as records of both streams)
+
+    const char *getName() const
+    {
+        switch (type)
+        {
+        case EventPause:
+            return "pause";
+        case EventResume:
+            return "resume";
+        case EventStop:
+            return "stop";
+        default:
+            return "marker";
+        }
+    }
+};
 
 class SharedData
 {
 public:
-    SharedData() : isPause(false), isTermination(false) {}
+    SharedData() : isPause(false), isTermination(false), lastActivityTime(0), isTriggerMode(false), preRollMs(0), quietPeriodMs(0), lastTriggerTimestamp(0), eventWriteIndex(0)
+    {
+        for (EventSlot &slot : eventSlots)
+            slot.sequence.store(0, std::memory_order_relaxed);
+    }
 
     void pauseRecording()
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        isPause = true;
+        if (!isPause.exchange(true, std::memory_order_acq_rel))
+            publishEvent(EventPause);
     }
 
     void startRecording()
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        isPause = false;
+        if (isPause.exchange(false, std::memory_order_acq_rel))
+            publishEvent(EventResume);
     }
 
     bool isRecordingPaused()
     {
-        return isPause;
+        return isPause.load(std::memory_order_acquire);
     }
 
     void setTerminationFlag()
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        isTermination = true;
+        publishEvent(EventStop); // published first, so consumers can write it before they finish
+        isTermination.store(true, std::memory_order_release);
     }
 
     bool terminationFlag()
     {
-        return isTermination;
+        return isTermination.load(std::memory_order_acquire);
+    }
+
+    void addMarker()
+    {
+        publishEvent(EventMarker);
     }
 
     void updateLastActivityTimePoint(std::chrono::high_resolution_clock::time_point timePoint)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        lastActivityTimePoint = timePoint;
+        lastActivityTime.store(timePoint.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    std::chrono::high_resolution_clock::time_point getLastActivityTimePoint()
+    {
+        return std::chrono::high_resolution_clock::time_point(std::chrono::high_resolution_clock::duration(lastActivityTime.load(std::memory_order_relaxed)));
+    }
+
+    // Trigger mode (event-triggered recording). Set before the threads are started
+    void setTriggerMode(long long preRollMs, long long quietPeriodMs)
+    {
+        this->preRollMs.store(preRollMs, std::memory_order_relaxed);
+        this->quietPeriodMs.store(quietPeriodMs, std::memory_order_relaxed);
+        isTriggerMode.store(true, std::memory_order_release);
+    }
+
+    bool triggerMode()
+    {
+        return isTriggerMode.load(std::memory_order_acquire);
     }
 
-    const std::chrono::high_resolution_clock::time_point &getLastActivityTimePoint()
+    long long getPreRollMs()
     {
-        return lastActivityTimePoint;
+        return preRollMs.load(std::memory_order_relaxed);
+    }
+
+    // Called by any trigger source (tag motion, frame differencing, manual marker); timestamp in ms since epoch
+    void trigger(long long timestamp)
+    {
+        long long last = lastTriggerTimestamp.load(std::memory_order_relaxed);
+        while (timestamp > last && !lastTriggerTimestamp.compare_exchange_weak(last, timestamp, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Data with this timestamp should be written (not only kept in the pre-roll buffer)
+    bool isEventActive(long long timestamp)
+    {
+        if (!triggerMode())
+            return true;
+
+        long long last = lastTriggerTimestamp.load(std::memory_order_relaxed);
+        return last > 0 && timestamp - last <= quietPeriodMs.load(std::memory_order_relaxed);
+    }
+
+    // Reads the next event stamped not later than untilTimestamp. Every consumer has its own cursor (starting from 0)
+    bool readEvent(uint64_t &cursor, RecorderEvent &event, long long untilTimestamp)
+    {
+        EventSlot &slot = eventSlots[cursor % EVENT_RING_SIZE];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+        if (sequence > cursor + 1) // consumer fell behind by more than the ring size; lost events are skipped
+            cursor = sequence - 1;
+        if (sequence != cursor + 1 || slot.event.timestamp > untilTimestamp)
+            return false;
+
+        event = slot.event;
+        cursor++;
+        return true;
+    }
+
+    static long long now()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
     }
 
 private:
-    bool isPause, isTermination;
-    std::chrono::high_resolution_clock::time_point lastActivityTimePoint;
+    // Events are rare (user input), so the ring is never overrun in practice
+    static const size_t EVENT_RING_SIZE = 64;
+
+    struct EventSlot
+    {
+        std::atomic<uint64_t> sequence; // index of the stored event + 1 (0 = empty)
+        RecorderEvent event;
+    };
 
-    std::mutex mtx;
+    std::atomic<bool> isPause, isTermination;
+    std::atomic<std::chrono::high_resolution_clock::rep> lastActivityTime;
+
+    std::atomic<bool> isTriggerMode;
+    std::atomic<long long> preRollMs, quietPeriodMs;
+    std::atomic<long long> lastTriggerTimestamp;
+
+    EventSlot eventSlots[EVENT_RING_SIZE];
+    std::atomic<uint64_t> eventWriteIndex;
+
+    void publishEvent(RecorderEventType type)
+    {
+        uint64_t index = eventWriteIndex.fetch_add(1, std::memory_order_relaxed);
+        EventSlot &slot = eventSlots[index % EVENT_RING_SIZE];
+        slot.event = {type, now()};
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,5 +1,7 @@
 #include "VideoManager.h"
 
+#include <cstdlib>
+
 size_t VideoManager::frameIndex = 1;
 double VideoManager::fps = 18.0;
 cv::Size VideoManager::frameSize = cv::Size(640, 360);
@@ -9,22 +11,54 @@ std::chrono::milliseconds VideoManager::currentTime;
 std::time_t VideoManager::timestamp;
 cv::Mat VideoManager::timestampMat;
 uint8_t VideoManager::key;
+bool VideoManager::isMJPEGPassthrough = false;
+size_t VideoManager::previewDecimation = 4;
+int VideoManager::gopSize = 18; // one keyframe per second
+double VideoManager::motionThreshold = 8.0;
+
+cv::VideoWriter VideoManager::videoWriter;
+MJPEGWriter VideoManager::mjpegWriter;
+std::ofstream VideoManager::timestampFile;
+std::ofstream VideoManager::indexFile;
+std::deque<VideoManager::RecordedFrame> VideoManager::preRollBuffer;
+cv::Mat VideoManager::previousGrayFrame;
+bool VideoManager::isEventRecording = false;
+uint64_t VideoManager::eventCursor = 0;
 
 extern SharedData sharedData;
 
 void VideoManager::runVideoRecorder()
 {
     // Setup of the video parameters
-    cv::VideoWriter videoWriter("video.avi", cv::VideoWriter::fourcc('H', '2', '6', '4'), fps, frameSize);
-
-    if (!videoWriter.isOpened())
+    if (!isMJPEGPassthrough)
     {
-        std::cerr << "Failed to open video writer" << std::endl;
-        return;
+        setH264WriterOptions();
+        videoWriter.open("video.avi", cv::VideoWriter::fourcc('H', '2', '6', '4'), fps, frameSize);
+        if (!videoWriter.isOpened())
+        {
+            std::cerr << "Failed to open video writer" << std::endl;
+            return;
+        }
+    }
+    else
+    {
+        // Compressed frames are written as they are, so the header has to describe the real camera resolution
+        frameSize = Camera::getCameraSize();
+        if (!mjpegWriter.open("video.avi", fps, frameSize.width, frameSize.height))
+        {
+            std::cerr << "Failed to open MJPEG writer" << std::endl;
+            return;
+        }
+
+        // Seek index for GUI; offsets are known only in passthrough mode
+        indexFile.open("video_index.txt");
+        if (!indexFile.is_open())
+            throw std::runtime_error("Failed to open video_index.txt file");
+        indexFile << "# frameID offset size keyframe timestamp" << std::endl;
     }
 
     // Open the index file
-    std::ofstream timestampFile("video_timestamps.txt");
+    timestampFile.open("video_timestamps.txt");
     if (!timestampFile.is_open())
         throw std::runtime_error("Failed to open video_timestamps.txt file");
 
@@ -36,33 +70,101 @@ void VideoManager::runVideoRecorder()
     std::cout << "  p: pause recording" << std::endl;
     std::cout << "  c: continue recording" << std::endl;
     std::cout << "  s: stop and save recording" << std::endl;
+    std::cout << "  m: add marker (and trigger an event in trigger mode)" << std::endl;
 
+    size_t capturedFrames = 0; // differs from frameIndex in trigger mode
     while (true)
     {
+        writeEvents();
+
         if (!sharedData.isRecordingPaused())
         {
-            frame = Camera::getFrame();
+            RecordedFrame recordedFrame;
+
+            if (!isMJPEGPassthrough)
+            {
+                frame = Camera::getFrame();
 
-            if (frame.empty())
-                break;
+                if (frame.empty())
+                    break;
 
-            videoWriter.write(frame);
+                recordedFrame.data = frame;
+            }
+            else
+            {
+                cv::Mat &buffer = Camera::getCompressedFrame();
 
-            // record timestamp + frameIndex of the video frame for later synchronization with UWB records
+                if (buffer.empty())
+                    break;
+
+                recordedFrame.data = buffer;
+
+                // Preview decodes only decimated frames
+                if (capturedFrames % previewDecimation == 0)
+                    frame = cv::imdecode(buffer, cv::IMREAD_COLOR);
+            }
+            capturedFrames++;
+
+            // record timestamp of the video frame for later synchronization with UWB records
             currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
             timestamp = currentTime.count();
-            timestampFile << frameIndex << " " << timestamp << std::endl;
+            recordedFrame.timestamp = timestamp;
+
+            if (!sharedData.triggerMode())
+            {
+                writeFrame(recordedFrame);
+            }
+            else
+            {
+                if (isMotionDetected(recordedFrame.data))
+                    sharedData.trigger(timestamp);
 
-            frameIndex++;
+                if (sharedData.isEventActive(timestamp))
+                {
+                    if (!isEventRecording)
+                    {
+                        std::cout << "Event started, writing " << preRollBuffer.size() << " pre-roll frames" << std::endl;
+                        isEventRecording = true;
+                    }
+
+                    // pre-roll frames first, so the beginning of the event is not lost
+                    for (const RecordedFrame &preRollFrame : preRollBuffer)
+                        writeFrame(preRollFrame);
+                    preRollBuffer.clear();
+
+                    writeFrame(recordedFrame);
+                }
+                else
+                {
+                    if (isEventRecording)
+                    {
+                        std::cout << "Event finished (quiet period elapsed)" << std::endl;
+                        isEventRecording = false;
+                    }
+
+                    // camera reuses its buffers, so the data have to be copied
+                    recordedFrame.data = recordedFrame.data.clone();
+                    preRollBuffer.push_back(recordedFrame);
+                    while (!preRollBuffer.empty() && timestamp - preRollBuffer.front().timestamp > sharedData.getPreRollMs())
+                        preRollBuffer.pop_front();
+                }
+            }
         }
 
-        cv::imshow("Frame", frame);
+        if (!frame.empty())
+            cv::imshow("Frame", frame);
 
         key = cv::waitKey(60); // corresponds to 17 fps
         if (key == 'p')
             sharedData.pauseRecording();
         if (key == 'c') // continue recording
             sharedData.startRecording();
+        if (key == 'm')
+        {
+            sharedData.addMarker();
+            if (sharedData.triggerMode())
+                sharedData.trigger(SharedData::now());
+        }
         if (key == 's')
         {
             sharedData.setTerminationFlag(); // notify UWB server about termination
@@ -70,12 +172,17 @@ void VideoManager::runVideoRecorder()
         }
     }
 
+    writeEvents(); // stop event
+
     std::cout << "Saving video! Please wait..." << std::endl;
     try
     {
 
         videoWriter.release();
+        mjpegWriter.release();
         timestampFile.close();
+        indexFile.close();
+        preRollBuffer.clear();
         std::cout << "Video has been saved successfully!" << std::endl;
     }
     catch (const std::exception &e)
@@ -83,3 +190,116 @@ void VideoManager::runVideoRecorder()
         std::cerr << "Error: " << e.what() << std::endl;
     }
 }
+
+// Writes frame to the video and its frameIndex + timestamp to the index file(s)
+// Frame index is assigned here, so frame IDs stay sequential in trigger mode as well
+void VideoManager::writeFrame(const RecordedFrame &recordedFrame)
+{
+    if (!isMJPEGPassthrough)
+    {
+        videoWriter.write(recordedFrame.data);
+    }
+    else
+    {
+        int64_t offset = mjpegWriter.write(recordedFrame.data.data, recordedFrame.data.total());
+        // every MJPEG frame is a keyframe
+        indexFile << frameIndex << " " << offset << " " << recordedFrame.data.total() << " 1 " << recordedFrame.timestamp << "\n";
+    }
+
+    timestampFile << frameIndex << " " << recordedFrame.timestamp << std::endl;
+
+    // people detection runs in its own thread on every n-th written frame
+    if (DetectionWorker::isEnabled && (frameIndex - 1) % DetectionWorker::detectionInterval == 0)
+        DetectionWorker::enqueue(frameIndex, recordedFrame.timestamp, recordedFrame.data);
+
+    frameIndex++;
+}
+
+// Recorder events (pause, resume, stop, marker) are written as comment lines with the timestamp shared by both streams
+void VideoManager::writeEvents()
+{
+    RecorderEvent event;
+    while (sharedData.readEvent(eventCursor, event, SharedData::now()))
+    {
+        timestampFile << "# " << event.getName() << " " << event.timestamp << std::endl;
+        if (indexFile.is_open())
+            indexFile << "# " << event.getName() << " " << event.timestamp << "\n";
+    }
+}
+
+// Frame differencing on a small grayscale image. In passthrough mode JPEG is decoded directly at 1/4 resolution (cheap)
+bool VideoManager::isMotionDetected(const cv::Mat &data)
+{
+    cv::Mat grayFrame;
+    if (isMJPEGPassthrough)
+    {
+        grayFrame = cv::imdecode(data, cv::IMREAD_REDUCED_GRAYSCALE_4);
+    }
+    else
+    {
+        cv::resize(data, grayFrame, cv::Size(), 0.25, 0.25, cv::INTER_AREA);
+        cv::cvtColor(grayFrame, grayFrame, cv::COLOR_BGR2GRAY);
+    }
+
+    if (grayFrame.empty())
+        return false;
+
+    cv::GaussianBlur(grayFrame, grayFrame, cv::Size(5, 5), 0);
+
+    bool isMotion = false;
+    if (!previousGrayFrame.empty() && previousGrayFrame.size() == grayFrame.size())
+    {
+        cv::Mat difference;
+        cv::absdiff(grayFrame, previousGrayFrame, difference);
+        isMotion = cv::mean(difference)[0] > motionThreshold;
+    }
+
+    previousGrayFrame = grayFrame;
+    return isMotion;
+}
+
+// Offline stage: converts MJPEG passthrough recording to H.264 (smaller file for archiving)
+// Frames are neither dropped nor duplicated, so video_timestamps.txt stays valid for the converted video
+void VideoManager::transcodeToH264(const std::string &inputFilename, const std::string &outputFilename)
+{
+    cv::VideoCapture videoReader(inputFilename);
+    if (!videoReader.isOpened())
+        throw std::runtime_error("Failed to open " + inputFilename);
+
+    double inputFPS = videoReader.get(cv::CAP_PROP_FPS);
+    cv::Size inputFrameSize(videoReader.get(cv::CAP_PROP_FRAME_WIDTH), videoReader.get(cv::CAP_PROP_FRAME_HEIGHT));
+    int totalFrames = static_cast<int>(videoReader.get(cv::CAP_PROP_FRAME_COUNT));
+
+    setH264WriterOptions();
+    cv::VideoWriter videoWriter(outputFilename, cv::VideoWriter::fourcc('H', '2', '6', '4'), inputFPS, inputFrameSize);
+    if (!videoWriter.isOpened())
+        throw std::runtime_error("Failed to open " + outputFilename);
+
+    std::cout << "Transcoding " << inputFilename << " to H.264..." << std::endl;
+
+    cv::Mat inputFrame;
+    int transcodedFrames = 0;
+    while (videoReader.read(inputFrame))
+    {
+        videoWriter.write(inputFrame);
+        transcodedFrames++;
+
+        if (transcodedFrames % 1000 == 0)
+            std::cout << "  " << transcodedFrames << " / " << totalFrames << " frames" << std::endl;
+    }
+
+    videoWriter.release();
+    videoReader.release();
+    std::cout << "Transcoded " << transcodedFrames << " frames to " << outputFilename << std::endl;
+}
+
+// Keyframe interval of the H.264 encoder. OpenCV (FFmpeg backend) passes these options to the encoder
+// Fixed GOP keeps seeking in GUI cheap: at most gopSize - 1 frames are decoded to reach any frame
+void VideoManager::setH264WriterOptions()
+{
+    if (gopSize <= 0)
+        return; // encoder default
+
+    std::string options = "g;" + std::to_string(gopSize) + "|keyint_min;" + std::to_string(gopSize);
+    setenv("OPENCV_FFMPEG_WRITER_OPTIONS", options.c_str(), 1);
+}
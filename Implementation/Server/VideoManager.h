@@ -7,6 +7,19 @@
  *  - index file creation (to further access video in GUI Indoor Positioning System)
  * Allows to play / pause / stop (terminate) recording of both UWB and Video (by cv::imshow)
  * 
+ * Recording modes:
+ *  - default: frames are decoded to BGR and re-encoded to H.264 by cv::VideoWriter
+ *  - MJPEG passthrough (--mjpeg): compressed buffers from the camera are muxed into video.avi without decoding.
+ *    Only every n-th frame is decoded for the preview. The video can be converted to H.264 later (--transcode).
+ *    Seek index (video_index.txt) is written as well: frameIndex offset size keyframe timestamp
+ *    (for H.264 video the index is built once by GUI from the AVI index)
+ *
+ * Trigger mode (--trigger): frames are kept in the pre-roll buffer (last few seconds) and written only while an event
+ * is active. Events are triggered by tag motion (Server), frame differencing or manually ("m").
+ * The event finishes after the quiet period without any trigger.
+ *
+ * Recorder events (pause, resume, stop, marker "m") are written into video_timestamps.txt and video_index.txt as
+ * "# <event> <timestamp>" lines. The same lines (the same timestamps) are written into UWB_timestamps.txt by Server.
 ***********************************************************************************************************************/
 
 #include <iostream>
@@ -15,9 +28,12 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include <thread>
+#include <deque>
 
-#include "Camera.hpp"
-#include "SharedData.hpp"
+#include "Camera.h"
+#include "SharedData.h"
+#include "MJPEGWriter.h"
+#include "DetectionWorker.h"
 
 class VideoManager
 {
@@ -30,8 +46,37 @@ public:
     static std::time_t timestamp;
     static cv::Mat timestampMat;
     static uint8_t key;
+    static bool isMJPEGPassthrough;
+    static size_t previewDecimation; // decode every n-th frame for the preview (passthrough mode)
+    static int gopSize;               // keyframe interval of H.264 video (bounds the cost of seeking in GUI)
+    static double motionThreshold;    // mean absolute difference of consecutive frames which triggers an event
     
     static void runVideoRecorder();
+    static void transcodeToH264(const std::string &inputFilename, const std::string &outputFilename); // offline stage
+
+private:
+    // BGR frame, or compressed MJPEG buffer in passthrough mode
+    struct RecordedFrame
+    {
+        cv::Mat data;
+        std::time_t timestamp;
+    };
+
+    static cv::VideoWriter videoWriter;
+    static MJPEGWriter mjpegWriter;
+    static std::ofstream timestampFile, indexFile;
+
+    // Trigger mode
+    static std::deque<RecordedFrame> preRollBuffer;
+    static cv::Mat previousGrayFrame;
+    static bool isEventRecording;
+
+    static uint64_t eventCursor; // position in the recorder event channel (SharedData)
+
+    static void writeFrame(const RecordedFrame &recordedFrame);
+    static bool isMotionDetected(const cv::Mat &data);
+    static void writeEvents();
+    static void setH264WriterOptions();
 };
 
 #endif